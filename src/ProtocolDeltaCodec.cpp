@@ -0,0 +1,341 @@
+#include "ProtocolDeltaCodec.h"
+
+#include "ccMacros.h"
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+
+#include <string.h>
+
+USING_NS_CC;
+
+NS_PROTOCOL_GENERATOR_BEGIN
+
+ProtocolDeltaCodec::ProtocolDeltaCodec(ProtocolGenerator * p_pGenerator)
+{
+	this->m_pGenerator = p_pGenerator;
+}
+
+ProtocolDeltaCodec::~ProtocolDeltaCodec()
+{
+	this->m_pGenerator = nullptr;
+}
+
+bool ProtocolDeltaCodec::Encode(const char * p_pszMessageName, uint64_t p_uEntityId, lua_State * p_pLuaState, int32_t p_nIndex, std::string & p_strBuffer)
+{
+	const ProtocolGenerator::MessagePlan * pMessagePlan = this->_FindMessagePlan(p_pszMessageName);
+
+	if (nullptr == pMessagePlan)
+	{
+		return false;
+	}
+
+	return this->_Encode(pMessagePlan, p_uEntityId, p_pLuaState, p_nIndex, p_strBuffer);
+}
+
+bool ProtocolDeltaCodec::Encode(uint32_t p_uMessageId, uint64_t p_uEntityId, lua_State * p_pLuaState, int32_t p_nIndex, std::string & p_strBuffer)
+{
+	if (nullptr == this->m_pGenerator)
+	{
+		return false;
+	}
+
+	const ProtocolGenerator::MessagePlan * pMessagePlan = this->m_pGenerator->_FindMessagePlan(p_uMessageId);
+
+	if (nullptr == pMessagePlan)
+	{
+		return CCLOGERROR("Message Id %u Is Not Registered!", p_uMessageId), false;
+	}
+
+	return this->_Encode(pMessagePlan, p_uEntityId, p_pLuaState, p_nIndex, p_strBuffer);
+}
+
+bool ProtocolDeltaCodec::Decode(const char * p_pszMessageName, uint64_t p_uEntityId, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, bool p_bSparse)
+{
+	const ProtocolGenerator::MessagePlan * pMessagePlan = this->_FindMessagePlan(p_pszMessageName);
+
+	if (nullptr == pMessagePlan)
+	{
+		return false;
+	}
+
+	return this->_Decode(pMessagePlan, p_uEntityId, p_pszDataBuffer, p_nDataSize, p_pLuaState, p_bSparse);
+}
+
+bool ProtocolDeltaCodec::Decode(uint32_t p_uMessageId, uint64_t p_uEntityId, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, bool p_bSparse)
+{
+	if (nullptr == this->m_pGenerator)
+	{
+		return false;
+	}
+
+	const ProtocolGenerator::MessagePlan * pMessagePlan = this->m_pGenerator->_FindMessagePlan(p_uMessageId);
+
+	if (nullptr == pMessagePlan)
+	{
+		return CCLOGERROR("Message Id %u Is Not Registered!", p_uMessageId), false;
+	}
+
+	return this->_Decode(pMessagePlan, p_uEntityId, p_pszDataBuffer, p_nDataSize, p_pLuaState, p_bSparse);
+}
+
+void ProtocolDeltaCodec::Forget(uint64_t p_uEntityId)
+{
+	auto pIterBegin = this->m_mapSnapshots.lower_bound(ProtocolDeltaCodec::SnapshotKey(p_uEntityId, nullptr));
+	auto pIterEnd   = pIterBegin;
+
+	while (pIterEnd != this->m_mapSnapshots.end() && pIterEnd->first.first == p_uEntityId)
+	{
+		++pIterEnd;
+	}
+
+	this->m_mapSnapshots.erase(pIterBegin, pIterEnd);
+}
+
+void ProtocolDeltaCodec::Reset()
+{
+	this->m_mapSnapshots.clear();
+}
+
+size_t ProtocolDeltaCodec::GetSnapshotCount() const
+{
+	return this->m_mapSnapshots.size();
+}
+
+const ProtocolGenerator::MessagePlan * ProtocolDeltaCodec::_FindMessagePlan(const char * p_pszMessageName)
+{
+	if (nullptr == this->m_pGenerator || !CC_IS_VALID_ANSI_STR(p_pszMessageName) || nullptr == this->m_pGenerator->GetDescriptorPool())
+	{
+		return nullptr;
+	}
+
+	const google::protobuf::Descriptor * pDescriptor = this->m_pGenerator->GetDescriptorPool()->FindMessageTypeByName(p_pszMessageName);
+
+	if (nullptr == pDescriptor)
+	{
+		return CCLOGERROR("Message Type \"%s\" Not Exist!", p_pszMessageName), nullptr;
+	}
+
+	return this->m_pGenerator->_GetMessagePlan(pDescriptor);
+}
+
+bool ProtocolDeltaCodec::_Encode(const ProtocolGenerator::MessagePlan * p_pMessagePlan, uint64_t p_uEntityId, lua_State * p_pLuaState, int32_t p_nIndex, std::string & p_strBuffer)
+{
+	if (nullptr == p_pLuaState || p_nIndex < 0 || !lua_istable(p_pLuaState, p_nIndex))
+	{
+		return false;
+	}
+
+	// 先编码出完整的消息，再按顶层字段和上一次的数据逐段比较
+
+	this->m_strBuffer.clear();
+
+	if (!this->m_pGenerator->_EncodeMessage(p_pMessagePlan, p_pLuaState, p_nIndex, this->m_strBuffer))
+	{
+		return false;
+	}
+
+	if (!ProtocolDeltaCodec::_SplitFields(p_pMessagePlan, this->m_strBuffer.data(), this->m_strBuffer.size(), this->m_vecRanges))
+	{
+		return CCLOGERROR("Message Type \"%s\" Delta Encode Fail!", p_pMessagePlan->pDescriptor->full_name().c_str()), false;
+	}
+
+	ProtocolDeltaCodec::SnapshotKey cKey(p_uEntityId, p_pMessagePlan);
+
+	auto pIterFind = this->m_mapSnapshots.find(cKey);
+
+	const ProtocolDeltaCodec::Snapshot * pSnapshot = pIterFind != this->m_mapSnapshots.end() ? &pIterFind->second : nullptr;
+
+	size_t uFieldCount = p_pMessagePlan->vecFields.size();
+	size_t uMaskSize   = 0;
+
+	uint8_t szMask[64] = {0};
+
+	std::vector<uint8_t> vecMask; // 字段超过512个时才使用
+
+	uint8_t * pMask = szMask;
+
+	if ((uFieldCount + 7) / 8 > sizeof(szMask))
+	{
+		vecMask.resize((uFieldCount + 7) / 8, 0);
+
+		pMask = &vecMask[0];
+	}
+
+	for (size_t i = 0; i < uFieldCount; ++i)
+	{
+		const std::pair<uint32_t, uint32_t> & cRange = this->m_vecRanges[i];
+
+		if (nullptr != pSnapshot)
+		{
+			const std::pair<uint32_t, uint32_t> & cPrevRange = pSnapshot->vecRanges[i];
+
+			if (cRange.second == cPrevRange.second && 0 == memcmp(this->m_strBuffer.data() + cRange.first, pSnapshot->strData.data() + cPrevRange.first, cRange.second))
+			{
+				continue;
+			}
+		}
+
+		pMask[i / 8] |= static_cast<uint8_t>(1 << (i % 8));
+
+		uMaskSize = i / 8 + 1;
+	}
+
+	// 掩码末尾为0的字节不写入，没有变化时整个增量只有一个字节
+
+	uint8_t szMaskSize[8] = {0};
+
+	size_t uMaskSizeSize = google::protobuf::io::CodedOutputStream::WriteVarint32ToArray(static_cast<uint32_t>(uMaskSize), szMaskSize) - szMaskSize;
+
+	p_strBuffer.append(reinterpret_cast<const char *>(szMaskSize), uMaskSizeSize);
+	p_strBuffer.append(reinterpret_cast<const char *>(pMask), uMaskSize);
+
+	for (size_t i = 0; i < uFieldCount; ++i)
+	{
+		if (0 != (pMask[i / 8] & (1 << (i % 8))))
+		{
+			p_strBuffer.append(this->m_strBuffer, this->m_vecRanges[i].first, this->m_vecRanges[i].second);
+		}
+	}
+
+	// 新的数据成为下一次比较的基准，旧数据的内存留给下一次编码使用
+
+	ProtocolDeltaCodec::Snapshot & cSnapshot = this->m_mapSnapshots[cKey];
+
+	cSnapshot.strData.swap(this->m_strBuffer);
+	cSnapshot.vecRanges.swap(this->m_vecRanges);
+
+	return true;
+}
+
+bool ProtocolDeltaCodec::_Decode(const ProtocolGenerator::MessagePlan * p_pMessagePlan, uint64_t p_uEntityId, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, bool p_bSparse)
+{
+	if (nullptr == p_pLuaState || p_nDataSize <= 0 || nullptr == p_pszDataBuffer)
+	{
+		return false;
+	}
+
+	size_t uFieldCount = p_pMessagePlan->vecFields.size();
+
+	google::protobuf::io::CodedInputStream cInput(p_pszDataBuffer, p_nDataSize);
+
+	uint32_t uMaskSize = 0;
+
+	if (!cInput.ReadVarint32(&uMaskSize) || uMaskSize > (uFieldCount + 7) / 8 || uMaskSize > static_cast<uint32_t>(p_nDataSize - cInput.CurrentPosition()))
+	{
+		return CCLOGERROR("Message Type \"%s\" Delta Mask Is Invalid!", p_pMessagePlan->pDescriptor->full_name().c_str()), false;
+	}
+
+	const uint8_t * pMask = p_pszDataBuffer + cInput.CurrentPosition();
+
+	const char * pszPayload = reinterpret_cast<const char *>(pMask + uMaskSize);
+
+	size_t uPayloadSize = static_cast<size_t>(p_nDataSize) - cInput.CurrentPosition() - uMaskSize;
+
+	// 超出字段数量的位必须为0，否则两边的协议不一致
+
+	if (0 != (uFieldCount % 8) && uMaskSize == (uFieldCount + 7) / 8 && 0 != (pMask[uMaskSize - 1] >> (uFieldCount % 8)))
+	{
+		return CCLOGERROR("Message Type \"%s\" Delta Mask Is Invalid!", p_pMessagePlan->pDescriptor->full_name().c_str()), false;
+	}
+
+	if (!ProtocolDeltaCodec::_SplitFields(p_pMessagePlan, pszPayload, uPayloadSize, this->m_vecRanges))
+	{
+		return CCLOGERROR("Message Type \"%s\" Delta Decode Fail!", p_pMessagePlan->pDescriptor->full_name().c_str()), false;
+	}
+
+	ProtocolDeltaCodec::SnapshotKey cKey(p_uEntityId, p_pMessagePlan);
+
+	auto pIterFind = this->m_mapSnapshots.find(cKey);
+
+	const ProtocolDeltaCodec::Snapshot * pSnapshot = pIterFind != this->m_mapSnapshots.end() ? &pIterFind->second : nullptr;
+
+	// 用变化的字段替换上一次的数据拼出完整的消息，m_vecRanges从增量中的位置改成新数据中的位置
+
+	this->m_strBuffer.clear();
+
+	for (size_t i = 0; i < uFieldCount; ++i)
+	{
+		std::pair<uint32_t, uint32_t> & cRange = this->m_vecRanges[i];
+
+		bool bChanged = i / 8 < uMaskSize && 0 != (pMask[i / 8] & (1 << (i % 8)));
+
+		uint32_t uOffset = static_cast<uint32_t>(this->m_strBuffer.size());
+
+		if (bChanged)
+		{
+			this->m_strBuffer.append(pszPayload + cRange.first, cRange.second);
+		}
+		else if (0 != cRange.second)
+		{
+			return CCLOGERROR("Message Type \"%s\" Delta Field \"%s\" Is Not In The Mask!", p_pMessagePlan->pDescriptor->full_name().c_str(), p_pMessagePlan->vecFields[i].pField->name().c_str()), false;
+		}
+		else if (nullptr == pSnapshot)
+		{
+			return CCLOGERROR("Message Type \"%s\" Delta Has No Base State! Entity Id : %llu.", p_pMessagePlan->pDescriptor->full_name().c_str(), static_cast<unsigned long long>(p_uEntityId)), false;
+		}
+		else
+		{
+			cRange.second = pSnapshot->vecRanges[i].second;
+
+			this->m_strBuffer.append(pSnapshot->strData, pSnapshot->vecRanges[i].first, cRange.second);
+		}
+
+		cRange.first = uOffset;
+	}
+
+	if (!this->m_pGenerator->_ParseMessage(p_pMessagePlan, reinterpret_cast<const unsigned char *>(this->m_strBuffer.data()), static_cast<int32_t>(this->m_strBuffer.size()), p_pLuaState, p_bSparse))
+	{
+		return false;
+	}
+
+	ProtocolDeltaCodec::Snapshot & cSnapshot = this->m_mapSnapshots[cKey];
+
+	cSnapshot.strData.swap(this->m_strBuffer);
+	cSnapshot.vecRanges.swap(this->m_vecRanges);
+
+	return true;
+}
+
+bool ProtocolDeltaCodec::_SplitFields(const ProtocolGenerator::MessagePlan * p_pMessagePlan, const char * p_pszData, size_t p_uSize, std::vector<std::pair<uint32_t, uint32_t> > & p_vecRanges)
+{
+	// 记录每个顶层字段的数据范围，同一个字段（repeated字段的多个元素）的数据必须是连续的一段
+
+	p_vecRanges.assign(p_pMessagePlan->vecFields.size(), std::pair<uint32_t, uint32_t>(0, 0));
+
+	google::protobuf::io::CodedInputStream cInput(reinterpret_cast<const uint8_t *>(p_pszData), static_cast<int32_t>(p_uSize));
+
+	while (true)
+	{
+		int32_t nBegin = cInput.CurrentPosition();
+
+		uint32_t uTag = cInput.ReadTag();
+
+		if (0 == uTag)
+		{
+			return static_cast<size_t>(nBegin) == p_uSize;
+		}
+
+		const ProtocolGenerator::FieldPlan * pFieldPlan = p_pMessagePlan->FindFieldPlan(google::protobuf::internal::WireFormatLite::GetTagFieldNumber(uTag));
+
+		if (nullptr == pFieldPlan || !google::protobuf::internal::WireFormatLite::SkipField(&cInput, uTag))
+		{
+			return false;
+		}
+
+		std::pair<uint32_t, uint32_t> & cRange = p_vecRanges[pFieldPlan - &p_pMessagePlan->vecFields[0]];
+
+		if (0 == cRange.second)
+		{
+			cRange.first = static_cast<uint32_t>(nBegin);
+		}
+		else if (cRange.first + cRange.second != static_cast<uint32_t>(nBegin))
+		{
+			return false;
+		}
+
+		cRange.second = static_cast<uint32_t>(cInput.CurrentPosition()) - cRange.first;
+	}
+}
+
+NS_PROTOCOL_GENERATOR_END
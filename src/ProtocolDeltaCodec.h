@@ -0,0 +1,83 @@
+#ifndef __PROTOCOL_DELTA_CODEC_H__
+#define __PROTOCOL_DELTA_CODEC_H__
+
+#include "ProtocolGenerator.h"
+
+#include <map>
+#include <utility>
+#include <vector>
+
+NS_PROTOCOL_GENERATOR_BEGIN
+
+// 状态同步消息的增量编码：按(实体id, 消息类型)保存上一次发送/收到的完整数据，只传输发生变化的顶层字段
+// 增量数据的格式：[变化掩码的字节数(varint)][掩码，第i位对应消息的第i个字段][变化字段的wire format数据]
+// 掩码中置位但没有数据的字段表示被清除；第一次编码时所有字段都置位，解码方据此得到完整的初始状态
+// 编码方和解码方各自使用一个实例（例如每个连接一个），一个实例只用于一个方向；ProtocolGenerator需要在使用期间保持有效
+
+class ProtocolDeltaCodec
+{
+public:
+	ProtocolDeltaCodec(ProtocolGenerator * p_pGenerator);
+
+public:
+	~ProtocolDeltaCodec();
+
+public:
+	// 把p_nIndex处的table和上一次编码的同一实体的数据比较，增量数据追加到p_strBuffer的末尾
+
+	bool Encode(const char * p_pszMessageName, uint64_t p_uEntityId, lua_State * p_pLuaState, int32_t p_nIndex, std::string & p_strBuffer);
+	bool Encode(uint32_t p_uMessageId, uint64_t p_uEntityId, lua_State * p_pLuaState, int32_t p_nIndex, std::string & p_strBuffer);
+
+public:
+	// 把增量数据合并到上一次的状态上，完整的状态作为table压入栈顶；没有收到过初始状态时返回false
+
+	bool Decode(const char * p_pszMessageName, uint64_t p_uEntityId, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, bool p_bSparse = false);
+	bool Decode(uint32_t p_uMessageId, uint64_t p_uEntityId, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, bool p_bSparse = false);
+
+public:
+	// 实体销毁或者对方需要重新同步时调用，之后的第一次编码重新发送完整的状态
+
+	void Forget(uint64_t p_uEntityId);
+	void Reset();
+
+public:
+	size_t GetSnapshotCount() const;
+
+private:
+	typedef struct _Snapshot
+	{
+	public:
+		std::string strData; // 完整消息的wire format数据
+
+	public:
+		std::vector<std::pair<uint32_t, uint32_t> > vecRanges; // 每个字段在strData中的(偏移, 长度)，长度为0表示没有这个字段
+	} Snapshot;
+
+	typedef std::pair<uint64_t, const ProtocolGenerator::MessagePlan *> SnapshotKey; // 实体id在前，Forget时按范围删除
+
+private:
+	const ProtocolGenerator::MessagePlan * _FindMessagePlan(const char * p_pszMessageName);
+
+private:
+	bool _Encode(const ProtocolGenerator::MessagePlan * p_pMessagePlan, uint64_t p_uEntityId, lua_State * p_pLuaState, int32_t p_nIndex, std::string & p_strBuffer);
+	bool _Decode(const ProtocolGenerator::MessagePlan * p_pMessagePlan, uint64_t p_uEntityId, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, bool p_bSparse);
+
+private:
+	static bool _SplitFields(const ProtocolGenerator::MessagePlan * p_pMessagePlan, const char * p_pszData, size_t p_uSize, std::vector<std::pair<uint32_t, uint32_t> > & p_vecRanges);
+
+private:
+	ProtocolGenerator * m_pGenerator;
+
+private:
+	std::map<ProtocolDeltaCodec::SnapshotKey, ProtocolDeltaCodec::Snapshot> m_mapSnapshots;
+
+private:
+	// 编码和解码时使用的临时数据，保留已经申请的内存
+
+	std::string m_strBuffer;
+	std::vector<std::pair<uint32_t, uint32_t> > m_vecRanges;
+};
+
+NS_PROTOCOL_GENERATOR_END
+
+#endif // !defined(__PROTOCOL_DELTA_CODEC_H__)
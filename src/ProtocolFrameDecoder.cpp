@@ -0,0 +1,312 @@
+#include "ProtocolFrameDecoder.h"
+
+#include "ccMacros.h"
+
+#include <google/protobuf/io/zero_copy_stream.h>
+
+#include <algorithm>
+
+#include <string.h>
+
+USING_NS_CC;
+
+NS_PROTOCOL_GENERATOR_BEGIN
+
+static const size_t s_uMaxFrameHeaderSize = 10; // 长度和消息号都是varint时最多各5个字节
+
+// 把环形缓冲区中首尾两段数据作为一个连续的输入流交给CodedInputStream，跨越末尾的帧不需要先拷贝出来
+
+class RingInputStream : public google::protobuf::io::ZeroCopyInputStream
+{
+public:
+	RingInputStream(const unsigned char * p_pszFirstBuffer, int32_t p_nFirstSize, const unsigned char * p_pszSecondBuffer, int32_t p_nSecondSize)
+		: m_pszFirstBuffer(p_pszFirstBuffer), m_pszSecondBuffer(p_pszSecondBuffer), m_nFirstSize(p_nFirstSize), m_nTotalSize(p_nFirstSize + p_nSecondSize), m_nPosition(0)
+	{
+	}
+
+public:
+	bool Next(const void ** p_ppData, int * p_pSize) override
+	{
+		if (this->m_nPosition >= this->m_nTotalSize)
+		{
+			return false;
+		}
+
+		if (this->m_nPosition < this->m_nFirstSize)
+		{
+			*p_ppData = this->m_pszFirstBuffer + this->m_nPosition;
+			*p_pSize  = this->m_nFirstSize - this->m_nPosition;
+		}
+		else
+		{
+			*p_ppData = this->m_pszSecondBuffer + (this->m_nPosition - this->m_nFirstSize);
+			*p_pSize  = this->m_nTotalSize - this->m_nPosition;
+		}
+
+		this->m_nPosition += *p_pSize;
+
+		return true;
+	}
+
+	void BackUp(int p_nCount) override
+	{
+		this->m_nPosition -= p_nCount;
+	}
+
+	bool Skip(int p_nCount) override
+	{
+		if (p_nCount > this->m_nTotalSize - this->m_nPosition)
+		{
+			this->m_nPosition = this->m_nTotalSize;
+
+			return false;
+		}
+
+		this->m_nPosition += p_nCount;
+
+		return true;
+	}
+
+	int64_t ByteCount() const override
+	{
+		return this->m_nPosition;
+	}
+
+private:
+	const unsigned char * m_pszFirstBuffer;
+	const unsigned char * m_pszSecondBuffer;
+
+private:
+	int32_t m_nFirstSize;
+	int32_t m_nTotalSize;
+	int32_t m_nPosition;
+};
+
+ProtocolFrameDecoder::ProtocolFrameDecoder(ProtocolGenerator * p_pGenerator, size_t p_uCapacity)
+{
+	this->m_pGenerator = p_pGenerator;
+
+	this->m_vecBuffer.resize(std::max(p_uCapacity, s_uMaxFrameHeaderSize));
+
+	this->Reset();
+}
+
+ProtocolFrameDecoder::~ProtocolFrameDecoder()
+{
+	this->m_pGenerator = nullptr;
+}
+
+bool ProtocolFrameDecoder::Write(const unsigned char * p_pszDataBuffer, size_t p_uDataSize)
+{
+	if (nullptr == p_pszDataBuffer && p_uDataSize > 0)
+	{
+		return false;
+	}
+
+	this->_Reserve(p_uDataSize);
+
+	size_t uCapacity = this->m_vecBuffer.size();
+	size_t uWritePos = (this->m_uReadPos + this->m_uDataSize) % uCapacity;
+	size_t uFirstSize = std::min(p_uDataSize, uCapacity - uWritePos);
+
+	memcpy(&this->m_vecBuffer[uWritePos], p_pszDataBuffer, uFirstSize);
+	memcpy(&this->m_vecBuffer[0], p_pszDataBuffer + uFirstSize, p_uDataSize - uFirstSize);
+
+	this->m_uDataSize += p_uDataSize;
+
+	return true;
+}
+
+unsigned char * ProtocolFrameDecoder::PrepareWrite(size_t p_uMinSize, size_t & p_uWritableSize)
+{
+	p_uMinSize = std::max<size_t>(p_uMinSize, 1);
+
+	this->_Reserve(p_uMinSize);
+
+	size_t uCapacity = this->m_vecBuffer.size();
+	size_t uWritePos = (this->m_uReadPos + this->m_uDataSize) % uCapacity;
+
+	p_uWritableSize = uWritePos < this->m_uReadPos ? this->m_uReadPos - uWritePos : uCapacity - uWritePos;
+
+	if (p_uWritableSize < p_uMinSize)
+	{
+		// 空闲空间被缓冲区末尾分成了两段，把数据挪到开头让空闲空间连续
+
+		this->_Relocate(uCapacity);
+
+		uWritePos = this->m_uDataSize;
+
+		p_uWritableSize = uCapacity - uWritePos;
+	}
+
+	return &this->m_vecBuffer[uWritePos];
+}
+
+void ProtocolFrameDecoder::CommitWrite(size_t p_uDataSize)
+{
+	this->m_uDataSize += std::min(p_uDataSize, this->m_vecBuffer.size() - this->m_uDataSize);
+}
+
+int32_t ProtocolFrameDecoder::Decode(lua_State * p_pLuaState, int32_t p_nHandlerIndex)
+{
+	if (nullptr == this->m_pGenerator || nullptr == p_pLuaState || this->m_bCorrupted)
+	{
+		return -1;
+	}
+
+	if (0 != p_nHandlerIndex && !lua_isfunction(p_pLuaState, p_nHandlerIndex))
+	{
+		return CCLOGERROR("Frame Handler Is Not A Function!"), -1;
+	}
+
+	int32_t nHandlerIndex = (p_nHandlerIndex < 0 && p_nHandlerIndex > LUA_REGISTRYINDEX) ? lua_gettop(p_pLuaState) + p_nHandlerIndex + 1 : p_nHandlerIndex;
+	int32_t nTop          = lua_gettop(p_pLuaState);
+
+	if (0 == nHandlerIndex)
+	{
+		lua_newtable(p_pLuaState);
+	}
+
+	int32_t nResultIndex = lua_gettop(p_pLuaState);
+	int32_t nPrevCacheIndex = this->m_pGenerator->_BeginLuaNameCache(p_pLuaState, nResultIndex + 1);
+
+	int32_t nCount      = 0;
+	int32_t nFrameCount = 0;
+
+	while (this->m_uDataSize > 0)
+	{
+		// 帧头最多10个字节，跨越末尾时拷贝到栈上再读取
+
+		unsigned char szHeader[s_uMaxFrameHeaderSize] = {0};
+
+		size_t uHeaderDataSize = std::min(this->m_uDataSize, s_uMaxFrameHeaderSize);
+
+		uint32_t uMessageId = 0;
+		uint32_t uBodySize  = 0;
+
+		int32_t nHeaderSize = this->m_pGenerator->_ReadFrameHeader(this->_Peek(uHeaderDataSize, szHeader), uHeaderDataSize, uMessageId, uBodySize);
+
+		if (nHeaderSize < 0)
+		{
+			CCLOGERROR("Frame Header Is Invalid! Buffered Size : %u.", static_cast<uint32_t>(this->m_uDataSize));
+
+			this->m_bCorrupted = true;
+
+			nFrameCount = -1; break;
+		}
+
+		if (0 == nHeaderSize || this->m_uDataSize - nHeaderSize < uBodySize)
+		{
+			break; // 剩下的数据不是一个完整的帧
+		}
+
+		this->_Consume(static_cast<size_t>(nHeaderSize));
+
+		const unsigned char * pszBody = &this->m_vecBuffer[this->m_uReadPos];
+
+		size_t uFirstSize = std::min<size_t>(uBodySize, this->m_vecBuffer.size() - this->m_uReadPos);
+
+		bool bSuccess = false;
+
+		if (uFirstSize == uBodySize)
+		{
+			google::protobuf::io::CodedInputStream cInput(pszBody, static_cast<int32_t>(uBodySize));
+
+			bSuccess = this->m_pGenerator->_DispatchFrame(uMessageId, cInput, static_cast<int32_t>(uBodySize), p_pLuaState, nHandlerIndex, nResultIndex, nCount);
+		}
+		else
+		{
+			RingInputStream cStream(pszBody, static_cast<int32_t>(uFirstSize), &this->m_vecBuffer[0], static_cast<int32_t>(uBodySize - uFirstSize));
+
+			google::protobuf::io::CodedInputStream cInput(&cStream);
+
+			bSuccess = this->m_pGenerator->_DispatchFrame(uMessageId, cInput, static_cast<int32_t>(uBodySize), p_pLuaState, nHandlerIndex, nResultIndex, nCount);
+		}
+
+		this->_Consume(uBodySize);
+
+		if (bSuccess)
+		{
+			++nFrameCount;
+		}
+	}
+
+	this->m_pGenerator->_EndLuaNameCache(p_pLuaState, nPrevCacheIndex);
+
+	if (nFrameCount < 0)
+	{
+		lua_settop(p_pLuaState, nTop); // 返回-1时不压入任何值，已经解码的帧随结果数组一起丢弃
+	}
+
+	return nFrameCount;
+}
+
+void ProtocolFrameDecoder::Reset()
+{
+	this->m_uReadPos  = 0;
+	this->m_uDataSize = 0;
+
+	this->m_bCorrupted = false;
+}
+
+size_t ProtocolFrameDecoder::GetBufferedSize() const
+{
+	return this->m_uDataSize;
+}
+
+size_t ProtocolFrameDecoder::GetCapacity() const
+{
+	return this->m_vecBuffer.size();
+}
+
+void ProtocolFrameDecoder::_Reserve(size_t p_uDataSize)
+{
+	if (this->m_vecBuffer.size() - this->m_uDataSize < p_uDataSize)
+	{
+		this->_Relocate(std::max(this->m_vecBuffer.size() * 2, this->m_uDataSize + p_uDataSize));
+	}
+}
+
+void ProtocolFrameDecoder::_Relocate(size_t p_uCapacity)
+{
+	// 换到新的缓冲区并把未解码的数据放到开头，只在空间不够或空闲空间不连续时发生
+
+	std::vector<unsigned char> vecBuffer(p_uCapacity);
+
+	size_t uFirstSize = std::min(this->m_uDataSize, this->m_vecBuffer.size() - this->m_uReadPos);
+
+	memcpy(&vecBuffer[0], &this->m_vecBuffer[this->m_uReadPos], uFirstSize);
+	memcpy(&vecBuffer[uFirstSize], &this->m_vecBuffer[0], this->m_uDataSize - uFirstSize);
+
+	this->m_vecBuffer.swap(vecBuffer);
+
+	this->m_uReadPos = 0;
+}
+
+const unsigned char * ProtocolFrameDecoder::_Peek(size_t p_uDataSize, unsigned char * p_pszTempBuffer) const
+{
+	size_t uFirstSize = this->m_vecBuffer.size() - this->m_uReadPos;
+
+	if (p_uDataSize <= uFirstSize)
+	{
+		return &this->m_vecBuffer[this->m_uReadPos];
+	}
+
+	memcpy(p_pszTempBuffer, &this->m_vecBuffer[this->m_uReadPos], uFirstSize);
+	memcpy(p_pszTempBuffer + uFirstSize, &this->m_vecBuffer[0], p_uDataSize - uFirstSize);
+
+	return p_pszTempBuffer;
+}
+
+void ProtocolFrameDecoder::_Consume(size_t p_uDataSize)
+{
+	this->m_uReadPos  = (this->m_uReadPos + p_uDataSize) % this->m_vecBuffer.size();
+	this->m_uDataSize -= p_uDataSize;
+
+	if (0 == this->m_uDataSize)
+	{
+		this->m_uReadPos = 0; // 缓冲区空了就回到开头，让后面的帧尽量连续
+	}
+}
+
+NS_PROTOCOL_GENERATOR_END
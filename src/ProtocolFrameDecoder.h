@@ -0,0 +1,69 @@
+#ifndef __PROTOCOL_FRAME_DECODER_H__
+#define __PROTOCOL_FRAME_DECODER_H__
+
+#include "ProtocolGenerator.h"
+
+#include <vector>
+
+NS_PROTOCOL_GENERATOR_BEGIN
+
+// 流式的帧解码器，每个连接一个：recv到的任意长度的数据写入内部的环形缓冲区，Decode时解码其中所有完整的帧
+// 帧格式和消息号使用ProtocolGenerator的FrameFormat和RegisterMessageId，消息数据直接从环形缓冲区解码，跨越缓冲区末尾的帧也不会再拷贝
+// ProtocolGenerator需要在解码器使用期间保持有效
+
+class ProtocolFrameDecoder
+{
+public:
+	ProtocolFrameDecoder(ProtocolGenerator * p_pGenerator, size_t p_uCapacity = 64 * 1024);
+
+public:
+	~ProtocolFrameDecoder();
+
+public:
+	// 拷贝一段收到的数据，空间不够时缓冲区会扩大
+
+	bool Write(const unsigned char * p_pszDataBuffer, size_t p_uDataSize);
+
+public:
+	// 直接recv到环形缓冲区：PrepareWrite返回一段至少p_uMinSize字节的连续空间，recv之后用CommitWrite提交实际收到的字节数
+
+	unsigned char * PrepareWrite(size_t p_uMinSize, size_t & p_uWritableSize);
+	void CommitWrite(size_t p_uDataSize);
+
+public:
+	// p_nHandlerIndex为0时压入{ {消息号, table}, ... }数组，否则对每一帧调用handler(消息号, table)
+	// 返回解码的帧数，不完整的帧留在缓冲区等待后续数据；数据错乱时返回-1，之后需要Reset
+	// 返回-1时栈和调用前一样，不压入结果数组（handler模式下之前的帧已经调用过handler）
+
+	int32_t Decode(lua_State * p_pLuaState, int32_t p_nHandlerIndex = 0);
+
+public:
+	void Reset();
+
+public:
+	size_t GetBufferedSize() const;
+	size_t GetCapacity() const;
+
+private:
+	void _Reserve(size_t p_uDataSize);
+	void _Relocate(size_t p_uCapacity);
+	const unsigned char * _Peek(size_t p_uDataSize, unsigned char * p_pszTempBuffer) const;
+	void _Consume(size_t p_uDataSize);
+
+private:
+	ProtocolGenerator * m_pGenerator;
+
+private:
+	std::vector<unsigned char> m_vecBuffer;
+
+private:
+	size_t m_uReadPos;  // 第一个未解码字节的位置
+	size_t m_uDataSize; // 缓冲区中未解码的字节数
+
+private:
+	bool m_bCorrupted;
+};
+
+NS_PROTOCOL_GENERATOR_END
+
+#endif // !defined(__PROTOCOL_FRAME_DECODER_H__)
@@ -3,1183 +3,5825 @@
 #include "CCFileUtils.h"
 #include "CCLuaEngine.h"
 
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/unknown_field_set.h>
+#include <google/protobuf/wire_format_lite.h>
+
 #include <algorithm>
+#include <atomic>
+
+#include <stdlib.h>
+#include <string.h>
 
 USING_NS_CC;
 
 NS_PROTOCOL_GENERATOR_BEGIN
 
-struct FindProtocolDataByField : public std::binary_function <ProtocolGenerator::ProtocolData, std::string, bool>
+static const char * const s_pszMessageViewMetatable = "ProtocolGenerator.MessageView";
+
+static const uint32_t s_uMaxMessageId = 0xFFFFF; // 消息号表是直接索引的数组，限制最大的消息号避免占用过多内存
+
+static thread_local ProtocolGenerator::Context * s_pThreadContexts = nullptr; // 当前线程绑定的Context链表，每个ProtocolGenerator最多一个
+
+// 超出int64_t范围的double（包括NaN）直接转换成整数是未定义行为，先截断到范围内，NaN按0处理
+
+static int64_t LuaNumberToInt64(lua_Number p_fValue)
 {
-	bool operator () (const ProtocolGenerator::ProtocolData & p_cProtocolData, const std::string & p_strField) const
+	if (p_fValue != p_fValue)
 	{
-		return p_cProtocolData.strField == p_strField;
+		return 0;
 	}
-};
 
-ProtocolGenerator::_ProtocolData::_ProtocolData()
+	if (p_fValue <= -9223372036854775808.0)
+	{
+		return INT64_MIN;
+	}
+
+	if (p_fValue >= 9223372036854775808.0)
+	{
+		return INT64_MAX;
+	}
+
+	return static_cast<int64_t>(p_fValue);
+}
+
+// 负数经过int64_t按补码截断成uint32（-1为0xFFFFFFFF），和C++中整数之间的转换一致
+
+static uint32_t GetLuaUInt32Value(lua_State * p_pLuaState, int32_t p_nIndex)
 {
-	Clean();
+	return static_cast<uint32_t>(LuaNumberToInt64(lua_tonumber(p_pLuaState, p_nIndex)));
 }
 
-void ProtocolGenerator::_ProtocolData::Clean()
+// 从Lua读取64位整数和布尔值，GenerateMessage和EncodeMessage共用，保证两者得到的值一致
+
+static int64_t GetLuaInt64Value(lua_State * p_pLuaState, int32_t p_nIndex)
 {
-	eDataType = ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_VALUE;
+	// 定义了__LUA_SET_INT64_AS_STRING__时64位整数以字符串传递，直接解析字符串避免经过double丢失精度
 
-	strField.clear();
-	strValue.clear();
+	if (lua_type(p_pLuaState, p_nIndex) == LUA_TSTRING)
+	{
+		return strtoll(lua_tostring(p_pLuaState, p_nIndex), nullptr, 10);
+	}
 
-	vecValues.clear();
+	return LuaNumberToInt64(lua_tonumber(p_pLuaState, p_nIndex));
 }
 
-ProtocolGenerator * ProtocolGenerator::Create(const std::string & p_strProtocolFileName)
+static uint64_t GetLuaUInt64Value(lua_State * p_pLuaState, int32_t p_nIndex)
 {
-	ProtocolGenerator * pGenerator = new (std::nothrow) ProtocolGenerator();
+	if (lua_type(p_pLuaState, p_nIndex) == LUA_TSTRING)
+	{
+		return strtoull(lua_tostring(p_pLuaState, p_nIndex), nullptr, 10);
+	}
 
-	if (nullptr == pGenerator || !pGenerator->Initialize(p_strProtocolFileName))
+	// 2^63以上的值直接转换，其余的和uint32一样经过int64_t，负数按补码截断
+
+	lua_Number fValue = lua_tonumber(p_pLuaState, p_nIndex);
+
+	if (fValue >= 9223372036854775808.0)
 	{
-		CC_SAFE_DELETE(pGenerator);
+		return fValue < 18446744073709551616.0 ? static_cast<uint64_t>(fValue) : UINT64_MAX;
 	}
 
-	return pGenerator;
+	return static_cast<uint64_t>(LuaNumberToInt64(fValue));
 }
 
-ProtocolGenerator::ProtocolGenerator()
+static uint64_t GetWireInt32Value(google::protobuf::FieldDescriptor::Type p_eType, int32_t p_nValue)
 {
-	this->m_pImporter = nullptr;
-}
+	if (p_eType == google::protobuf::FieldDescriptor::TYPE_SINT32)
+	{
+		return google::protobuf::internal::WireFormatLite::ZigZagEncode32(p_nValue);
+	}
 
-ProtocolGenerator::~ProtocolGenerator()
-{
-	CC_SAFE_DELETE(this->m_pImporter);
+	if (p_eType == google::protobuf::FieldDescriptor::TYPE_SFIXED32)
+	{
+		return static_cast<uint32_t>(p_nValue);
+	}
+
+	return static_cast<uint64_t>(static_cast<int64_t>(p_nValue)); // int32和enum的负数按64位符号扩展编码
 }
 
-bool ProtocolGenerator::Initialize(const std::string & p_strProtocolFileName)
+static uint64_t GetWireInt64Value(google::protobuf::FieldDescriptor::Type p_eType, int64_t p_nValue)
 {
-	bool bSuccess = false;
-
-	do 
+	if (p_eType == google::protobuf::FieldDescriptor::TYPE_SINT64)
 	{
-		CC_BREAK_IF(p_strProtocolFileName.empty());
+		return google::protobuf::internal::WireFormatLite::ZigZagEncode64(p_nValue);
+	}
 
-		std::string strFullPath = CCFileUtils::getInstance()->fullPathForFilename(p_strProtocolFileName);
+	return static_cast<uint64_t>(p_nValue);
+}
 
-		if (!CCFileUtils::getInstance()->isFileExist(strFullPath))
-		{
-			CCLOGERROR("Protocol File \"%s\" Not Exist!", strFullPath.c_str()); break;
-		}
+static void PushLuaInt64Value(lua_State * p_pLuaState, int64_t p_nValue)
+{
+#if defined __LUA_SET_INT64_AS_STRING__
+	char szValue[30] = {0};
 
-		google::protobuf::compiler::DiskSourceTree cSourceTree;
+	sprintf(szValue, "%lld", static_cast<long long>(p_nValue));
 
-		cSourceTree.MapPath("", strFullPath.c_str());
+	lua_pushstring(p_pLuaState, szValue);
+#else
+	lua_pushnumber(p_pLuaState, static_cast<lua_Number>(p_nValue));
+#endif
+}
 
-		this->m_pImporter = new (std::nothrow) google::protobuf::compiler::Importer(&cSourceTree, nullptr);
+static void PushLuaUInt64Value(lua_State * p_pLuaState, uint64_t p_uValue)
+{
+#if defined __LUA_SET_INT64_AS_STRING__
+	char szValue[30] = {0};
 
-		CC_BREAK_IF(nullptr == this->m_pImporter);
-		CC_BREAK_IF(nullptr == this->m_pImporter->Import(p_strProtocolFileName));
+	sprintf(szValue, "%llu", static_cast<unsigned long long>(p_uValue));
 
-		bSuccess = true;
-	}
-	while (false);
-	
-	return bSuccess;
+	lua_pushstring(p_pLuaState, szValue);
+#else
+	lua_pushnumber(p_pLuaState, static_cast<lua_Number>(p_uValue));
+#endif
 }
 
-bool ProtocolGenerator::ParseMessage(const char * p_pszMessageName, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState)
+static int32_t GetWirePackedCount(google::protobuf::io::CodedInputStream & p_cInput, google::protobuf::FieldDescriptor::Type p_eType, uint32_t p_uLength)
 {
-	if (nullptr == p_pLuaState)
-	{
-		return false;
-	}
+	// packed数据中的元素个数，用来预分配Lua数组；长度超出剩余数据时返回0，交给后面的解码报错
 
-	google::protobuf::Message * pMessage = this->GenerateMessage(p_pszMessageName, p_pszDataBuffer, p_nDataSize);
+	const void * pData = nullptr;
 
-	if (nullptr == pMessage)
+	int32_t nSize = 0;
+
+	if (!p_cInput.GetDirectBufferPointer(&pData, &nSize) || static_cast<uint32_t>(nSize) < p_uLength)
 	{
-		return false;
+		return 0;
 	}
 
-	lua_newtable(p_pLuaState);
-
-	bool bSucces = true;
-
-	if (!this->ParseMessage(pMessage, p_pLuaState))
+	switch (p_eType)
 	{
-		bSucces = false;
+	case google::protobuf::FieldDescriptor::TYPE_FIXED32:
+	case google::protobuf::FieldDescriptor::TYPE_SFIXED32:
+	case google::protobuf::FieldDescriptor::TYPE_FLOAT:
+		return static_cast<int32_t>(p_uLength / 4);
+	case google::protobuf::FieldDescriptor::TYPE_FIXED64:
+	case google::protobuf::FieldDescriptor::TYPE_SFIXED64:
+	case google::protobuf::FieldDescriptor::TYPE_DOUBLE:
+		return static_cast<int32_t>(p_uLength / 8);
+	default:
+		break;
 	}
 
-	pMessage->Clear();
-
-	CC_SAFE_DELETE(pMessage);
+	// varint的最后一个字节最高位为0
 
-	return bSucces;
-}
+	const uint8_t * pBytes = static_cast<const uint8_t *>(pData);
 
-bool ProtocolGenerator::ParseMessage(google::protobuf::Message * p_pMessage, lua_State * p_pLuaState)
-{
-	bool bSuccess = false;
+	int32_t nCount = 0;
 
-	do 
+	for (uint32_t i = 0; i < p_uLength; ++i)
 	{
-		CC_BREAK_IF(nullptr == p_pMessage);
-		CC_BREAK_IF(nullptr == p_pLuaState);
+		nCount += pBytes[i] < 0x80 ? 1 : 0;
+	}
 
-		const google::protobuf::Descriptor * pDescriptor = p_pMessage->GetDescriptor();
+	return nCount;
+}
 
-		CC_BREAK_IF(nullptr == pDescriptor);
+static bool ReadWireVarint(const uint8_t *& p_pData, const uint8_t * p_pEnd, uint64_t & p_uValue)
+{
+	// 和CodedInputStream::ReadVarint64一样最多读取10个字节，32位的类型再截断
 
-		const google::protobuf::Reflection * pReflection = p_pMessage->GetReflection();
+	p_uValue = 0;
 
-		CC_BREAK_IF(nullptr == pReflection);
+	for (uint32_t uShift = 0; uShift < 70 && p_pData < p_pEnd; uShift += 7)
+	{
+		uint8_t uByte = *p_pData++;
 
-		bSuccess = true;
+		p_uValue |= static_cast<uint64_t>(uByte & 0x7F) << uShift;
 
-		int32_t nFieldCount = pDescriptor->field_count();
+		if (uByte < 0x80)
+		{
+			return true;
+		}
+	}
 
-		CC_BREAK_IF(nFieldCount <= 0);
+	return false;
+}
 
-		const google::protobuf::FieldDescriptor * pField = nullptr;
+template <typename PushHandler>
+static bool DecodeWirePackedVarints(const uint8_t * p_pData, const uint8_t * p_pEnd, lua_State * p_pLuaState, int32_t & p_nCount, PushHandler p_fnPush)
+{
+	uint64_t uValue = 0;
 
-		for (int32_t i = 0; i < nFieldCount; ++i)
+	while (p_pData < p_pEnd)
+	{
+		if (!ReadWireVarint(p_pData, p_pEnd, uValue))
 		{
-			bSuccess = false;
-
-			pField = pDescriptor->field(i);
-
-			CC_BREAK_IF(nullptr == pField);
-			CC_BREAK_IF(!this->_ParseFieldData(p_pMessage, pField, p_pLuaState));
+			return false;
+		}
 
-			bSuccess = true;
+		if (p_fnPush(uValue))
+		{
+			lua_rawseti(p_pLuaState, -2, ++p_nCount);
 		}
 	}
-	while (false);
 
-	return bSuccess;
+	return true;
 }
 
-google::protobuf::Message * ProtocolGenerator::GenerateMessage(const char * p_pszMessageName, lua_State * p_pLuaState, int32_t p_nIndex)
+template <typename PushHandler>
+static bool DecodeWirePackedFixed32s(const uint8_t * p_pData, const uint8_t * p_pEnd, lua_State * p_pLuaState, int32_t & p_nCount, PushHandler p_fnPush)
 {
-	google::protobuf::Message * pMessage = nullptr;
-
-	do
+	if (0 != (p_pEnd - p_pData) % 4)
 	{
-		CC_BREAK_IF(nullptr == p_pLuaState || p_nIndex < 0);
-		CC_BREAK_IF(!CC_IS_VALID_ANSI_STR(p_pszMessageName));
+		return false;
+	}
 
-		std::vector<ProtocolGenerator::ProtocolData> vecTableValues;
+	uint32_t uValue = 0;
 
-		CC_BREAK_IF(!this->_AnalysisTableData(vecTableValues, p_pLuaState, p_nIndex));
+	while (p_pData < p_pEnd)
+	{
+		p_pData = google::protobuf::io::CodedInputStream::ReadLittleEndian32FromArray(p_pData, &uValue);
 
-		pMessage = this->GenerateMessage(p_pszMessageName, vecTableValues);
+		p_fnPush(uValue);
+
+		lua_rawseti(p_pLuaState, -2, ++p_nCount);
 	}
-	while (false);
 
-	return pMessage;
+	return true;
 }
 
-google::protobuf::Message * ProtocolGenerator::GenerateMessage(const char * p_pszMessageName, const std::vector<ProtocolGenerator::ProtocolData> & p_vecValues)
+template <typename PushHandler>
+static bool DecodeWirePackedFixed64s(const uint8_t * p_pData, const uint8_t * p_pEnd, lua_State * p_pLuaState, int32_t & p_nCount, PushHandler p_fnPush)
 {
-	google::protobuf::Message * pMessage = nullptr;
+	if (0 != (p_pEnd - p_pData) % 8)
+	{
+		return false;
+	}
 
-	do
+	uint64_t uValue = 0;
+
+	while (p_pData < p_pEnd)
 	{
-		CC_BREAK_IF(!CC_IS_VALID_ANSI_STR(p_pszMessageName));
-		CC_BREAK_IF(nullptr == this->m_pImporter);
+		p_pData = google::protobuf::io::CodedInputStream::ReadLittleEndian64FromArray(p_pData, &uValue);
 
-		const google::protobuf::Descriptor * pDescriptor = this->m_pImporter->pool()->FindMessageTypeByName(p_pszMessageName);
+		p_fnPush(uValue);
 
-		CC_BREAK_IF(nullptr == pDescriptor);
+		lua_rawseti(p_pLuaState, -2, ++p_nCount);
+	}
 
-		const google::protobuf::Message * pPrototype = this->m_cMessageFactory.GetPrototype(pDescriptor);
+	return true;
+}
 
-		CC_BREAK_IF(nullptr == pPrototype);
+static bool DecodeWirePackedValues(const ProtocolGenerator::FieldPlan * p_pFieldPlan, const uint8_t * p_pData, const uint8_t * p_pEnd, lua_State * p_pLuaState, int32_t & p_nCount)
+{
+	// 直接从内存中批量解码packed数组追加到栈顶的table，每个类型的转换和_DecodeWireValue一致，类型只在这里判断一次
+
+	switch (p_pFieldPlan->eType)
+	{
+	case google::protobuf::FieldDescriptor::TYPE_INT32:
+		return DecodeWirePackedVarints(p_pData, p_pEnd, p_pLuaState, p_nCount, [p_pLuaState](uint64_t p_uValue) { lua_pushnumber(p_pLuaState, static_cast<int32_t>(p_uValue)); return true; });
+	case google::protobuf::FieldDescriptor::TYPE_SINT32:
+		return DecodeWirePackedVarints(p_pData, p_pEnd, p_pLuaState, p_nCount, [p_pLuaState](uint64_t p_uValue) { lua_pushnumber(p_pLuaState, google::protobuf::internal::WireFormatLite::ZigZagDecode32(static_cast<uint32_t>(p_uValue))); return true; });
+	case google::protobuf::FieldDescriptor::TYPE_UINT32:
+		return DecodeWirePackedVarints(p_pData, p_pEnd, p_pLuaState, p_nCount, [p_pLuaState](uint64_t p_uValue) { lua_pushnumber(p_pLuaState, static_cast<uint32_t>(p_uValue)); return true; });
+	case google::protobuf::FieldDescriptor::TYPE_INT64:
+		return DecodeWirePackedVarints(p_pData, p_pEnd, p_pLuaState, p_nCount, [p_pLuaState](uint64_t p_uValue) { PushLuaInt64Value(p_pLuaState, static_cast<int64_t>(p_uValue)); return true; });
+	case google::protobuf::FieldDescriptor::TYPE_SINT64:
+		return DecodeWirePackedVarints(p_pData, p_pEnd, p_pLuaState, p_nCount, [p_pLuaState](uint64_t p_uValue) { PushLuaInt64Value(p_pLuaState, google::protobuf::internal::WireFormatLite::ZigZagDecode64(p_uValue)); return true; });
+	case google::protobuf::FieldDescriptor::TYPE_UINT64:
+		return DecodeWirePackedVarints(p_pData, p_pEnd, p_pLuaState, p_nCount, [p_pLuaState](uint64_t p_uValue) { PushLuaUInt64Value(p_pLuaState, p_uValue); return true; });
+	case google::protobuf::FieldDescriptor::TYPE_BOOL:
+		return DecodeWirePackedVarints(p_pData, p_pEnd, p_pLuaState, p_nCount, [p_pLuaState](uint64_t p_uValue) { lua_pushboolean(p_pLuaState, 0 != p_uValue); return true; });
+	case google::protobuf::FieldDescriptor::TYPE_ENUM:
+		{
+			// proto2中未定义的枚举值直接丢弃
 
-		pMessage = pPrototype->New();
+			const google::protobuf::EnumDescriptor * pEnumType = p_pFieldPlan->bClosedEnum ? p_pFieldPlan->pField->enum_type() : nullptr;
 
-		CC_BREAK_IF(nullptr == pMessage);
-		CC_BREAK_IF(this->_FillMessageDatas(pMessage, pDescriptor, p_vecValues));
+			return DecodeWirePackedVarints(p_pData, p_pEnd, p_pLuaState, p_nCount, [p_pLuaState, pEnumType](uint64_t p_uValue)
+			{
+				int32_t nValue = static_cast<int32_t>(p_uValue);
 
-		pMessage->Clear();
+				if (nullptr != pEnumType && nullptr == pEnumType->FindValueByNumber(nValue))
+				{
+					return false;
+				}
 
-		CC_SAFE_DELETE(pMessage);
-	}
-	while (false);
+				lua_pushnumber(p_pLuaState, nValue);
 
-	return pMessage;
+				return true;
+			});
+		}
+	case google::protobuf::FieldDescriptor::TYPE_FIXED32:
+		return DecodeWirePackedFixed32s(p_pData, p_pEnd, p_pLuaState, p_nCount, [p_pLuaState](uint32_t p_uValue) { lua_pushnumber(p_pLuaState, p_uValue); });
+	case google::protobuf::FieldDescriptor::TYPE_SFIXED32:
+		return DecodeWirePackedFixed32s(p_pData, p_pEnd, p_pLuaState, p_nCount, [p_pLuaState](uint32_t p_uValue) { lua_pushnumber(p_pLuaState, static_cast<int32_t>(p_uValue)); });
+	case google::protobuf::FieldDescriptor::TYPE_FLOAT:
+		return DecodeWirePackedFixed32s(p_pData, p_pEnd, p_pLuaState, p_nCount, [p_pLuaState](uint32_t p_uValue) { lua_pushnumber(p_pLuaState, google::protobuf::internal::WireFormatLite::DecodeFloat(p_uValue)); });
+	case google::protobuf::FieldDescriptor::TYPE_FIXED64:
+		return DecodeWirePackedFixed64s(p_pData, p_pEnd, p_pLuaState, p_nCount, [p_pLuaState](uint64_t p_uValue) { PushLuaUInt64Value(p_pLuaState, p_uValue); });
+	case google::protobuf::FieldDescriptor::TYPE_SFIXED64:
+		return DecodeWirePackedFixed64s(p_pData, p_pEnd, p_pLuaState, p_nCount, [p_pLuaState](uint64_t p_uValue) { PushLuaInt64Value(p_pLuaState, static_cast<int64_t>(p_uValue)); });
+	case google::protobuf::FieldDescriptor::TYPE_DOUBLE:
+		return DecodeWirePackedFixed64s(p_pData, p_pEnd, p_pLuaState, p_nCount, [p_pLuaState](uint64_t p_uValue) { lua_pushnumber(p_pLuaState, google::protobuf::internal::WireFormatLite::DecodeDouble(p_uValue)); });
+	default:
+		break;
+	}
+
+	return false;
 }
 
-google::protobuf::Message * ProtocolGenerator::GenerateMessage(const char * p_pszMessageName, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize)
+static bool IsWireTypeAccepted(const ProtocolGenerator::FieldPlan * p_pFieldPlan, uint32_t p_uWireType)
 {
-	google::protobuf::Message * pMessage = nullptr;
-
-	do
+	if (p_uWireType == google::protobuf::internal::WireFormatLite::GetTagWireType(p_pFieldPlan->uTag))
 	{
-		CC_BREAK_IF(!CC_IS_VALID_ANSI_STR(p_pszMessageName));
-		CC_BREAK_IF(nullptr == p_pszDataBuffer || p_nDataSize <= 0);
-		CC_BREAK_IF(nullptr == this->m_pImporter);
+		return true;
+	}
 
-		const google::protobuf::Descriptor * pDescriptor = this->m_pImporter->pool()->FindMessageTypeByName(p_pszMessageName);
+	// 数值类型的repeated字段不论是否声明为packed，两种编码都要能解析
 
-		CC_BREAK_IF(nullptr == pDescriptor);
+	return p_pFieldPlan->bRepeated && nullptr == p_pFieldPlan->pChildPlan && p_uWireType == google::protobuf::internal::WireFormatLite::WIRETYPE_LENGTH_DELIMITED && p_pFieldPlan->eType != google::protobuf::FieldDescriptor::TYPE_STRING && p_pFieldPlan->eType != google::protobuf::FieldDescriptor::TYPE_BYTES;
+}
 
-		const google::protobuf::Message * pPrototype = this->m_cMessageFactory.GetPrototype(pDescriptor);
+static int32_t ReadFrameField(const unsigned char * p_pszData, size_t p_uSize, ProtocolGenerator::FRAME_FIELD_TYPE p_eType, bool p_bBigEndian, uint32_t & p_uValue)
+{
+	// 返回读取的字节数，数据不够时返回0，格式错误时返回-1
 
-		CC_BREAK_IF(nullptr == pPrototype);
+	switch (p_eType)
+	{
+	case ProtocolGenerator::FRAME_FIELD_TYPE::FRAME_FIELD_FIXED16:
+		if (p_uSize < 2) return 0;
+		p_uValue = p_bBigEndian ? (p_pszData[0] << 8) | p_pszData[1] : (p_pszData[1] << 8) | p_pszData[0];
+		return 2;
+	case ProtocolGenerator::FRAME_FIELD_TYPE::FRAME_FIELD_FIXED32:
+		if (p_uSize < 4) return 0;
+		p_uValue = p_bBigEndian
+			? (static_cast<uint32_t>(p_pszData[0]) << 24) | (p_pszData[1] << 16) | (p_pszData[2] << 8) | p_pszData[3]
+			: (static_cast<uint32_t>(p_pszData[3]) << 24) | (p_pszData[2] << 16) | (p_pszData[1] << 8) | p_pszData[0];
+		return 4;
+	default:
+		break;
+	}
 
-		pMessage = pPrototype->New();
+	p_uValue = 0;
 
-		CC_BREAK_IF(nullptr == pMessage);
-		CC_BREAK_IF(pMessage->ParseFromArray(p_pszDataBuffer, p_nDataSize));
+	for (size_t i = 0; i < 5; ++i)
+	{
+		if (i >= p_uSize)
+		{
+			return 0;
+		}
 
-		pMessage->Clear();
+		p_uValue |= static_cast<uint32_t>(p_pszData[i] & 0x7F) << (7 * i);
 
-		CC_SAFE_DELETE(pMessage);
+		if (p_pszData[i] < 0x80)
+		{
+			return static_cast<int32_t>(i + 1);
+		}
 	}
-	while (false);
 
-	return pMessage;
+	return -1;
 }
 
-bool ProtocolGenerator::_FillMessageDatas(google::protobuf::Message * p_pMessage, const google::protobuf::Descriptor * p_pDescriptor, const std::vector<ProtocolGenerator::ProtocolData> & p_vecValues)
+static size_t WriteFrameField(uint8_t * p_pCursor, uint32_t p_uValue, ProtocolGenerator::FRAME_FIELD_TYPE p_eType, bool p_bBigEndian)
 {
-	if (nullptr == p_pMessage || nullptr == p_pDescriptor)
+	// 返回写入的字节数，fixed16放不下时返回0
+
+	switch (p_eType)
 	{
-		return false;
+	case ProtocolGenerator::FRAME_FIELD_TYPE::FRAME_FIELD_FIXED16:
+		if (p_uValue > 0xFFFF) return 0;
+		p_pCursor[p_bBigEndian ? 0 : 1] = static_cast<uint8_t>(p_uValue >> 8);
+		p_pCursor[p_bBigEndian ? 1 : 0] = static_cast<uint8_t>(p_uValue);
+		return 2;
+	case ProtocolGenerator::FRAME_FIELD_TYPE::FRAME_FIELD_FIXED32:
+		for (size_t i = 0; i < 4; ++i)
+		{
+			p_pCursor[p_bBigEndian ? 3 - i : i] = static_cast<uint8_t>(p_uValue >> (8 * i));
+		}
+		return 4;
+	default:
+		break;
 	}
 
-	const google::protobuf::Reflection * pReflection = p_pMessage->GetReflection();
+	return google::protobuf::io::CodedOutputStream::WriteVarint32ToArray(p_uValue, p_pCursor) - p_pCursor;
+}
 
-	if (nullptr == pReflection)
+static bool IsLuaTableEmpty(lua_State * p_pLuaState, int32_t p_nIndex)
+{
+	lua_pushnil(p_pLuaState);
+
+	if (0 == lua_next(p_pLuaState, p_nIndex))
 	{
-		return CCLOGERROR("Message Type \"%s\"'s Reflection Is NULL!", p_pMessage->GetTypeName().c_str()), false;
+		return true;
 	}
 
-	int32_t nFieldCount = p_pDescriptor->field_count();
+	lua_pop(p_pLuaState, 2); // pop key + value
+
+	return false;
+}
 
-	if (nFieldCount <= 0)
+static bool GetLuaBoolValue(lua_State * p_pLuaState, int32_t p_nIndex, bool & p_bValue)
+{
+	int32_t nType = lua_type(p_pLuaState, p_nIndex);
+
+	if (nType == LUA_TBOOLEAN)
 	{
-		return true;
+		p_bValue = lua_toboolean(p_pLuaState, p_nIndex) == 1;
+	}
+	else if (nType == LUA_TSTRING && 0 == strcmp(lua_tostring(p_pLuaState, p_nIndex), "true"))
+	{
+		p_bValue = true;
+	}
+	else if (nType == LUA_TSTRING && 0 == strcmp(lua_tostring(p_pLuaState, p_nIndex), "false"))
+	{
+		p_bValue = false;
+	}
+	else
+	{
+		return false;
 	}
 
-	const google::protobuf::FieldDescriptor * pField = nullptr;
+	return true;
+}
+
+ProtocolGenerator::_ProtocolData::_ProtocolData()
+{
+	Clean();
+}
 
-	const ProtocolGenerator::ProtocolData * pProtocolData = nullptr;
+void ProtocolGenerator::_ProtocolData::Clean()
+{
+	eDataType = ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_VALUE;
 
-	bool bSuccess = true;
+	strField.clear();
+	strValue.clear();
 
-	for (int32_t i = 0; i < nFieldCount; ++i)
-	{
-		bSuccess = false;
+	vecValues.clear();
+}
 
-		pProtocolData = nullptr;
+ProtocolGenerator::_FieldPlan::_FieldPlan()
+{
+	pField = nullptr;
+	pOneof = nullptr;
 
-		pField = p_pDescriptor->field(i);
+	pContainingPlan = nullptr;
 
-		CC_BREAK_IF(nullptr == pField);
+	nLuaNameIndex = 0;
 
-		auto pIterFind = std::find_if(p_vecValues.begin(), p_vecValues.end(), std::bind2nd(FindProtocolDataByField(), pField->name()));
+	eType = google::protobuf::FieldDescriptor::TYPE_INT32;
 
-		if (pIterFind != p_vecValues.end())
-		{
-			pProtocolData = &(*pIterFind);
-		}
+	pFillValueHandler    = nullptr;
+	pFillRepeatedHandler = nullptr;
+	pFillLuaValueHandler = nullptr;
+	pParseHandler        = nullptr;
 
-		CC_BREAK_IF(!this->_FillMessageFileValue(p_pMessage, pField, pReflection, pProtocolData));
+	bRequired    = false;
+	bRepeated    = false;
+	bHasPresence = false;
+	bClosedEnum  = false;
 
-		bSuccess = true;
-	}
+	bMergeReplace = false;
 
-	return bSuccess;
+	uTag       = 0;
+	uPackedTag = 0;
+
+	pChildPlan = nullptr;
 }
 
-bool ProtocolGenerator::_FillMessageFileValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData)
+ProtocolGenerator::_MessagePlan::_MessagePlan()
 {
-	if (nullptr == p_pMessage || nullptr == p_pField || nullptr == p_pReflection)
+	pDescriptor = nullptr;
+	pPrototype  = nullptr;
+
+	bSparse = false;
+
+	bMessageId = false;
+	uMessageId = 0;
+}
+
+const ProtocolGenerator::FieldPlan * ProtocolGenerator::_MessagePlan::FindFieldPlan(int32_t p_nNumber) const
+{
+	if (!this->vecNumberFields.empty())
 	{
-		return false;
+		return (p_nNumber > 0 && p_nNumber < static_cast<int32_t>(this->vecNumberFields.size())) ? this->vecNumberFields[p_nNumber] : nullptr;
 	}
 
-	if (p_pField->is_required())
+	auto pIterFind = std::lower_bound(this->vecWireFields.begin(), this->vecWireFields.end(), p_nNumber, [](const ProtocolGenerator::FieldPlan * p_pFieldPlan, int32_t p_nValue)
 	{
-		if (nullptr == p_pProtocolData)
-		{
-			return CCLOGERROR("Field \"%s\"'s Value Is Required! Message Type : \"%s\".", p_pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
-		}
+		return p_pFieldPlan->pField->number() < p_nValue;
+	});
+
+	if (pIterFind == this->vecWireFields.end() || (*pIterFind)->pField->number() != p_nNumber)
+	{
+		return nullptr;
 	}
 
-	google::protobuf::FieldDescriptor::CppType eType = p_pField->cpp_type();
+	return *pIterFind;
+}
 
-	if (eType == google::protobuf::FieldDescriptor::CPPTYPE_INT32)
+int32_t ProtocolGenerator::_MessagePlan::FindFieldIndex(const std::string & p_strName) const
+{
+	auto pIterFind = this->mapNameIndexes.find(p_strName);
+
+	if (pIterFind == this->mapNameIndexes.end())
 	{
-		if (p_pField->is_repeated())
-		{
-			return this->_FillRepeatedInt32Value(p_pMessage, p_pField, p_pReflection, p_pProtocolData);
-		}
-		return this->_FillInt32Value(p_pMessage, p_pField, p_pReflection, p_pProtocolData, false);
+		return -1;
 	}
-	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_INT64)
-	{
-		if (p_pField->is_repeated())
-		{
-			return this->_FillRepeatedInt64Value(p_pMessage, p_pField, p_pReflection, p_pProtocolData);
+
+	return pIterFind->second;
+}
+
+ProtocolGenerator::_DecodedValue::_DecodedValue()
+{
+	pFieldPlan = nullptr;
+	eValueType = ProtocolGenerator::DECODED_VALUE_TYPE::DECODED_VALUE_NIL;
+
+	uUInt64 = 0;
+}
+
+ProtocolGenerator::_DecodedMessage::_DecodedMessage()
+{
+	Clean();
+}
+
+void ProtocolGenerator::_DecodedMessage::Clean()
+{
+	pMessagePlan = nullptr;
+
+	bSparse = false;
+
+	strBuffer.clear();
+	vecValues.clear();
+}
+
+ProtocolGenerator::_ArenaStatistics::_ArenaStatistics()
+{
+	Clean();
+}
+
+void ProtocolGenerator::_ArenaStatistics::Clean()
+{
+	uSpaceAllocated     = 0;
+	uSpaceUsed          = 0;
+	uPeakSpaceAllocated = 0;
+
+	uMessageCount = 0;
+	uResetCount   = 0;
+}
+
+ProtocolGenerator::_MessagePoolStatistics::_MessagePoolStatistics()
+{
+	Clean();
+}
+
+void ProtocolGenerator::_MessagePoolStatistics::Clean()
+{
+	uPooledCount   = 0;
+	uHitCount      = 0;
+	uMissCount     = 0;
+	uOverflowCount = 0;
+}
+
+ProtocolGenerator::_MessageRecycler::_MessageRecycler()
+{
+	pGenerator = nullptr;
+}
+
+ProtocolGenerator::_MessageRecycler::_MessageRecycler(ProtocolGenerator * p_pGenerator)
+{
+	pGenerator = p_pGenerator;
+}
+
+void ProtocolGenerator::_MessageRecycler::operator()(google::protobuf::Message * p_pMessage) const
+{
+	if (nullptr == pGenerator)
+	{
+		ProtocolGenerator::DestroyMessage(p_pMessage); return;
+	}
+
+	pGenerator->RecycleMessage(p_pMessage);
+}
+
+ProtocolGenerator::_Context::_Context()
+{
+	pGenerator = nullptr;
+	pNext      = nullptr;
+
+	pArena      = nullptr;
+	pOwnedArena = nullptr;
+
+	uMessagePoolLimit = 32;
+
+	nLuaNameCacheIndex = 0;
+
+	nLuaTablePoolIndex = 0;
+	nLuaTablePoolSize  = 0;
+
+	bSparseDecode = false;
+	bMergeDecode  = false;
+}
+
+ProtocolGenerator::_Context::_Context(ProtocolGenerator * p_pGenerator) : _Context()
+{
+	if (nullptr == p_pGenerator)
+	{
+		return;
+	}
+
+	// 同一个线程对同一个ProtocolGenerator重复绑定时，后构造的Context生效，析构之后恢复之前的
+
+	p_pGenerator->_FreezeMessagePlans();
+
+	pGenerator = p_pGenerator;
+	pNext      = s_pThreadContexts;
+
+	s_pThreadContexts = this;
+}
+
+ProtocolGenerator::_Context::~_Context()
+{
+	if (nullptr != pGenerator)
+	{
+		ProtocolGenerator::Context ** ppContext = &s_pThreadContexts;
+
+		while (nullptr != *ppContext && this != *ppContext)
+		{
+			ppContext = &(*ppContext)->pNext;
+		}
+
+		if (nullptr != *ppContext)
+		{
+			*ppContext = pNext;
+		}
+		else
+		{
+			CCLOGERROR("Protocol Context Is Not Destroyed In The Thread It Was Created!");
+		}
+	}
+
+	this->Clean();
+}
+
+void ProtocolGenerator::_Context::Clean()
+{
+	for (auto pIter = mapMessagePools.begin(), pIterEnd = mapMessagePools.end(); pIter != pIterEnd; ++pIter)
+	{
+		for (google::protobuf::Message * pMessage : pIter->second)
+		{
+			delete pMessage;
+		}
+	}
+
+	mapMessagePools.clear();
+
+	cMessagePoolStatistics.uPooledCount = 0;
+
+	pArena = nullptr;
+
+	CC_SAFE_DELETE(pOwnedArena);
+}
+
+ProtocolGenerator::_MessageView::_MessageView()
+{
+	pGenerator = nullptr;
+
+	pMessagePlan = nullptr;
+	pFieldPlan   = nullptr;
+
+	pData = nullptr;
+	nSize = 0;
+
+	bCache    = false;
+	nCacheRef = LUA_NOREF;
+}
+
+ProtocolGenerator::_FrameFormat::_FrameFormat()
+{
+	eLengthType = ProtocolGenerator::FRAME_FIELD_TYPE::FRAME_FIELD_FIXED32;
+	eIdType     = ProtocolGenerator::FRAME_FIELD_TYPE::FRAME_FIELD_FIXED32;
+
+	bBigEndian = true;
+
+	uMaxFrameSize = 16 * 1024 * 1024;
+}
+
+ProtocolGenerator::_WireValue::_WireValue()
+{
+	uValue = 0;
+
+	pszData = nullptr;
+	uLength = 0;
+}
+
+ProtocolGenerator::_WireEncodeContext::_WireEncodeContext()
+{
+	Reset();
+}
+
+void ProtocolGenerator::_WireEncodeContext::WriteVarint(uint64_t p_uValue)
+{
+	if (bSizing)
+	{
+		uSize += google::protobuf::io::CodedOutputStream::VarintSize64(p_uValue);
+	}
+	else
+	{
+		pCursor = google::protobuf::io::CodedOutputStream::WriteVarint64ToArray(p_uValue, pCursor);
+	}
+}
+
+void ProtocolGenerator::_WireEncodeContext::WriteFixed32(uint32_t p_uValue)
+{
+	if (bSizing)
+	{
+		uSize += sizeof(uint32_t);
+	}
+	else
+	{
+		pCursor = google::protobuf::io::CodedOutputStream::WriteLittleEndian32ToArray(p_uValue, pCursor);
+	}
+}
+
+void ProtocolGenerator::_WireEncodeContext::WriteFixed64(uint64_t p_uValue)
+{
+	if (bSizing)
+	{
+		uSize += sizeof(uint64_t);
+	}
+	else
+	{
+		pCursor = google::protobuf::io::CodedOutputStream::WriteLittleEndian64ToArray(p_uValue, pCursor);
+	}
+}
+
+void ProtocolGenerator::_WireEncodeContext::WriteBytes(const char * p_pszData, size_t p_uLength)
+{
+	if (bSizing)
+	{
+		uSize += p_uLength;
+	}
+	else if (p_uLength > 0)
+	{
+		memcpy(pCursor, p_pszData, p_uLength);
+
+		pCursor += p_uLength;
+	}
+}
+
+void ProtocolGenerator::_WireEncodeContext::WriteValue(uint32_t p_uWireType, const ProtocolGenerator::_WireValue & p_cValue)
+{
+	if (p_uWireType == google::protobuf::internal::WireFormatLite::WIRETYPE_VARINT)
+	{
+		WriteVarint(p_cValue.uValue);
+	}
+	else if (p_uWireType == google::protobuf::internal::WireFormatLite::WIRETYPE_FIXED32)
+	{
+		WriteFixed32(static_cast<uint32_t>(p_cValue.uValue));
+	}
+	else if (p_uWireType == google::protobuf::internal::WireFormatLite::WIRETYPE_FIXED64)
+	{
+		WriteFixed64(p_cValue.uValue);
+	}
+	else
+	{
+		WriteVarint(p_cValue.uLength);
+		WriteBytes(p_cValue.pszData, p_cValue.uLength);
+	}
+}
+
+size_t ProtocolGenerator::_WireEncodeContext::BeginLength()
+{
+	if (bSizing)
+	{
+		vecLengths.push_back(0);
+
+		return vecLengths.size() - 1;
+	}
+
+	WriteVarint(vecLengths[uLengthIndex]);
+
+	return uLengthIndex++;
+}
+
+void ProtocolGenerator::_WireEncodeContext::EndLength(size_t p_uLengthIndex, size_t p_uStartSize)
+{
+	if (bSizing)
+	{
+		// 长度前缀写在内容之前，但只有计算完内容之后才能知道它占用的字节数
+
+		uint32_t uLength = static_cast<uint32_t>(uSize - p_uStartSize);
+
+		vecLengths[p_uLengthIndex] = uLength;
+
+		uSize += google::protobuf::io::CodedOutputStream::VarintSize32(uLength);
+	}
+}
+
+void ProtocolGenerator::_WireEncodeContext::Reset()
+{
+	bSizing = true;
+
+	uSize   = 0;
+	pCursor = nullptr;
+
+	vecLengths.clear();
+	uLengthIndex = 0;
+}
+
+ProtocolGenerator * ProtocolGenerator::Create(const std::string & p_strProtocolFileName)
+{
+	ProtocolGenerator * pGenerator = new (std::nothrow) ProtocolGenerator();
+
+	if (nullptr == pGenerator || !pGenerator->Initialize(p_strProtocolFileName))
+	{
+		CC_SAFE_DELETE(pGenerator);
+	}
+
+	return pGenerator;
+}
+
+ProtocolGenerator * ProtocolGenerator::CreateFromDescriptorSet(const std::string & p_strDescriptorSetFileName)
+{
+	ProtocolGenerator * pGenerator = new (std::nothrow) ProtocolGenerator();
+
+	if (nullptr == pGenerator || !pGenerator->InitializeFromDescriptorSet(p_strDescriptorSetFileName))
+	{
+		CC_SAFE_DELETE(pGenerator);
+	}
+
+	return pGenerator;
+}
+
+ProtocolGenerator * ProtocolGenerator::CreateFromDescriptorSet(const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize)
+{
+	ProtocolGenerator * pGenerator = new (std::nothrow) ProtocolGenerator();
+
+	if (nullptr == pGenerator || !pGenerator->InitializeFromDescriptorSet(p_pszDataBuffer, p_nDataSize))
+	{
+		CC_SAFE_DELETE(pGenerator);
+	}
+
+	return pGenerator;
+}
+
+ProtocolGenerator::ProtocolGenerator()
+{
+	static std::atomic<uint32_t> s_uLuaNameCacheSerial(0);
+
+	this->m_pImporter = nullptr;
+	this->m_pDescriptorPool = nullptr;
+
+	this->m_uLuaNameCacheSerial = ++s_uLuaNameCacheSerial;
+
+	this->m_bMessagePlansFrozen.store(false, std::memory_order_relaxed);
+}
+
+ProtocolGenerator::~ProtocolGenerator()
+{
+	for (auto pIter = this->m_mapMessagePlans.begin(), pIterEnd = this->m_mapMessagePlans.end(); pIter != pIterEnd; ++pIter)
+	{
+		CC_SAFE_DELETE(pIter->second);
+	}
+
+	this->m_mapMessagePlans.clear();
+
+	// arena和池中的消息引用了DynamicMessageFactory中的类型信息，必须在工厂之前释放，其他线程的Context需要在这之前析构
+
+	this->m_cDefaultContext.Clean();
+
+	CC_SAFE_DELETE(this->m_pImporter);
+	CC_SAFE_DELETE(this->m_pDescriptorPool);
+}
+
+bool ProtocolGenerator::Initialize(const std::string & p_strProtocolFileName)
+{
+	bool bSuccess = false;
+
+	do 
+	{
+		CC_BREAK_IF(p_strProtocolFileName.empty());
+		CC_BREAK_IF(nullptr != this->GetDescriptorPool());
+
+		std::string strFullPath = CCFileUtils::getInstance()->fullPathForFilename(p_strProtocolFileName);
+
+		if (!CCFileUtils::getInstance()->isFileExist(strFullPath))
+		{
+			CCLOGERROR("Protocol File \"%s\" Not Exist!", strFullPath.c_str()); break;
+		}
+
+		google::protobuf::compiler::DiskSourceTree cSourceTree;
+
+		cSourceTree.MapPath("", strFullPath.c_str());
+
+		this->m_pImporter = new (std::nothrow) google::protobuf::compiler::Importer(&cSourceTree, nullptr);
+
+		CC_BREAK_IF(nullptr == this->m_pImporter);
+
+		const google::protobuf::FileDescriptor * pFileDescriptor = this->m_pImporter->Import(p_strProtocolFileName);
+
+		CC_BREAK_IF(nullptr == pFileDescriptor);
+
+		this->_BuildFileMessagePlans(pFileDescriptor);
+
+		bSuccess = true;
+	}
+	while (false);
+	
+	return bSuccess;
+}
+
+bool ProtocolGenerator::InitializeFromDescriptorSet(const std::string & p_strDescriptorSetFileName)
+{
+	if (p_strDescriptorSetFileName.empty())
+	{
+		return false;
+	}
+
+	std::string strFullPath = CCFileUtils::getInstance()->fullPathForFilename(p_strDescriptorSetFileName);
+
+	if (!CCFileUtils::getInstance()->isFileExist(strFullPath))
+	{
+		return CCLOGERROR("Descriptor Set File \"%s\" Not Exist!", strFullPath.c_str()), false;
+	}
+
+	Data cData = CCFileUtils::getInstance()->getDataFromFile(strFullPath);
+
+	if (cData.isNull())
+	{
+		return CCLOGERROR("Descriptor Set File \"%s\" Read Fail!", strFullPath.c_str()), false;
+	}
+
+	return this->InitializeFromDescriptorSet(cData.getBytes(), static_cast<int32_t>(cData.getSize()));
+}
+
+bool ProtocolGenerator::InitializeFromDescriptorSet(const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize)
+{
+	bool bSuccess = false;
+
+	do 
+	{
+		CC_BREAK_IF(nullptr == p_pszDataBuffer || p_nDataSize <= 0);
+		CC_BREAK_IF(nullptr != this->GetDescriptorPool());
+
+		// 由 protoc --include_imports --descriptor_set_out=xxx.pb xxx.proto 生成，跳过对proto文本的解析
+
+		google::protobuf::FileDescriptorSet cDescriptorSet;
+
+		if (!cDescriptorSet.ParseFromArray(p_pszDataBuffer, p_nDataSize))
+		{
+			CCLOGERROR("Descriptor Set Parse Fail! Data Size : %d.", p_nDataSize); break;
+		}
+
+		std::map<std::string, int32_t> mapFileIndexes;
+
+		for (int32_t i = 0; i < cDescriptorSet.file_size(); ++i)
+		{
+			mapFileIndexes[cDescriptorSet.file(i).name()] = i;
+		}
+
+		this->m_pDescriptorPool = new (std::nothrow) google::protobuf::DescriptorPool();
+
+		CC_BREAK_IF(nullptr == this->m_pDescriptorPool);
+
+		bSuccess = true;
+
+		for (int32_t i = 0; i < cDescriptorSet.file_size(); ++i)
+		{
+			bSuccess = false;
+
+			CC_BREAK_IF(!this->_BuildDescriptorFile(cDescriptorSet, mapFileIndexes, i));
+
+			bSuccess = true;
+		}
+
+		if (!bSuccess)
+		{
+			CC_SAFE_DELETE(this->m_pDescriptorPool); break;
+		}
+
+		for (int32_t i = 0; i < cDescriptorSet.file_size(); ++i)
+		{
+			this->_BuildFileMessagePlans(this->m_pDescriptorPool->FindFileByName(cDescriptorSet.file(i).name()));
+		}
+	}
+	while (false);
+
+	return bSuccess;
+}
+
+const google::protobuf::DescriptorPool * ProtocolGenerator::GetDescriptorPool() const
+{
+	if (nullptr != this->m_pImporter)
+	{
+		return this->m_pImporter->pool();
+	}
+
+	return this->m_pDescriptorPool;
+}
+
+bool ProtocolGenerator::_BuildDescriptorFile(const google::protobuf::FileDescriptorSet & p_cDescriptorSet, const std::map<std::string, int32_t> & p_mapFileIndexes, int32_t p_nFileIndex)
+{
+	const google::protobuf::FileDescriptorProto & cFileProto = p_cDescriptorSet.file(p_nFileIndex);
+
+	if (nullptr != this->m_pDescriptorPool->FindFileByName(cFileProto.name()))
+	{
+		return true;
+	}
+
+	// DescriptorPool要求依赖的文件先于当前文件构建，而FileDescriptorSet中的文件顺序不一定满足这个要求
+
+	for (int32_t i = 0; i < cFileProto.dependency_size(); ++i)
+	{
+		auto pIterFind = p_mapFileIndexes.find(cFileProto.dependency(i));
+
+		if (pIterFind == p_mapFileIndexes.end())
+		{
+			return CCLOGERROR("Descriptor File \"%s\"'s Dependency \"%s\" Not Exist! Generate It With --include_imports.", cFileProto.name().c_str(), cFileProto.dependency(i).c_str()), false;
+		}
+
+		if (!this->_BuildDescriptorFile(p_cDescriptorSet, p_mapFileIndexes, pIterFind->second))
+		{
+			return false;
+		}
+	}
+
+	if (nullptr == this->m_pDescriptorPool->BuildFile(cFileProto))
+	{
+		return CCLOGERROR("Descriptor File \"%s\" Build Fail!", cFileProto.name().c_str()), false;
+	}
+
+	return true;
+}
+
+const ProtocolGenerator::MessagePlan * ProtocolGenerator::_GetMessagePlan(const google::protobuf::Descriptor * p_pDescriptor)
+{
+	if (nullptr == p_pDescriptor)
+	{
+		return nullptr;
+	}
+
+	auto pIterFind = this->m_mapMessagePlans.find(p_pDescriptor);
+
+	if (pIterFind != this->m_mapMessagePlans.end())
+	{
+		return pIterFind->second;
+	}
+
+	// 协议文件里的消息在初始化时已经全部生成，这里只会遇到外部传入的消息类型（例如传给ParseMessage的生成代码的消息）
+
+	return this->_BuildMessagePlan(p_pDescriptor);
+}
+
+const ProtocolGenerator::MessagePlan * ProtocolGenerator::_BuildMessagePlan(const google::protobuf::Descriptor * p_pDescriptor)
+{
+	// 生成执行计划会修改共享的m_mapMessagePlans和m_mapLuaNameIndexes，其他线程可能已经在不加锁地查找，冻结之后一律拒绝
+
+	std::lock_guard<std::recursive_mutex> cLock(this->m_cMessagePlanMutex);
+
+	if (this->m_bMessagePlansFrozen.load(std::memory_order_relaxed))
+	{
+		return CCLOGERROR("Message Type \"%s\" Is Not Prepared! Message Plans Are Frozen Once A Context Is Bound.", p_pDescriptor->full_name().c_str()), nullptr;
+	}
+
+	const google::protobuf::Message * pPrototype = this->m_cMessageFactory.GetPrototype(p_pDescriptor);
+
+	if (nullptr == pPrototype)
+	{
+		return CCLOGERROR("Message Type \"%s\"'s Prototype Is NULL!", p_pDescriptor->full_name().c_str()), nullptr;
+	}
+
+	ProtocolGenerator::MessagePlan * pMessagePlan = new (std::nothrow) ProtocolGenerator::MessagePlan();
+
+	if (nullptr == pMessagePlan)
+	{
+		return nullptr;
+	}
+
+	pMessagePlan->pDescriptor = p_pDescriptor;
+	pMessagePlan->pPrototype  = pPrototype;
+
+	// 先放入缓存再生成字段，嵌套自身类型的消息在递归时可以直接取到这个MessagePlan
+
+	this->m_mapMessagePlans[p_pDescriptor] = pMessagePlan;
+
+	int32_t nFieldCount = p_pDescriptor->field_count();
+
+	pMessagePlan->vecFields.resize(nFieldCount > 0 ? nFieldCount : 0);
+
+	pMessagePlan->mapNameIndexes.reserve(pMessagePlan->vecFields.size());
+
+	for (int32_t i = 0; i < nFieldCount; ++i)
+	{
+		this->_BuildFieldPlan(pMessagePlan->vecFields[i], p_pDescriptor->field(i));
+
+		pMessagePlan->vecFields[i].pContainingPlan = pMessagePlan;
+
+		pMessagePlan->vecWireFields.push_back(&(pMessagePlan->vecFields[i]));
+
+		pMessagePlan->mapNameIndexes[p_pDescriptor->field(i)->name()] = i;
+	}
+
+	std::sort(pMessagePlan->vecWireFields.begin(), pMessagePlan->vecWireFields.end(), [](const ProtocolGenerator::FieldPlan * p_pLeft, const ProtocolGenerator::FieldPlan * p_pRight)
+	{
+		return p_pLeft->pField->number() < p_pRight->pField->number();
+	});
+
+	// 字段编号比较紧凑时直接按编号建索引，解码时每个tag只需一次数组访问
+
+	int32_t nMaxNumber = pMessagePlan->vecWireFields.empty() ? 0 : pMessagePlan->vecWireFields.back()->pField->number();
+
+	if (nMaxNumber <= 256 || nMaxNumber <= nFieldCount * 4)
+	{
+		pMessagePlan->vecNumberFields.resize(nMaxNumber + 1, nullptr);
+
+		for (auto pIter = pMessagePlan->vecWireFields.begin(), pIterEnd = pMessagePlan->vecWireFields.end(); pIter != pIterEnd; ++pIter)
+		{
+			pMessagePlan->vecNumberFields[(*pIter)->pField->number()] = *pIter;
+		}
+	}
+
+	return pMessagePlan;
+}
+
+void ProtocolGenerator::_FreezeMessagePlans() const
+{
+	if (this->m_bMessagePlansFrozen.load(std::memory_order_acquire))
+	{
+		return;
+	}
+
+	// 等待正在进行的生成完成，之后其他线程看到的都是完整的MessagePlan
+
+	std::lock_guard<std::recursive_mutex> cLock(this->m_cMessagePlanMutex);
+
+	this->m_bMessagePlansFrozen.store(true, std::memory_order_release);
+}
+
+void ProtocolGenerator::_BuildFieldPlan(ProtocolGenerator::FieldPlan & p_cFieldPlan, const google::protobuf::FieldDescriptor * p_pField)
+{
+	p_cFieldPlan.pField       = p_pField;
+	p_cFieldPlan.bRequired    = p_pField->is_required();
+	p_cFieldPlan.bRepeated    = p_pField->is_repeated();
+	p_cFieldPlan.bHasPresence = p_pField->has_presence();
+	p_cFieldPlan.pOneof       = p_pField->real_containing_oneof();
+	p_cFieldPlan.eType        = p_pField->type();
+
+	if (p_cFieldPlan.eType == google::protobuf::FieldDescriptor::TYPE_ENUM)
+	{
+		p_cFieldPlan.bClosedEnum = p_pField->file()->syntax() != google::protobuf::FileDescriptor::SYNTAX_PROTO3;
+	}
+
+	// 不同消息中同名的字段共用同一个Lua字符串
+
+	auto pIterName = this->m_mapLuaNameIndexes.find(p_pField->name());
+
+	if (pIterName == this->m_mapLuaNameIndexes.end())
+	{
+		pIterName = this->m_mapLuaNameIndexes.insert(std::make_pair(p_pField->name(), static_cast<int32_t>(this->m_mapLuaNameIndexes.size()) + 1)).first;
+	}
+
+	p_cFieldPlan.nLuaNameIndex = pIterName->second;
+
+	google::protobuf::internal::WireFormatLite::WireType eWireType = google::protobuf::internal::WireFormatLite::WireTypeForFieldType(static_cast<google::protobuf::internal::WireFormatLite::FieldType>(p_pField->type()));
+
+	p_cFieldPlan.uTag = google::protobuf::internal::WireFormatLite::MakeTag(p_pField->number(), eWireType);
+
+	if (p_pField->is_packed())
+	{
+		p_cFieldPlan.uPackedTag = google::protobuf::internal::WireFormatLite::MakeTag(p_pField->number(), google::protobuf::internal::WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+	}
+
+	google::protobuf::FieldDescriptor::CppType eType = p_pField->cpp_type();
+
+	if (eType == google::protobuf::FieldDescriptor::CPPTYPE_INT32)
+	{
+		p_cFieldPlan.pFillValueHandler    = &ProtocolGenerator::_FillInt32Value;
+		p_cFieldPlan.pFillRepeatedHandler = &ProtocolGenerator::_FillRepeatedInt32Value;
+		p_cFieldPlan.pFillLuaValueHandler = &ProtocolGenerator::_FillInt32LuaValue;
+		p_cFieldPlan.pParseHandler        = p_cFieldPlan.bRepeated ? &ProtocolGenerator::_ParseRepeatedInt32Value : &ProtocolGenerator::_ParseInt32Value;
+	}
+	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_INT64)
+	{
+		p_cFieldPlan.pFillValueHandler    = &ProtocolGenerator::_FillInt64Value;
+		p_cFieldPlan.pFillRepeatedHandler = &ProtocolGenerator::_FillRepeatedInt64Value;
+		p_cFieldPlan.pFillLuaValueHandler = &ProtocolGenerator::_FillInt64LuaValue;
+		p_cFieldPlan.pParseHandler        = p_cFieldPlan.bRepeated ? &ProtocolGenerator::_ParseRepeatedInt64Value : &ProtocolGenerator::_ParseInt64Value;
+	}
+	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_UINT32)
+	{
+		p_cFieldPlan.pFillValueHandler    = &ProtocolGenerator::_FillUInt32Value;
+		p_cFieldPlan.pFillRepeatedHandler = &ProtocolGenerator::_FillRepeatedUInt32Value;
+		p_cFieldPlan.pFillLuaValueHandler = &ProtocolGenerator::_FillUInt32LuaValue;
+		p_cFieldPlan.pParseHandler        = p_cFieldPlan.bRepeated ? &ProtocolGenerator::_ParseRepeatedUInt32Value : &ProtocolGenerator::_ParseUInt32Value;
+	}
+	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_UINT64)
+	{
+		p_cFieldPlan.pFillValueHandler    = &ProtocolGenerator::_FillUInt64Value;
+		p_cFieldPlan.pFillRepeatedHandler = &ProtocolGenerator::_FillRepeatedUInt64Value;
+		p_cFieldPlan.pFillLuaValueHandler = &ProtocolGenerator::_FillUInt64LuaValue;
+		p_cFieldPlan.pParseHandler        = p_cFieldPlan.bRepeated ? &ProtocolGenerator::_ParseRepeatedUInt64Value : &ProtocolGenerator::_ParseUInt64Value;
+	}
+	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE)
+	{
+		p_cFieldPlan.pFillValueHandler    = &ProtocolGenerator::_FillFloat64Value;
+		p_cFieldPlan.pFillRepeatedHandler = &ProtocolGenerator::_FillRepeatedFloat64Value;
+		p_cFieldPlan.pFillLuaValueHandler = &ProtocolGenerator::_FillFloat64LuaValue;
+		p_cFieldPlan.pParseHandler        = p_cFieldPlan.bRepeated ? &ProtocolGenerator::_ParseRepeatedFloat64Value : &ProtocolGenerator::_ParseFloat64Value;
+	}
+	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_FLOAT)
+	{
+		p_cFieldPlan.pFillValueHandler    = &ProtocolGenerator::_FillFloat32Value;
+		p_cFieldPlan.pFillRepeatedHandler = &ProtocolGenerator::_FillRepeatedFloat32Value;
+		p_cFieldPlan.pFillLuaValueHandler = &ProtocolGenerator::_FillFloat32LuaValue;
+		p_cFieldPlan.pParseHandler        = p_cFieldPlan.bRepeated ? &ProtocolGenerator::_ParseRepeatedFloat32Value : &ProtocolGenerator::_ParseFloat32Value;
+	}
+	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_BOOL)
+	{
+		p_cFieldPlan.pFillValueHandler    = &ProtocolGenerator::_FillBoolValue;
+		p_cFieldPlan.pFillRepeatedHandler = &ProtocolGenerator::_FillRepeatedBoolValue;
+		p_cFieldPlan.pFillLuaValueHandler = &ProtocolGenerator::_FillBoolLuaValue;
+		p_cFieldPlan.pParseHandler        = p_cFieldPlan.bRepeated ? &ProtocolGenerator::_ParseRepeatedBoolValue : &ProtocolGenerator::_ParseBoolValue;
+	}
+	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_ENUM)
+	{
+		p_cFieldPlan.pFillValueHandler    = &ProtocolGenerator::_FillEnumValue;
+		p_cFieldPlan.pFillRepeatedHandler = &ProtocolGenerator::_FillRepeatedEnumValue;
+		p_cFieldPlan.pFillLuaValueHandler = &ProtocolGenerator::_FillEnumLuaValue;
+		p_cFieldPlan.pParseHandler        = p_cFieldPlan.bRepeated ? &ProtocolGenerator::_ParseRepeatedEnumValue : &ProtocolGenerator::_ParseEnumValue;
+	}
+	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_STRING)
+	{
+		p_cFieldPlan.pFillValueHandler    = &ProtocolGenerator::_FillStringValue;
+		p_cFieldPlan.pFillRepeatedHandler = &ProtocolGenerator::_FillRepeatedStringValue;
+		p_cFieldPlan.pFillLuaValueHandler = &ProtocolGenerator::_FillStringLuaValue;
+		p_cFieldPlan.pParseHandler        = p_cFieldPlan.bRepeated ? &ProtocolGenerator::_ParseRepeatedStringValue : &ProtocolGenerator::_ParseStringValue;
+	}
+	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
+	{
+		// message类型的字段直接使用子消息的MessagePlan转换，不需要handler
+
+		p_cFieldPlan.pChildPlan = this->_GetMessagePlan(p_pField->message_type());
+	}
+	else
+	{
+		CCLOGERROR("Field \"%s\"'s Type(%d) Is Unsupported! Message Type : \"%s\".", p_pField->name().c_str(), static_cast<int32_t>(eType), p_pField->containing_type()->full_name().c_str());
+	}
+}
+
+void ProtocolGenerator::_BuildFileMessagePlans(const google::protobuf::FileDescriptor * p_pFileDescriptor)
+{
+	if (nullptr == p_pFileDescriptor)
+	{
+		return;
+	}
+
+	for (int32_t i = 0; i < p_pFileDescriptor->message_type_count(); ++i)
+	{
+		this->_BuildNestedMessagePlans(p_pFileDescriptor->message_type(i));
+	}
+
+	for (int32_t i = 0; i < p_pFileDescriptor->dependency_count(); ++i)
+	{
+		this->_BuildFileMessagePlans(p_pFileDescriptor->dependency(i));
+	}
+}
+
+void ProtocolGenerator::_BuildNestedMessagePlans(const google::protobuf::Descriptor * p_pDescriptor)
+{
+	this->_GetMessagePlan(p_pDescriptor);
+
+	for (int32_t i = 0; i < p_pDescriptor->nested_type_count(); ++i)
+	{
+		this->_BuildNestedMessagePlans(p_pDescriptor->nested_type(i));
+	}
+}
+
+bool ProtocolGenerator::ParseMessage(const char * p_pszMessageName, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, bool p_bSparse)
+{
+	if (nullptr == p_pLuaState)
+	{
+		return false;
+	}
+
+#if defined __PROTOCOL_GENERATOR_PARSE_REFLECTION__
+	google::protobuf::Message * pMessage = this->GenerateMessage(p_pszMessageName, p_pszDataBuffer, p_nDataSize);
+
+	if (nullptr == pMessage)
+	{
+		return false;
+	}
+
+	lua_createtable(p_pLuaState, 0, pMessage->GetDescriptor()->field_count());
+
+	bool bSucces = true;
+
+	if (!this->ParseMessage(pMessage, p_pLuaState, p_bSparse))
+	{
+		bSucces = false;
+	}
+
+	this->RecycleMessage(pMessage);
+
+	return bSucces;
+#else
+	// 直接从wire format解码到Lua table，不再经过DynamicMessage和Reflection
+
+	bool bSuccess = false;
+
+	do
+	{
+		CC_BREAK_IF(!CC_IS_VALID_ANSI_STR(p_pszMessageName));
+		CC_BREAK_IF(p_nDataSize < 0 || (nullptr == p_pszDataBuffer && p_nDataSize > 0));
+		CC_BREAK_IF(nullptr == this->GetDescriptorPool());
+
+		const google::protobuf::Descriptor * pDescriptor = this->GetDescriptorPool()->FindMessageTypeByName(p_pszMessageName);
+
+		CC_BREAK_IF(nullptr == pDescriptor);
+
+		const ProtocolGenerator::MessagePlan * pMessagePlan = this->_GetMessagePlan(pDescriptor);
+
+		CC_BREAK_IF(nullptr == pMessagePlan);
+
+		bSuccess = this->_ParseMessage(pMessagePlan, p_pszDataBuffer, p_nDataSize, p_pLuaState, p_bSparse);
+	}
+	while (false);
+
+	return bSuccess;
+#endif
+}
+
+bool ProtocolGenerator::ParseMessage(uint32_t p_uMessageId, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, bool p_bSparse)
+{
+	const ProtocolGenerator::MessagePlan * pMessagePlan = this->_FindMessagePlan(p_uMessageId);
+
+	if (nullptr == pMessagePlan)
+	{
+		return CCLOGERROR("Message Id %u Is Not Registered!", p_uMessageId), false;
+	}
+
+#if defined __PROTOCOL_GENERATOR_PARSE_REFLECTION__
+	return this->ParseMessage(pMessagePlan->pDescriptor->full_name().c_str(), p_pszDataBuffer, p_nDataSize, p_pLuaState, p_bSparse);
+#else
+	if (nullptr == p_pLuaState || p_nDataSize < 0 || (nullptr == p_pszDataBuffer && p_nDataSize > 0))
+	{
+		return false;
+	}
+
+	return this->_ParseMessage(pMessagePlan, p_pszDataBuffer, p_nDataSize, p_pLuaState, p_bSparse);
+#endif
+}
+
+bool ProtocolGenerator::ParseMessageInto(const char * p_pszMessageName, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bSparse)
+{
+	bool bSuccess = false;
+
+	do
+	{
+		CC_BREAK_IF(nullptr == p_pLuaState || !lua_istable(p_pLuaState, p_nIndex));
+		CC_BREAK_IF(!CC_IS_VALID_ANSI_STR(p_pszMessageName));
+		CC_BREAK_IF(p_nDataSize < 0 || (nullptr == p_pszDataBuffer && p_nDataSize > 0));
+		CC_BREAK_IF(nullptr == this->GetDescriptorPool());
+
+		const google::protobuf::Descriptor * pDescriptor = this->GetDescriptorPool()->FindMessageTypeByName(p_pszMessageName);
+
+		CC_BREAK_IF(nullptr == pDescriptor);
+
+		const ProtocolGenerator::MessagePlan * pMessagePlan = this->_GetMessagePlan(pDescriptor);
+
+		CC_BREAK_IF(nullptr == pMessagePlan);
+
+		bSuccess = this->_ParseMessageInto(pMessagePlan, p_pszDataBuffer, p_nDataSize, p_pLuaState, p_nIndex, p_bSparse);
+	}
+	while (false);
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::ParseMessageInto(uint32_t p_uMessageId, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bSparse)
+{
+	if (nullptr == p_pLuaState || !lua_istable(p_pLuaState, p_nIndex) || p_nDataSize < 0 || (nullptr == p_pszDataBuffer && p_nDataSize > 0))
+	{
+		return false;
+	}
+
+	const ProtocolGenerator::MessagePlan * pMessagePlan = this->_FindMessagePlan(p_uMessageId);
+
+	if (nullptr == pMessagePlan)
+	{
+		return CCLOGERROR("Message Id %u Is Not Registered!", p_uMessageId), false;
+	}
+
+	return this->_ParseMessageInto(pMessagePlan, p_pszDataBuffer, p_nDataSize, p_pLuaState, p_nIndex, p_bSparse);
+}
+
+bool ProtocolGenerator::MergeMessage(const char * p_pszMessageName, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bSparse)
+{
+	bool bSuccess = false;
+
+	do
+	{
+		CC_BREAK_IF(nullptr == p_pLuaState || !lua_istable(p_pLuaState, p_nIndex));
+		CC_BREAK_IF(!CC_IS_VALID_ANSI_STR(p_pszMessageName));
+		CC_BREAK_IF(p_nDataSize < 0 || (nullptr == p_pszDataBuffer && p_nDataSize > 0));
+		CC_BREAK_IF(nullptr == this->GetDescriptorPool());
+
+		const google::protobuf::Descriptor * pDescriptor = this->GetDescriptorPool()->FindMessageTypeByName(p_pszMessageName);
+
+		CC_BREAK_IF(nullptr == pDescriptor);
+
+		const ProtocolGenerator::MessagePlan * pMessagePlan = this->_GetMessagePlan(pDescriptor);
+
+		CC_BREAK_IF(nullptr == pMessagePlan);
+
+		bSuccess = this->_MergeMessage(pMessagePlan, p_pszDataBuffer, p_nDataSize, p_pLuaState, p_nIndex, p_bSparse);
+	}
+	while (false);
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::MergeMessage(uint32_t p_uMessageId, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bSparse)
+{
+	if (nullptr == p_pLuaState || !lua_istable(p_pLuaState, p_nIndex) || p_nDataSize < 0 || (nullptr == p_pszDataBuffer && p_nDataSize > 0))
+	{
+		return false;
+	}
+
+	const ProtocolGenerator::MessagePlan * pMessagePlan = this->_FindMessagePlan(p_uMessageId);
+
+	if (nullptr == pMessagePlan)
+	{
+		return CCLOGERROR("Message Id %u Is Not Registered!", p_uMessageId), false;
+	}
+
+	return this->_MergeMessage(pMessagePlan, p_pszDataBuffer, p_nDataSize, p_pLuaState, p_nIndex, p_bSparse);
+}
+
+bool ProtocolGenerator::ParseMessage(google::protobuf::Message * p_pMessage, lua_State * p_pLuaState, bool p_bSparse)
+{
+	bool bSuccess = false;
+
+	do 
+	{
+		CC_BREAK_IF(nullptr == p_pMessage);
+		CC_BREAK_IF(nullptr == p_pLuaState);
+
+		const ProtocolGenerator::MessagePlan * pMessagePlan = this->_GetMessagePlan(p_pMessage->GetDescriptor());
+
+		CC_BREAK_IF(nullptr == pMessagePlan);
+
+		// 缓存table放在目标table的下面，解析时目标table仍然在栈顶
+
+		int32_t nPrevCacheIndex = this->_BeginLuaNameCache(p_pLuaState, lua_gettop(p_pLuaState));
+
+		ProtocolGenerator::Context * pContext = this->_GetContext();
+
+		bool bPrevSparse = pContext->bSparseDecode;
+
+		pContext->bSparseDecode = p_bSparse;
+
+		bSuccess = this->_ParseMessageDatas(p_pMessage, pMessagePlan, p_pLuaState);
+
+		pContext->bSparseDecode = bPrevSparse;
+
+		this->_EndLuaNameCache(p_pLuaState, nPrevCacheIndex);
+	}
+	while (false);
+
+	return bSuccess;
+}
+
+int32_t ProtocolGenerator::ParseFrames(const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, int32_t p_nHandlerIndex)
+{
+	if (nullptr == p_pLuaState || p_nDataSize < 0 || (nullptr == p_pszDataBuffer && p_nDataSize > 0))
+	{
+		return -1;
+	}
+
+	if (0 != p_nHandlerIndex && !lua_isfunction(p_pLuaState, p_nHandlerIndex))
+	{
+		return CCLOGERROR("Frame Handler Is Not A Function!"), -1;
+	}
+
+	// 整批帧共用一次字段名缓存的准备，每一帧只剩下消息号查表和解码
+
+	int32_t nHandlerIndex = (p_nHandlerIndex < 0 && p_nHandlerIndex > LUA_REGISTRYINDEX) ? lua_gettop(p_pLuaState) + p_nHandlerIndex + 1 : p_nHandlerIndex;
+	int32_t nTop          = lua_gettop(p_pLuaState);
+
+	if (0 == nHandlerIndex)
+	{
+		lua_newtable(p_pLuaState);
+	}
+
+	int32_t nResultIndex = lua_gettop(p_pLuaState);
+	int32_t nPrevCacheIndex = this->_BeginLuaNameCache(p_pLuaState, nResultIndex + 1);
+
+	int32_t nOffset = 0;
+	int32_t nCount  = 0;
+
+	while (nOffset < p_nDataSize)
+	{
+		uint32_t uMessageId = 0;
+		uint32_t uBodySize  = 0;
+
+		int32_t nHeaderSize = this->_ReadFrameHeader(p_pszDataBuffer + nOffset, static_cast<size_t>(p_nDataSize - nOffset), uMessageId, uBodySize);
+
+		if (nHeaderSize < 0)
+		{
+			CCLOGERROR("Frame Header Is Invalid! Offset : %d.", nOffset);
+
+			nOffset = -1; break;
+		}
+
+		if (0 == nHeaderSize || static_cast<uint32_t>(p_nDataSize - nOffset - nHeaderSize) < uBodySize)
+		{
+			break; // 剩下的数据不是一个完整的帧
+		}
+
+		google::protobuf::io::CodedInputStream cInput(p_pszDataBuffer + nOffset + nHeaderSize, static_cast<int32_t>(uBodySize));
+
+		nOffset += nHeaderSize + static_cast<int32_t>(uBodySize);
+
+		this->_DispatchFrame(uMessageId, cInput, static_cast<int32_t>(uBodySize), p_pLuaState, nHandlerIndex, nResultIndex, nCount);
+	}
+
+	this->_EndLuaNameCache(p_pLuaState, nPrevCacheIndex);
+
+	if (nOffset < 0)
+	{
+		lua_settop(p_pLuaState, nTop); // 返回-1时不压入任何值
+	}
+
+	return nOffset;
+}
+
+bool ProtocolGenerator::RegisterMessageId(uint32_t p_uMessageId, const char * p_pszMessageName)
+{
+	if (!CC_IS_VALID_ANSI_STR(p_pszMessageName) || nullptr == this->GetDescriptorPool())
+	{
+		return false;
+	}
+
+	const ProtocolGenerator::MessagePlan * pMessagePlan = this->_GetMessagePlan(this->GetDescriptorPool()->FindMessageTypeByName(p_pszMessageName));
+
+	if (nullptr == pMessagePlan)
+	{
+		return CCLOGERROR("Message Type \"%s\" Not Found!", p_pszMessageName), false;
+	}
+
+	return this->_RegisterMessageId(p_uMessageId, pMessagePlan->pDescriptor);
+}
+
+int32_t ProtocolGenerator::RegisterMessageIds(const char * p_pszOptionName)
+{
+	if (!CC_IS_VALID_ANSI_STR(p_pszOptionName) || nullptr == this->GetDescriptorPool())
+	{
+		return -1;
+	}
+
+	const google::protobuf::FieldDescriptor * pOption = this->GetDescriptorPool()->FindExtensionByName(p_pszOptionName);
+
+	if (nullptr == pOption || pOption->containing_type()->full_name() != "google.protobuf.MessageOptions" || pOption->is_repeated())
+	{
+		return CCLOGERROR("Message Option \"%s\" Not Found!", p_pszOptionName), -1;
+	}
+
+	if (pOption->cpp_type() != google::protobuf::FieldDescriptor::CPPTYPE_INT32 && pOption->cpp_type() != google::protobuf::FieldDescriptor::CPPTYPE_UINT32)
+	{
+		return CCLOGERROR("Message Option \"%s\" Is Not A 32-bit Integer!", p_pszOptionName), -1;
+	}
+
+	// 生成的MessageOptions不认识自定义选项，选项的值保存在unknown fields中
+
+	// m_mapMessagePlans的遍历顺序不固定，先按类型全名排序，消息号重复时的结果才是确定的
+
+	std::vector<const google::protobuf::Descriptor *> vecDescriptors;
+
+	vecDescriptors.reserve(this->m_mapMessagePlans.size());
+
+	for (auto & pIter : this->m_mapMessagePlans)
+	{
+		vecDescriptors.push_back(pIter.first);
+	}
+
+	std::sort(vecDescriptors.begin(), vecDescriptors.end(), [](const google::protobuf::Descriptor * p_pLeft, const google::protobuf::Descriptor * p_pRight) { return p_pLeft->full_name() < p_pRight->full_name(); });
+
+	int32_t nCount = 0;
+
+	for (const google::protobuf::Descriptor * pDescriptor : vecDescriptors)
+	{
+		const google::protobuf::MessageOptions & cOptions = pDescriptor->options();
+		const google::protobuf::UnknownFieldSet & cUnknownFields = cOptions.GetReflection()->GetUnknownFields(cOptions);
+
+		for (int32_t i = cUnknownFields.field_count() - 1; i >= 0; --i)
+		{
+			const google::protobuf::UnknownField & cField = cUnknownFields.field(i);
+
+			if (cField.number() != pOption->number())
+			{
+				continue;
+			}
+
+			uint32_t uMessageId = 0;
+
+			if (cField.type() == google::protobuf::UnknownField::TYPE_VARINT)
+			{
+				uMessageId = pOption->type() == google::protobuf::FieldDescriptor::TYPE_SINT32 ? static_cast<uint32_t>(google::protobuf::internal::WireFormatLite::ZigZagDecode32(static_cast<uint32_t>(cField.varint()))) : static_cast<uint32_t>(cField.varint());
+			}
+			else if (cField.type() == google::protobuf::UnknownField::TYPE_FIXED32)
+			{
+				uMessageId = cField.fixed32();
+			}
+			else
+			{
+				continue;
+			}
+
+			const ProtocolGenerator::MessagePlan * pRegistered = this->_FindMessagePlan(uMessageId);
+
+			if (nullptr != pRegistered && pRegistered->pDescriptor != pDescriptor)
+			{
+				CCLOGERROR("Message Id %u Is Used By \"%s\"! \"%s\" Is Not Registered.", uMessageId, pRegistered->pDescriptor->full_name().c_str(), pDescriptor->full_name().c_str());
+			}
+			else if (this->_RegisterMessageId(uMessageId, pDescriptor))
+			{
+				++nCount;
+			}
+
+			break; // 同一个选项出现多次时以最后一个为准
+		}
+	}
+
+	return nCount;
+}
+
+void ProtocolGenerator::SetFrameFormat(const ProtocolGenerator::FrameFormat & p_cFrameFormat)
+{
+	this->m_cFrameFormat = p_cFrameFormat;
+}
+
+const ProtocolGenerator::FrameFormat & ProtocolGenerator::GetFrameFormat() const
+{
+	return this->m_cFrameFormat;
+}
+
+bool ProtocolGenerator::ParseMessageView(const char * p_pszMessageName, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, bool p_bCache)
+{
+	bool bSuccess = false;
+
+	do
+	{
+		CC_BREAK_IF(nullptr == p_pLuaState);
+		CC_BREAK_IF(!CC_IS_VALID_ANSI_STR(p_pszMessageName));
+		CC_BREAK_IF(p_nDataSize < 0 || (nullptr == p_pszDataBuffer && p_nDataSize > 0));
+		CC_BREAK_IF(nullptr == this->GetDescriptorPool());
+
+		const google::protobuf::Descriptor * pDescriptor = this->GetDescriptorPool()->FindMessageTypeByName(p_pszMessageName);
+
+		CC_BREAK_IF(nullptr == pDescriptor);
+
+		const ProtocolGenerator::MessagePlan * pMessagePlan = this->_GetMessagePlan(pDescriptor);
+
+		CC_BREAK_IF(nullptr == pMessagePlan);
+
+		// 只检查最外层的tag和长度是否完整，嵌套消息在访问时才检查
+
+		google::protobuf::io::CodedInputStream cInput(p_pszDataBuffer, p_nDataSize);
+
+		uint32_t uTag = 0;
+
+		while (0 != (uTag = cInput.ReadTag()) && google::protobuf::internal::WireFormatLite::SkipField(&cInput, uTag))
+		{
+		}
+
+		if (0 != uTag || !cInput.ConsumedEntireMessage())
+		{
+			CCLOGERROR("Message Type \"%s\" Decode Fail!", p_pszMessageName); break;
+		}
+
+		// 收到的缓冲区在回调之后就会被复用，视图持有一份拷贝
+
+		std::shared_ptr<const std::string> pBuffer = std::make_shared<const std::string>(reinterpret_cast<const char *>(p_pszDataBuffer), static_cast<size_t>(p_nDataSize));
+
+		ProtocolGenerator::MessageView cView;
+
+		cView.pGenerator   = this;
+		cView.pMessagePlan = pMessagePlan;
+		cView.pBuffer      = pBuffer;
+		cView.pData        = pBuffer->data();
+		cView.nSize        = p_nDataSize;
+		cView.bCache       = p_bCache;
+
+		this->_PushMessageView(p_pLuaState, cView);
+
+		bSuccess = true;
+	}
+	while (false);
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::DecodeMessage(const char * p_pszMessageName, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, ProtocolGenerator::DecodedMessage & p_cDecodedMessage, bool p_bSparse) const
+{
+	if (!CC_IS_VALID_ANSI_STR(p_pszMessageName) || p_nDataSize < 0 || (nullptr == p_pszDataBuffer && p_nDataSize > 0) || nullptr == this->GetDescriptorPool())
+	{
+		return false;
+	}
+
+	// 所有MessagePlan在初始化时已经创建好，冻结之后这里只查找不创建，多个线程同时调用是安全的
+
+	this->_FreezeMessagePlans();
+
+	auto pIterFind = this->m_mapMessagePlans.find(this->GetDescriptorPool()->FindMessageTypeByName(p_pszMessageName));
+
+	if (pIterFind == this->m_mapMessagePlans.end())
+	{
+		return CCLOGERROR("Message Type \"%s\" Not Found!", p_pszMessageName), false;
+	}
+
+	return this->_DecodeMessage(pIterFind->second, p_pszDataBuffer, p_nDataSize, p_cDecodedMessage, p_bSparse);
+}
+
+bool ProtocolGenerator::DecodeMessage(uint32_t p_uMessageId, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, ProtocolGenerator::DecodedMessage & p_cDecodedMessage, bool p_bSparse) const
+{
+	if (p_nDataSize < 0 || (nullptr == p_pszDataBuffer && p_nDataSize > 0))
+	{
+		return false;
+	}
+
+	this->_FreezeMessagePlans();
+
+	const ProtocolGenerator::MessagePlan * pMessagePlan = this->_FindMessagePlan(p_uMessageId);
+
+	if (nullptr == pMessagePlan)
+	{
+		return CCLOGERROR("Message Id %u Is Not Registered!", p_uMessageId), false;
+	}
+
+	return this->_DecodeMessage(pMessagePlan, p_pszDataBuffer, p_nDataSize, p_cDecodedMessage, p_bSparse);
+}
+
+bool ProtocolGenerator::PushDecodedMessage(const ProtocolGenerator::DecodedMessage & p_cDecodedMessage, lua_State * p_pLuaState)
+{
+	if (nullptr == p_pLuaState || nullptr == p_cDecodedMessage.pMessagePlan)
+	{
+		return false;
+	}
+
+	int32_t nPrevCacheIndex = this->_BeginLuaNameCache(p_pLuaState, lua_gettop(p_pLuaState) + 1);
+
+	bool bSuccess = this->_PushDecodedMessage(p_cDecodedMessage, p_pLuaState);
+
+	this->_EndLuaNameCache(p_pLuaState, nPrevCacheIndex);
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::_PushDecodedMessage(const ProtocolGenerator::DecodedMessage & p_cDecodedMessage, lua_State * p_pLuaState)
+{
+	const ProtocolGenerator::MessagePlan * pMessagePlan = p_cDecodedMessage.pMessagePlan;
+
+	ProtocolGenerator::Context * pContext = this->_GetContext();
+
+	bool bPrevSparse = pContext->bSparseDecode;
+
+	pContext->bSparseDecode = p_cDecodedMessage.bSparse;
+
+	lua_createtable(p_pLuaState, 0, (pContext->bSparseDecode || pMessagePlan->bSparse) ? 0 : static_cast<int32_t>(pMessagePlan->vecFields.size()));
+
+	size_t uIndex = 0;
+
+	bool bSuccess = this->_PushDecodedDatas(p_cDecodedMessage, uIndex, pMessagePlan, p_pLuaState) && uIndex == p_cDecodedMessage.vecValues.size();
+
+	if (!bSuccess)
+	{
+		lua_pop(p_pLuaState, 1);
+
+		CCLOGERROR("Message Type \"%s\" Decode Fail!", pMessagePlan->pDescriptor->full_name().c_str());
+	}
+
+	pContext->bSparseDecode = bPrevSparse;
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::SetSparseDecode(const char * p_pszMessageName, bool p_bSparse)
+{
+	if (!CC_IS_VALID_ANSI_STR(p_pszMessageName) || nullptr == this->GetDescriptorPool())
+	{
+		return false;
+	}
+
+	const google::protobuf::Descriptor * pDescriptor = this->GetDescriptorPool()->FindMessageTypeByName(p_pszMessageName);
+
+	if (nullptr == pDescriptor || nullptr == this->_GetMessagePlan(pDescriptor))
+	{
+		return CCLOGERROR("Message Type \"%s\" Not Found!", p_pszMessageName), false;
+	}
+
+	this->m_mapMessagePlans[pDescriptor]->bSparse = p_bSparse;
+
+	return true;
+}
+
+bool ProtocolGenerator::SetMergeReplace(const char * p_pszMessageName, const char * p_pszFieldName, bool p_bReplace)
+{
+	if (!CC_IS_VALID_ANSI_STR(p_pszMessageName) || !CC_IS_VALID_ANSI_STR(p_pszFieldName) || nullptr == this->GetDescriptorPool())
+	{
+		return false;
+	}
+
+	const google::protobuf::Descriptor * pDescriptor = this->GetDescriptorPool()->FindMessageTypeByName(p_pszMessageName);
+
+	if (nullptr == pDescriptor || nullptr == this->_GetMessagePlan(pDescriptor))
+	{
+		return CCLOGERROR("Message Type \"%s\" Not Found!", p_pszMessageName), false;
+	}
+
+	ProtocolGenerator::MessagePlan * pMessagePlan = this->m_mapMessagePlans[pDescriptor];
+
+	int32_t nFieldIndex = pMessagePlan->FindFieldIndex(p_pszFieldName);
+
+	if (nFieldIndex < 0 || !pMessagePlan->vecFields[nFieldIndex].bRepeated)
+	{
+		return CCLOGERROR("Repeated Field \"%s\" Not Found! Message Type : \"%s\".", p_pszFieldName, p_pszMessageName), false;
+	}
+
+	pMessagePlan->vecFields[nFieldIndex].bMergeReplace = p_bReplace;
+
+	return true;
+}
+
+google::protobuf::Message * ProtocolGenerator::GenerateMessage(const char * p_pszMessageName, lua_State * p_pLuaState, int32_t p_nIndex)
+{
+	google::protobuf::Message * pMessage = nullptr;
+
+	do
+	{
+		CC_BREAK_IF(nullptr == p_pLuaState || p_nIndex < 0);
+		CC_BREAK_IF(!CC_IS_VALID_ANSI_STR(p_pszMessageName));
+
+#if defined __PROTOCOL_GENERATOR_ANALYSIS_TABLE_DATA__
+		std::vector<ProtocolGenerator::ProtocolData> vecTableValues;
+
+		CC_BREAK_IF(!this->_AnalysisTableData(vecTableValues, p_pLuaState, p_nIndex));
+
+		pMessage = this->GenerateMessage(p_pszMessageName, vecTableValues);
+#else
+		// 直接按MessagePlan从table中读取各个字段的值，不再转换成ProtocolData字符串
+
+		CC_BREAK_IF(!lua_istable(p_pLuaState, p_nIndex));
+		CC_BREAK_IF(nullptr == this->GetDescriptorPool());
+
+		const google::protobuf::Descriptor * pDescriptor = this->GetDescriptorPool()->FindMessageTypeByName(p_pszMessageName);
+
+		CC_BREAK_IF(nullptr == pDescriptor);
+
+		const ProtocolGenerator::MessagePlan * pMessagePlan = this->_GetMessagePlan(pDescriptor);
+
+		CC_BREAK_IF(nullptr == pMessagePlan);
+
+		pMessage = this->_GenerateMessage(pMessagePlan, p_pLuaState, p_nIndex);
+#endif
+	}
+	while (false);
+
+	return pMessage;
+}
+
+google::protobuf::Message * ProtocolGenerator::GenerateMessage(uint32_t p_uMessageId, lua_State * p_pLuaState, int32_t p_nIndex)
+{
+	const ProtocolGenerator::MessagePlan * pMessagePlan = this->_FindMessagePlan(p_uMessageId);
+
+	if (nullptr == pMessagePlan)
+	{
+		return CCLOGERROR("Message Id %u Is Not Registered!", p_uMessageId), nullptr;
+	}
+
+#if defined __PROTOCOL_GENERATOR_ANALYSIS_TABLE_DATA__
+	return this->GenerateMessage(pMessagePlan->pDescriptor->full_name().c_str(), p_pLuaState, p_nIndex);
+#else
+	if (nullptr == p_pLuaState || p_nIndex < 0 || !lua_istable(p_pLuaState, p_nIndex))
+	{
+		return nullptr;
+	}
+
+	return this->_GenerateMessage(pMessagePlan, p_pLuaState, p_nIndex);
+#endif
+}
+
+google::protobuf::Message * ProtocolGenerator::GenerateMessage(const char * p_pszMessageName, const std::vector<ProtocolGenerator::ProtocolData> & p_vecValues)
+{
+	google::protobuf::Message * pMessage = nullptr;
+
+	do
+	{
+		CC_BREAK_IF(!CC_IS_VALID_ANSI_STR(p_pszMessageName));
+		CC_BREAK_IF(nullptr == this->GetDescriptorPool());
+
+		const google::protobuf::Descriptor * pDescriptor = this->GetDescriptorPool()->FindMessageTypeByName(p_pszMessageName);
+
+		CC_BREAK_IF(nullptr == pDescriptor);
+
+		const ProtocolGenerator::MessagePlan * pMessagePlan = this->_GetMessagePlan(pDescriptor);
+
+		CC_BREAK_IF(nullptr == pMessagePlan);
+
+		pMessage = this->_NewMessage(pMessagePlan);
+
+		CC_BREAK_IF(nullptr == pMessage);
+		CC_BREAK_IF(this->_FillMessageDatas(pMessage, pMessagePlan, p_vecValues));
+
+		this->RecycleMessage(pMessage);
+
+		pMessage = nullptr;
+	}
+	while (false);
+
+	return pMessage;
+}
+
+google::protobuf::Message * ProtocolGenerator::GenerateMessage(const char * p_pszMessageName, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize)
+{
+	google::protobuf::Message * pMessage = nullptr;
+
+	do
+	{
+		CC_BREAK_IF(!CC_IS_VALID_ANSI_STR(p_pszMessageName));
+		CC_BREAK_IF(nullptr == p_pszDataBuffer || p_nDataSize <= 0);
+		CC_BREAK_IF(nullptr == this->GetDescriptorPool());
+
+		const google::protobuf::Descriptor * pDescriptor = this->GetDescriptorPool()->FindMessageTypeByName(p_pszMessageName);
+
+		CC_BREAK_IF(nullptr == pDescriptor);
+
+		const ProtocolGenerator::MessagePlan * pMessagePlan = this->_GetMessagePlan(pDescriptor);
+
+		CC_BREAK_IF(nullptr == pMessagePlan);
+
+		pMessage = this->_NewMessage(pMessagePlan);
+
+		CC_BREAK_IF(nullptr == pMessage);
+		CC_BREAK_IF(pMessage->ParseFromArray(p_pszDataBuffer, p_nDataSize));
+
+		this->RecycleMessage(pMessage);
+
+		pMessage = nullptr;
+	}
+	while (false);
+
+	return pMessage;
+}
+
+bool ProtocolGenerator::CreateArena(size_t p_uStartBlockSize, size_t p_uMaxBlockSize)
+{
+	google::protobuf::ArenaOptions cOptions;
+
+	if (p_uStartBlockSize > 0)
+	{
+		cOptions.start_block_size = p_uStartBlockSize;
+	}
+
+	if (p_uMaxBlockSize > 0)
+	{
+		cOptions.max_block_size = std::max(p_uMaxBlockSize, cOptions.start_block_size);
+	}
+
+	google::protobuf::Arena * pArena = new (std::nothrow) google::protobuf::Arena(cOptions);
+
+	if (nullptr == pArena)
+	{
+		return CCLOGERROR("Protocol Arena Create Fail!"), false;
+	}
+
+	this->SetArena(pArena);
+
+	this->_GetContext()->pOwnedArena = pArena;
+
+	return true;
+}
+
+void ProtocolGenerator::SetArena(google::protobuf::Arena * p_pArena)
+{
+	ProtocolGenerator::Context * pContext = this->_GetContext();
+
+	if (p_pArena == pContext->pArena)
+	{
+		return;
+	}
+
+	// 换掉之前自己创建的arena，之前从它上面生成的消息随之失效
+
+	if (nullptr != pContext->pOwnedArena && pContext->pOwnedArena != p_pArena)
+	{
+		CC_SAFE_DELETE(pContext->pOwnedArena);
+	}
+
+	pContext->pArena = p_pArena;
+
+	pContext->cArenaStatistics.Clean(); // 消息池和arena互不影响，池的上限和统计保持不变
+}
+
+google::protobuf::Arena * ProtocolGenerator::GetArena() const
+{
+	return this->_GetContext()->pArena;
+}
+
+uint64_t ProtocolGenerator::ResetArena()
+{
+	ProtocolGenerator::Context * pContext = this->_GetContext();
+
+	if (nullptr == pContext->pArena)
+	{
+		return 0;
+	}
+
+	uint64_t uSpaceAllocated = pContext->pArena->Reset();
+
+	pContext->cArenaStatistics.uPeakSpaceAllocated = std::max(pContext->cArenaStatistics.uPeakSpaceAllocated, uSpaceAllocated);
+	pContext->cArenaStatistics.uMessageCount = 0;
+
+	++pContext->cArenaStatistics.uResetCount;
+
+	return uSpaceAllocated;
+}
+
+ProtocolGenerator::ArenaStatistics ProtocolGenerator::GetArenaStatistics() const
+{
+	const ProtocolGenerator::Context * pContext = this->_GetContext();
+
+	ProtocolGenerator::ArenaStatistics cStatistics = pContext->cArenaStatistics;
+
+	if (nullptr != pContext->pArena)
+	{
+		cStatistics.uSpaceAllocated = pContext->pArena->SpaceAllocated();
+		cStatistics.uSpaceUsed      = pContext->pArena->SpaceUsed();
+
+		cStatistics.uPeakSpaceAllocated = std::max(cStatistics.uPeakSpaceAllocated, cStatistics.uSpaceAllocated);
+	}
+
+	return cStatistics;
+}
+
+void ProtocolGenerator::DestroyMessage(google::protobuf::Message * p_pMessage)
+{
+	// arena上的消息由arena统一回收，Reset之前什么都不用做
+
+	if (nullptr == p_pMessage || nullptr != p_pMessage->GetArena())
+	{
+		return;
+	}
+
+	delete p_pMessage;
+}
+
+ProtocolGenerator::MessagePtr ProtocolGenerator::AcquireMessage(const char * p_pszMessageName)
+{
+	google::protobuf::Message * pMessage = nullptr;
+
+	do
+	{
+		CC_BREAK_IF(!CC_IS_VALID_ANSI_STR(p_pszMessageName));
+		CC_BREAK_IF(nullptr == this->GetDescriptorPool());
+
+		const google::protobuf::Descriptor * pDescriptor = this->GetDescriptorPool()->FindMessageTypeByName(p_pszMessageName);
+
+		CC_BREAK_IF(nullptr == pDescriptor);
+
+		const ProtocolGenerator::MessagePlan * pMessagePlan = this->_GetMessagePlan(pDescriptor);
+
+		CC_BREAK_IF(nullptr == pMessagePlan);
+
+		pMessage = this->_NewMessage(pMessagePlan);
+	}
+	while (false);
+
+	return ProtocolGenerator::MessagePtr(pMessage, ProtocolGenerator::MessageRecycler(this));
+}
+
+ProtocolGenerator::MessagePtr ProtocolGenerator::GeneratePooledMessage(const char * p_pszMessageName, lua_State * p_pLuaState, int32_t p_nIndex)
+{
+	return ProtocolGenerator::MessagePtr(this->GenerateMessage(p_pszMessageName, p_pLuaState, p_nIndex), ProtocolGenerator::MessageRecycler(this));
+}
+
+void ProtocolGenerator::RecycleMessage(google::protobuf::Message * p_pMessage)
+{
+	if (nullptr == p_pMessage || nullptr != p_pMessage->GetArena())
+	{
+		return;
+	}
+
+	// 只回收由本实例的DynamicMessageFactory创建的类型，其他消息直接释放
+
+	const google::protobuf::Descriptor * pDescriptor = p_pMessage->GetDescriptor();
+
+	if (this->m_mapMessagePlans.find(pDescriptor) == this->m_mapMessagePlans.end())
+	{
+		delete p_pMessage; return;
+	}
+
+	ProtocolGenerator::Context * pContext = this->_GetContext();
+
+	std::vector<google::protobuf::Message *> & vecMessages = pContext->mapMessagePools[pDescriptor];
+
+	if (vecMessages.size() >= pContext->uMessagePoolLimit)
+	{
+		++pContext->cMessagePoolStatistics.uOverflowCount;
+
+		delete p_pMessage; return;
+	}
+
+	p_pMessage->Clear();
+
+	vecMessages.push_back(p_pMessage);
+
+	++pContext->cMessagePoolStatistics.uPooledCount;
+}
+
+void ProtocolGenerator::SetMessagePoolLimit(uint32_t p_uLimit)
+{
+	ProtocolGenerator::Context * pContext = this->_GetContext();
+
+	pContext->uMessagePoolLimit = p_uLimit;
+
+	// 超出新上限的空闲消息立即释放
+
+	for (auto pIter = pContext->mapMessagePools.begin(), pIterEnd = pContext->mapMessagePools.end(); pIter != pIterEnd; ++pIter)
+	{
+		std::vector<google::protobuf::Message *> & vecMessages = pIter->second;
+
+		while (vecMessages.size() > p_uLimit)
+		{
+			delete vecMessages.back();
+
+			vecMessages.pop_back();
+
+			--pContext->cMessagePoolStatistics.uPooledCount;
+		}
+	}
+}
+
+void ProtocolGenerator::PurgeMessagePool()
+{
+	ProtocolGenerator::Context * pContext = this->_GetContext();
+
+	for (auto pIter = pContext->mapMessagePools.begin(), pIterEnd = pContext->mapMessagePools.end(); pIter != pIterEnd; ++pIter)
+	{
+		for (google::protobuf::Message * pMessage : pIter->second)
+		{
+			delete pMessage;
+		}
+	}
+
+	pContext->mapMessagePools.clear();
+
+	pContext->cMessagePoolStatistics.uPooledCount = 0;
+}
+
+ProtocolGenerator::MessagePoolStatistics ProtocolGenerator::GetMessagePoolStatistics() const
+{
+	return this->_GetContext()->cMessagePoolStatistics;
+}
+
+google::protobuf::Message * ProtocolGenerator::_NewMessage(const ProtocolGenerator::MessagePlan * p_pMessagePlan)
+{
+	ProtocolGenerator::Context * pContext = this->_GetContext();
+
+	if (nullptr == pContext->pArena)
+	{
+		auto pIterFind = pContext->mapMessagePools.find(p_pMessagePlan->pDescriptor);
+
+		if (pIterFind != pContext->mapMessagePools.end() && !pIterFind->second.empty())
+		{
+			google::protobuf::Message * pMessage = pIterFind->second.back();
+
+			pIterFind->second.pop_back();
+
+			--pContext->cMessagePoolStatistics.uPooledCount;
+			++pContext->cMessagePoolStatistics.uHitCount;
+
+			return pMessage;
+		}
+
+		++pContext->cMessagePoolStatistics.uMissCount;
+
+		return p_pMessagePlan->pPrototype->New();
+	}
+
+	++pContext->cArenaStatistics.uMessageCount;
+
+	// 子消息和字符串由Reflection的MutableMessage/AddMessage/SetString自动分配在同一个arena上
+
+	return p_pMessagePlan->pPrototype->New(pContext->pArena);
+}
+
+ProtocolGenerator::Context * ProtocolGenerator::_GetContext()
+{
+	// 链表中通常只有一两个Context，只读线程自己的数据，不需要加锁
+
+	for (ProtocolGenerator::Context * pContext = s_pThreadContexts; nullptr != pContext; pContext = pContext->pNext)
+	{
+		if (this == pContext->pGenerator)
+		{
+			return pContext;
+		}
+	}
+
+	return &this->m_cDefaultContext;
+}
+
+const ProtocolGenerator::Context * ProtocolGenerator::_GetContext() const
+{
+	return const_cast<ProtocolGenerator *>(this)->_GetContext();
+}
+
+bool ProtocolGenerator::EncodeMessage(const char * p_pszMessageName, lua_State * p_pLuaState, int32_t p_nIndex, std::string & p_strBuffer)
+{
+	bool bSuccess = false;
+
+	do
+	{
+		CC_BREAK_IF(nullptr == p_pLuaState || p_nIndex < 0);
+		CC_BREAK_IF(!CC_IS_VALID_ANSI_STR(p_pszMessageName));
+		CC_BREAK_IF(!lua_istable(p_pLuaState, p_nIndex));
+		CC_BREAK_IF(nullptr == this->GetDescriptorPool());
+
+		const google::protobuf::Descriptor * pDescriptor = this->GetDescriptorPool()->FindMessageTypeByName(p_pszMessageName);
+
+		CC_BREAK_IF(nullptr == pDescriptor);
+
+		const ProtocolGenerator::MessagePlan * pMessagePlan = this->_GetMessagePlan(pDescriptor);
+
+		CC_BREAK_IF(nullptr == pMessagePlan);
+
+		bSuccess = this->_EncodeMessage(pMessagePlan, p_pLuaState, p_nIndex, p_strBuffer);
+	}
+	while (false);
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::EncodeMessage(uint32_t p_uMessageId, lua_State * p_pLuaState, int32_t p_nIndex, std::string & p_strBuffer)
+{
+	const ProtocolGenerator::MessagePlan * pMessagePlan = this->_FindMessagePlan(p_uMessageId);
+
+	if (nullptr == pMessagePlan)
+	{
+		return CCLOGERROR("Message Id %u Is Not Registered!", p_uMessageId), false;
+	}
+
+	if (nullptr == p_pLuaState || p_nIndex < 0 || !lua_istable(p_pLuaState, p_nIndex))
+	{
+		return false;
+	}
+
+	return this->_EncodeMessage(pMessagePlan, p_pLuaState, p_nIndex, p_strBuffer);
+}
+
+int32_t ProtocolGenerator::EncodeFrames(lua_State * p_pLuaState, int32_t p_nIndex, std::string & p_strBuffer)
+{
+	if (nullptr == p_pLuaState || p_nIndex <= 0 || !lua_istable(p_pLuaState, p_nIndex) || nullptr == this->GetDescriptorPool())
+	{
+		return -1;
+	}
+
+	// 所有消息共用一个编码上下文和一次字段名缓存的准备，输出缓冲区只在容量不够时增长
+
+	ProtocolGenerator::WireEncodeContext cContext;
+
+	int32_t nPrevCacheIndex = this->_BeginLuaNameCache(p_pLuaState, lua_gettop(p_pLuaState) + 1);
+	int32_t nTop = lua_gettop(p_pLuaState);
+
+	int32_t nEntryCount = static_cast<int32_t>(lua_objlen(p_pLuaState, p_nIndex));
+	int32_t nFrameCount = 0;
+
+	for (int32_t i = 1; i <= nEntryCount; ++i)
+	{
+		lua_settop(p_pLuaState, nTop);
+
+		lua_rawgeti(p_pLuaState, p_nIndex, i);
+
+		if (!lua_istable(p_pLuaState, -1))
+		{
+			CCLOGERROR("Frame Entry %d Is Not A Table!", i); continue;
+		}
+
+		lua_rawgeti(p_pLuaState, -1, 1);
+		lua_rawgeti(p_pLuaState, -2, 2);
+
+		const ProtocolGenerator::MessagePlan * pMessagePlan = nullptr;
+
+		if (lua_type(p_pLuaState, -2) == LUA_TNUMBER)
+		{
+			pMessagePlan = this->_FindMessagePlan(GetLuaUInt32Value(p_pLuaState, -2));
+		}
+		else if (lua_type(p_pLuaState, -2) == LUA_TSTRING)
+		{
+			pMessagePlan = this->_GetMessagePlan(this->GetDescriptorPool()->FindMessageTypeByName(lua_tostring(p_pLuaState, -2)));
+		}
+
+		if (nullptr == pMessagePlan || !pMessagePlan->bMessageId)
+		{
+			CCLOGERROR("Frame Entry %d's Message Type Is Not Registered!", i); continue;
+		}
+
+		if (!lua_istable(p_pLuaState, -1) || !this->_EncodeMessage(cContext, pMessagePlan, p_pLuaState, lua_gettop(p_pLuaState), p_strBuffer, &(pMessagePlan->uMessageId)))
+		{
+			CCLOGERROR("Frame Entry %d Encode Fail! Message Type : \"%s\".", i, pMessagePlan->pDescriptor->full_name().c_str()); continue;
+		}
+
+		++nFrameCount;
+	}
+
+	lua_settop(p_pLuaState, nTop);
+
+	this->_EndLuaNameCache(p_pLuaState, nPrevCacheIndex);
+
+	return nFrameCount;
+}
+
+bool ProtocolGenerator::_RegisterMessageId(uint32_t p_uMessageId, const google::protobuf::Descriptor * p_pDescriptor)
+{
+	if (p_uMessageId > s_uMaxMessageId)
+	{
+		return CCLOGERROR("Message Id %u Is Too Large! Max Message Id : %u.", p_uMessageId, s_uMaxMessageId), false;
+	}
+
+	if (p_uMessageId >= this->m_vecMessageIds.size())
+	{
+		this->m_vecMessageIds.resize(p_uMessageId + 1, nullptr);
+	}
+
+	ProtocolGenerator::MessagePlan * pMessagePlan = this->m_mapMessagePlans[p_pDescriptor];
+
+	// 每个类型只有一个消息号，每个消息号只对应一个类型：先清除这个类型原来的消息号，以及这个消息号原来的类型
+
+	if (pMessagePlan->bMessageId)
+	{
+		this->m_vecMessageIds[pMessagePlan->uMessageId] = nullptr;
+	}
+
+	if (nullptr != this->m_vecMessageIds[p_uMessageId] && this->m_vecMessageIds[p_uMessageId] != pMessagePlan)
+	{
+		ProtocolGenerator::MessagePlan * pRegistered = this->m_mapMessagePlans[this->m_vecMessageIds[p_uMessageId]->pDescriptor];
+
+		pRegistered->bMessageId = false;
+		pRegistered->uMessageId = 0;
+	}
+
+	pMessagePlan->bMessageId = true;
+	pMessagePlan->uMessageId = p_uMessageId;
+
+	this->m_vecMessageIds[p_uMessageId] = pMessagePlan;
+
+	return true;
+}
+
+const ProtocolGenerator::MessagePlan * ProtocolGenerator::_FindMessagePlan(uint32_t p_uMessageId) const
+{
+	return p_uMessageId < this->m_vecMessageIds.size() ? this->m_vecMessageIds[p_uMessageId] : nullptr;
+}
+
+bool ProtocolGenerator::_ParseMessage(const ProtocolGenerator::MessagePlan * p_pMessagePlan, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, bool p_bSparse)
+{
+	int32_t nPrevCacheIndex = this->_BeginLuaNameCache(p_pLuaState, lua_gettop(p_pLuaState) + 1);
+
+	ProtocolGenerator::Context * pContext = this->_GetContext();
+
+	bool bPrevSparse = pContext->bSparseDecode;
+
+	pContext->bSparseDecode = p_bSparse;
+
+	bool bSuccess = this->_DecodeMessage(p_pMessagePlan, p_pszDataBuffer, p_nDataSize, p_pLuaState);
+
+	pContext->bSparseDecode = bPrevSparse;
+
+	this->_EndLuaNameCache(p_pLuaState, nPrevCacheIndex);
+
+	if (!bSuccess)
+	{
+		CCLOGERROR("Message Type \"%s\" Decode Fail!", p_pMessagePlan->pDescriptor->full_name().c_str());
+	}
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::_ParseMessageInto(const ProtocolGenerator::MessagePlan * p_pMessagePlan, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bSparse)
+{
+	int32_t nIndex = (p_nIndex < 0 && p_nIndex > LUA_REGISTRYINDEX) ? lua_gettop(p_pLuaState) + p_nIndex + 1 : p_nIndex;
+	int32_t nTop   = lua_gettop(p_pLuaState);
+
+	int32_t nPrevCacheIndex = this->_BeginLuaNameCache(p_pLuaState, nTop + 1);
+
+	ProtocolGenerator::Context * pContext = this->_GetContext();
+
+	// 空闲table池和字段名缓存保存在一起，池中剩下的table留给下一次调用，不需要每次重新创建
+
+	lua_rawgeti(p_pLuaState, nTop + 1, -1);
+
+	if (!lua_istable(p_pLuaState, -1))
+	{
+		lua_pop(p_pLuaState, 1);
+
+		lua_newtable(p_pLuaState);
+
+		lua_pushvalue(p_pLuaState, -1);
+		lua_rawseti(p_pLuaState, nTop + 1, -1);
+	}
+
+	int32_t nPrevPoolIndex = pContext->nLuaTablePoolIndex;
+	int32_t nPrevPoolSize  = pContext->nLuaTablePoolSize;
+
+	pContext->nLuaTablePoolIndex = lua_gettop(p_pLuaState);
+	pContext->nLuaTablePoolSize  = static_cast<int32_t>(lua_objlen(p_pLuaState, -1));
+
+	bool bPrevSparse = pContext->bSparseDecode;
+
+	pContext->bSparseDecode = p_bSparse;
+
+	// 先把原来的子table回收到池里并清空目标table，解码时需要table的地方优先从池里取
+
+	this->_RecycleLuaTable(p_pMessagePlan, p_pLuaState, nIndex);
+
+	lua_pushvalue(p_pLuaState, nIndex);
+
+	google::protobuf::io::CodedInputStream cInput(p_pszDataBuffer, p_nDataSize);
+
+	cInput.PushLimit(p_nDataSize);
+
+	bool bSuccess = this->_DecodeMessageDatas(cInput, p_pMessagePlan, p_pLuaState, 0);
+
+	pContext->bSparseDecode = bPrevSparse;
+
+	pContext->nLuaTablePoolIndex = nPrevPoolIndex;
+	pContext->nLuaTablePoolSize  = nPrevPoolSize;
+
+	lua_settop(p_pLuaState, nTop + 1);
+
+	this->_EndLuaNameCache(p_pLuaState, nPrevCacheIndex);
+
+	if (!bSuccess)
+	{
+		CCLOGERROR("Message Type \"%s\" Decode Fail!", p_pMessagePlan->pDescriptor->full_name().c_str());
+	}
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::_MergeMessage(const ProtocolGenerator::MessagePlan * p_pMessagePlan, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bSparse)
+{
+	int32_t nIndex = (p_nIndex < 0 && p_nIndex > LUA_REGISTRYINDEX) ? lua_gettop(p_pLuaState) + p_nIndex + 1 : p_nIndex;
+	int32_t nTop   = lua_gettop(p_pLuaState);
+
+	int32_t nPrevCacheIndex = this->_BeginLuaNameCache(p_pLuaState, nTop + 1);
+
+	ProtocolGenerator::Context * pContext = this->_GetContext();
+
+	bool bPrevSparse = pContext->bSparseDecode;
+	bool bPrevMerge  = pContext->bMergeDecode;
+
+	pContext->bSparseDecode = p_bSparse;
+	pContext->bMergeDecode  = true;
+
+	// 解码器本身就是按合并规则写入栈顶的table，直接把目标table作为栈顶即可
+
+	lua_pushvalue(p_pLuaState, nIndex);
+
+	google::protobuf::io::CodedInputStream cInput(p_pszDataBuffer, p_nDataSize);
+
+	cInput.PushLimit(p_nDataSize);
+
+	bool bSuccess = this->_DecodeMessageDatas(cInput, p_pMessagePlan, p_pLuaState, 0);
+
+	pContext->bSparseDecode = bPrevSparse;
+	pContext->bMergeDecode  = bPrevMerge;
+
+	lua_settop(p_pLuaState, nTop + 1);
+
+	this->_EndLuaNameCache(p_pLuaState, nPrevCacheIndex);
+
+	if (!bSuccess)
+	{
+		CCLOGERROR("Message Type \"%s\" Merge Fail!", p_pMessagePlan->pDescriptor->full_name().c_str());
+	}
+
+	return bSuccess;
+}
+
+google::protobuf::Message * ProtocolGenerator::_GenerateMessage(const ProtocolGenerator::MessagePlan * p_pMessagePlan, lua_State * p_pLuaState, int32_t p_nIndex)
+{
+	google::protobuf::Message * pMessage = this->_NewMessage(p_pMessagePlan);
+
+	if (nullptr == pMessage)
+	{
+		return nullptr;
+	}
+
+	int32_t nPrevCacheIndex = this->_BeginLuaNameCache(p_pLuaState, lua_gettop(p_pLuaState) + 1);
+
+	bool bSuccess = this->_FillMessageLuaDatas(pMessage, p_pMessagePlan, p_pLuaState, p_nIndex);
+
+	this->_EndLuaNameCache(p_pLuaState, nPrevCacheIndex);
+
+	if (!bSuccess)
+	{
+		this->RecycleMessage(pMessage);
+
+		pMessage = nullptr;
+	}
+
+	return pMessage;
+}
+
+bool ProtocolGenerator::_EncodeMessage(const ProtocolGenerator::MessagePlan * p_pMessagePlan, lua_State * p_pLuaState, int32_t p_nIndex, std::string & p_strBuffer)
+{
+	ProtocolGenerator::WireEncodeContext cContext;
+
+	int32_t nPrevCacheIndex = this->_BeginLuaNameCache(p_pLuaState, lua_gettop(p_pLuaState) + 1);
+
+	bool bSuccess = this->_EncodeMessage(cContext, p_pMessagePlan, p_pLuaState, p_nIndex, p_strBuffer, nullptr);
+
+	this->_EndLuaNameCache(p_pLuaState, nPrevCacheIndex);
+
+	if (!bSuccess)
+	{
+		CCLOGERROR("Message Type \"%s\" Encode Fail!", p_pMessagePlan->pDescriptor->full_name().c_str());
+	}
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::_EncodeMessage(ProtocolGenerator::WireEncodeContext & p_cContext, const ProtocolGenerator::MessagePlan * p_pMessagePlan, lua_State * p_pLuaState, int32_t p_nIndex, std::string & p_strBuffer, const uint32_t * p_pMessageId)
+{
+	// 第一遍计算总长度和每个嵌套消息的长度，第二遍直接把数据写到p_strBuffer的末尾；p_pMessageId不为空时先写入帧头
+
+	p_cContext.Reset();
+
+	if (!this->_EncodeMessageLuaDatas(p_cContext, p_pMessagePlan, p_pLuaState, p_nIndex))
+	{
+		return false;
+	}
+
+	uint8_t szHeader[16] = {0};
+
+	size_t uHeaderSize = 0;
+
+	if (nullptr != p_pMessageId)
+	{
+		uint8_t szId[8] = {0};
+
+		size_t uIdSize = WriteFrameField(szId, *p_pMessageId, this->m_cFrameFormat.eIdType, this->m_cFrameFormat.bBigEndian);
+
+		uint64_t uLength = uIdSize + p_cContext.uSize;
+
+		if (0 == uIdSize || uLength > this->m_cFrameFormat.uMaxFrameSize)
+		{
+			return false;
+		}
+
+		uHeaderSize = WriteFrameField(szHeader, static_cast<uint32_t>(uLength), this->m_cFrameFormat.eLengthType, this->m_cFrameFormat.bBigEndian);
+
+		if (0 == uHeaderSize)
+		{
+			return false;
+		}
+
+		memcpy(szHeader + uHeaderSize, szId, uIdSize);
+
+		uHeaderSize += uIdSize;
+	}
+
+	size_t uOffset = p_strBuffer.size();
+
+	p_strBuffer.resize(uOffset + uHeaderSize + p_cContext.uSize);
+
+	uint8_t * pBegin = reinterpret_cast<uint8_t *>(&p_strBuffer[0]) + uOffset;
+
+	memcpy(pBegin, szHeader, uHeaderSize);
+
+	pBegin += uHeaderSize;
+
+	p_cContext.bSizing = false;
+	p_cContext.pCursor = pBegin;
+
+	if (!this->_EncodeMessageLuaDatas(p_cContext, p_pMessagePlan, p_pLuaState, p_nIndex) || p_cContext.pCursor != pBegin + p_cContext.uSize)
+	{
+		p_strBuffer.resize(uOffset);
+
+		return false;
+	}
+
+	return true;
+}
+
+bool ProtocolGenerator::_FillMessageDatas(google::protobuf::Message * p_pMessage, const ProtocolGenerator::MessagePlan * p_pMessagePlan, const std::vector<ProtocolGenerator::ProtocolData> & p_vecValues)
+{
+	if (nullptr == p_pMessage || nullptr == p_pMessagePlan)
+	{
+		return false;
+	}
+
+	const google::protobuf::Reflection * pReflection = p_pMessage->GetReflection();
+
+	if (nullptr == pReflection)
+	{
+		return CCLOGERROR("Message Type \"%s\"'s Reflection Is NULL!", p_pMessage->GetTypeName().c_str()), false;
+	}
+
+	if (p_pMessagePlan->vecFields.empty())
+	{
+		return true;
+	}
+
+	// 先遍历一次p_vecValues，按字段名的哈希索引找到对应的字段，不再为每个字段线性查找p_vecValues
+
+	std::vector<const ProtocolGenerator::ProtocolData *> vecFieldDatas(p_pMessagePlan->vecFields.size(), nullptr);
+
+	for (auto pIter = p_vecValues.begin(), pIterEnd = p_vecValues.end(); pIter != pIterEnd; ++pIter)
+	{
+		int32_t nFieldIndex = p_pMessagePlan->FindFieldIndex(pIter->strField);
+
+		if (nFieldIndex >= 0 && nullptr == vecFieldDatas[nFieldIndex]) // 同名的字段以第一个为准
+		{
+			vecFieldDatas[nFieldIndex] = &(*pIter);
+		}
+	}
+
+	bool bSuccess = true;
+
+	for (size_t i = 0; i < p_pMessagePlan->vecFields.size(); ++i)
+	{
+		bSuccess = false;
+
+		CC_BREAK_IF(!this->_FillMessageFileValue(p_pMessage, &(p_pMessagePlan->vecFields[i]), pReflection, vecFieldDatas[i]));
+
+		bSuccess = true;
+	}
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::_FillMessageFileValue(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData)
+{
+	if (nullptr == p_pMessage || nullptr == p_pFieldPlan || nullptr == p_pReflection)
+	{
+		return false;
+	}
+
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
+
+	if (p_pFieldPlan->bRequired)
+	{
+		if (nullptr == p_pProtocolData)
+		{
+			return CCLOGERROR("Field \"%s\"'s Value Is Required! Message Type : \"%s\".", pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
+		}
+	}
+
+	if (nullptr != p_pFieldPlan->pChildPlan)
+	{
+		if (p_pFieldPlan->bRepeated)
+		{
+			return this->_FillRepeatedMessageValue(p_pMessage, pField, p_pReflection, p_pProtocolData, p_pFieldPlan->pChildPlan);
+		}
+		return this->_FillMessageValue(p_pMessage, pField, p_pReflection, p_pProtocolData, p_pFieldPlan->pChildPlan);
+	}
+	else if (p_pFieldPlan->bRepeated && nullptr != p_pFieldPlan->pFillRepeatedHandler)
+	{
+		return (this->*p_pFieldPlan->pFillRepeatedHandler)(p_pMessage, pField, p_pReflection, p_pProtocolData);
+	}
+	else if (!p_pFieldPlan->bRepeated && nullptr != p_pFieldPlan->pFillValueHandler)
+	{
+		return (this->*p_pFieldPlan->pFillValueHandler)(p_pMessage, pField, p_pReflection, p_pProtocolData, false);
+	}
+	else
+	{
+		return CCLOGERROR("Field \"%s\"'s Type(%d) Is Unsupported!", pField->name().c_str(), static_cast<int32_t>(pField->cpp_type())), false;
+	}
+}
+
+bool ProtocolGenerator::_FillInt32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated)
+{
+	if (nullptr != p_pProtocolData && p_pProtocolData->eDataType == ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_VALUE && !p_pProtocolData->strValue.empty())
+	{
+		int32_t nValue = 0;
+
+		sscanf(p_pProtocolData->strValue.c_str(), "%d", &nValue);
+
+		if (p_bRepeated)
+		{
+			p_pReflection->AddInt32(p_pMessage, p_pField, nValue);
+		}
+		else
+		{
+			p_pReflection->SetInt32(p_pMessage, p_pField, nValue);
+		}
+
+		return true;
+	}
+
+	int32_t nDefaultValue = p_pField->default_value_int32();
+
+	if (p_bRepeated)
+	{
+		p_pReflection->AddInt32(p_pMessage, p_pField, nDefaultValue);
+	}
+	else
+	{
+		p_pReflection->SetInt32(p_pMessage, p_pField, nDefaultValue);
+	}
+
+	if (p_pField->is_required())
+	{
+		CCLOGWARN("Field \"%s\"'s Value Is Required, Used Default%s Value \"%d\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", nDefaultValue, p_pMessage->GetTypeName().c_str());
+	}
+#if defined(_DEBUG)
+	else
+	{
+		CCLOGINFO("Field \"%s\"'s Value Is Optional Or Repeated, Used Default%s Value \"%d\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", nDefaultValue, p_pMessage->GetTypeName().c_str());
+	}
+#endif
+
+	return true;
+}
+
+bool ProtocolGenerator::_FillInt64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated)
+{
+	if (nullptr != p_pProtocolData && p_pProtocolData->eDataType == ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_VALUE && !p_pProtocolData->strValue.empty())
+	{
+		int64_t nValue = 0;
+
+		sscanf(p_pProtocolData->strValue.c_str(), "%lld", &nValue);
+
+		if (p_bRepeated)
+		{
+			p_pReflection->AddInt64(p_pMessage, p_pField, nValue);
+		}
+		else
+		{
+			p_pReflection->SetInt64(p_pMessage, p_pField, nValue);
+		}
+
+		return true;
+	}
+
+	int64_t nDefaultValue = p_pField->default_value_int64();
+
+	if (p_bRepeated)
+	{
+		p_pReflection->AddInt64(p_pMessage, p_pField, nDefaultValue);
+	}
+	else
+	{
+		p_pReflection->SetInt64(p_pMessage, p_pField, nDefaultValue);
+	}
+
+	if (p_pField->is_required())
+	{
+		CCLOGWARN("Field \"%s\"'s Value Is Required, Used Default%s Value \"%lld\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", nDefaultValue, p_pMessage->GetTypeName().c_str());
+	}
+#if defined(_DEBUG)
+	else
+	{
+		CCLOGINFO("Field \"%s\"'s Value Is Optional Or Repeated, Used Default%s Value \"%lld\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", nDefaultValue, p_pMessage->GetTypeName().c_str());
+	}
+#endif
+
+	return true;
+}
+
+bool ProtocolGenerator::_FillUInt32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated)
+{
+	if (nullptr != p_pProtocolData && p_pProtocolData->eDataType == ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_VALUE && !p_pProtocolData->strValue.empty())
+	{
+		uint32_t uValue = 0;
+
+		sscanf(p_pProtocolData->strValue.c_str(), "%u", &uValue);
+
+		if (p_bRepeated)
+		{
+			p_pReflection->AddUInt32(p_pMessage, p_pField, uValue);
+		}
+		else
+		{
+			p_pReflection->SetUInt32(p_pMessage, p_pField, uValue);
+		}
+
+		return true;
+	}
+
+	uint32_t uDefaultValue = p_pField->default_value_uint32();
+
+	if (p_bRepeated)
+	{
+		p_pReflection->AddUInt32(p_pMessage, p_pField, uDefaultValue);
+	}
+	else
+	{
+		p_pReflection->SetUInt32(p_pMessage, p_pField, uDefaultValue);
+	}
+
+	if (p_pField->is_required())
+	{
+		CCLOGWARN("Field \"%s\"'s Value Is Required, Used Default%s Value \"%u\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", uDefaultValue, p_pMessage->GetTypeName().c_str());
+	}
+#if defined(_DEBUG)
+	else
+	{
+		CCLOGINFO("Field \"%s\"'s Value Is Optional Or Repeated, Used Default%s Value \"%u\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", uDefaultValue, p_pMessage->GetTypeName().c_str());
+	}
+#endif
+
+	return true;
+}
+
+bool ProtocolGenerator::_FillUInt64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated)
+{
+	if (nullptr != p_pProtocolData && p_pProtocolData->eDataType == ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_VALUE && !p_pProtocolData->strValue.empty())
+	{
+		uint64_t uValue = 0;
+
+		sscanf(p_pProtocolData->strValue.c_str(), "%llu", &uValue);
+
+		if (p_bRepeated)
+		{
+			p_pReflection->AddUInt64(p_pMessage, p_pField, uValue);
+		}
+		else
+		{
+			p_pReflection->SetUInt64(p_pMessage, p_pField, uValue);
+		}
+
+		return true;
+	}
+
+	uint64_t uDefaultValue = p_pField->default_value_uint64();
+
+	if (p_bRepeated)
+	{
+		p_pReflection->AddUInt64(p_pMessage, p_pField, uDefaultValue);
+	}
+	else
+	{
+		p_pReflection->SetUInt64(p_pMessage, p_pField, uDefaultValue);
+	}
+
+	if (p_pField->is_required())
+	{
+		CCLOGWARN("Field \"%s\"'s Value Is Required, Used Default%s Value \"%llu\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", uDefaultValue, p_pMessage->GetTypeName().c_str());
+	}
+#if defined(_DEBUG)
+	else
+	{
+		CCLOGINFO("Field \"%s\"'s Value Is Optional Or Repeated, Used Default%s Value \"%llu\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", uDefaultValue, p_pMessage->GetTypeName().c_str());
+	}
+#endif
+
+	return true;
+}
+
+bool ProtocolGenerator::_FillFloat32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated)
+{
+	if (nullptr != p_pProtocolData && p_pProtocolData->eDataType == ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_VALUE && !p_pProtocolData->strValue.empty())
+	{
+		float32_t fValue = 0.f;
+
+		sscanf(p_pProtocolData->strValue.c_str(), "%f", &fValue);
+
+		if (p_bRepeated)
+		{
+			p_pReflection->AddFloat(p_pMessage, p_pField, fValue);
+		}
+		else
+		{
+			p_pReflection->SetFloat(p_pMessage, p_pField, fValue);
+		}
+
+		return true;
+	}
+
+	float32_t fDefaultValue = p_pField->default_value_float();
+
+	if (p_bRepeated)
+	{
+		p_pReflection->AddFloat(p_pMessage, p_pField, fDefaultValue);
+	}
+	else
+	{
+		p_pReflection->SetFloat(p_pMessage, p_pField, fDefaultValue);
+	}
+
+	if (p_pField->is_required())
+	{
+		CCLOGWARN("Field \"%s\"'s Value Is Required, Used Default%s Value \"%f\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", fDefaultValue, p_pMessage->GetTypeName().c_str());
+	}
+#if defined(_DEBUG)
+	else
+	{
+		CCLOGINFO("Field \"%s\"'s Value Is Optional Or Repeated, Used Default%s Value \"%f\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", fDefaultValue, p_pMessage->GetTypeName().c_str());
+	}
+#endif
+
+	return true;
+}
+
+bool ProtocolGenerator::_FillFloat64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated)
+{
+	if (nullptr != p_pProtocolData && p_pProtocolData->eDataType == ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_VALUE && !p_pProtocolData->strValue.empty())
+	{
+		float64_t fValue = 0;
+
+		sscanf(p_pProtocolData->strValue.c_str(), "%lf", &fValue);
+
+		if (p_bRepeated)
+		{
+			p_pReflection->AddDouble(p_pMessage, p_pField, fValue);
+		}
+		else
+		{
+			p_pReflection->SetDouble(p_pMessage, p_pField, fValue);
+		}
+
+		return true;
+	}
+
+	float64_t fDefaultValue = p_pField->default_value_double();
+
+	if (p_bRepeated)
+	{
+		p_pReflection->AddDouble(p_pMessage, p_pField, fDefaultValue);
+	}
+	else
+	{
+		p_pReflection->SetDouble(p_pMessage, p_pField, fDefaultValue);
+	}
+
+	if (p_pField->is_required())
+	{
+		CCLOGWARN("Field \"%s\"'s Value Is Required, Used Default%s Value \"%lf\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", fDefaultValue, p_pMessage->GetTypeName().c_str());
+	}
+#if defined(_DEBUG)
+	else
+	{
+		CCLOGINFO("Field \"%s\"'s Value Is Optional Or Repeated, Used Default%s Value \"%lf\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", fDefaultValue, p_pMessage->GetTypeName().c_str());
+	}
+#endif
+
+	return true;
+}
+
+bool ProtocolGenerator::_FillBoolValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated)
+{
+	if (nullptr != p_pProtocolData && p_pProtocolData->eDataType == ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_VALUE && !p_pProtocolData->strValue.empty())
+	{
+		if (0 == p_pProtocolData->strValue.compare("true"))
+		{
+			if (p_bRepeated)
+			{
+				p_pReflection->AddBool(p_pMessage, p_pField, true);
+			}
+			else
+			{
+				p_pReflection->SetBool(p_pMessage, p_pField, true);
+			}
+			return true;
+		}
+		else if (0 == p_pProtocolData->strValue.compare("false"))
+		{
+			if (p_bRepeated)
+			{
+				p_pReflection->AddBool(p_pMessage, p_pField, false);
+			}
+			else
+			{
+				p_pReflection->SetBool(p_pMessage, p_pField, false);
+			}
+			return true;
+		}
+		else
+		{
+			return CCLOGERROR("Boolean Field \"%s\"'s Value(%s) Is Invalid! It Must Be \"true\" Or \"false\".", p_pField->name().c_str(), p_pProtocolData->strValue.c_str()), false;
+		}
+	}
+
+	bool bDefaultValue = p_pField->default_value_bool();
+
+	if (p_bRepeated)
+	{
+		p_pReflection->AddBool(p_pMessage, p_pField, bDefaultValue);
+	}
+	else
+	{
+		p_pReflection->SetBool(p_pMessage, p_pField, bDefaultValue);
+	}
+
+	if (p_pField->is_required())
+	{
+		CCLOGWARN("Field \"%s\"'s Value Is Required, Used Default%s Value \"%s\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", bDefaultValue ? "true" : "false", p_pMessage->GetTypeName().c_str());
+	}
+#if defined(_DEBUG)
+	else
+	{
+		CCLOGINFO("Field \"%s\"'s Value Is Optional Or Repeated, Used Default%s Value \"%s\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", bDefaultValue ? "true" : "false", p_pMessage->GetTypeName().c_str());
+	}
+#endif
+
+	return true;
+}
+
+bool ProtocolGenerator::_FillStringValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated)
+{
+	if (nullptr != p_pProtocolData && p_pProtocolData->eDataType == ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_VALUE)
+	{
+		if (p_bRepeated)
+		{
+			p_pReflection->AddString(p_pMessage, p_pField, p_pProtocolData->strValue);
+		}
+		else
+		{
+			p_pReflection->SetString(p_pMessage, p_pField, p_pProtocolData->strValue);
+		}
+		return true;
+	}
+
+	const std::string & strDefaultValue = p_pField->default_value_string();
+
+	if (p_bRepeated)
+	{
+		p_pReflection->AddString(p_pMessage, p_pField, strDefaultValue);
+	}
+	else
+	{
+		p_pReflection->SetString(p_pMessage, p_pField, strDefaultValue);
+	}
+
+	if (p_pField->is_required())
+	{
+		CCLOGWARN("Field \"%s\"'s Value Is Required, Used Default%s Value \"%s\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", strDefaultValue.c_str(), p_pMessage->GetTypeName().c_str());
+	}
+#if defined(_DEBUG)
+	else
+	{
+		CCLOGINFO("Field \"%s\"'s Value Is Optional Or Repeated, Used Default%s Value \"%s\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", strDefaultValue.c_str(), p_pMessage->GetTypeName().c_str());
+	}
+#endif
+
+	return true;
+}
+
+bool ProtocolGenerator::_FillEnumValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated)
+{
+	if (nullptr != p_pProtocolData && p_pProtocolData->eDataType == ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_VALUE && !p_pProtocolData->strValue.empty())
+	{
+		const google::protobuf::EnumDescriptor * pEnumDescriptor = p_pField->enum_type();
+
+		if (nullptr == pEnumDescriptor)
+		{
+			return CCLOGERROR("Field \"%s\"'s Descriptor Is NULL! Message Type : \"%s\".", p_pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
+		}
+
+		int32_t nValue = 0;
+
+		sscanf(p_pProtocolData->strValue.c_str(), "%d", &nValue);
+
+		const google::protobuf::EnumValueDescriptor * pEnumValueDescriptor = pEnumDescriptor->FindValueByNumber(nValue);
+
+		if (nullptr == pEnumValueDescriptor)
+		{
+			return CCLOGERROR("Field \"%s\"'s EnumValueDescriptor(%d) Is NULL! Message Type : \"%s\".", p_pField->name().c_str(), nValue, p_pMessage->GetTypeName().c_str()), false;
+		}
+
+		if (p_bRepeated)
+		{
+			p_pReflection->AddEnum(p_pMessage, p_pField, pEnumValueDescriptor);
+		}
+		else
+		{
+			p_pReflection->SetEnum(p_pMessage, p_pField, pEnumValueDescriptor);
+		}
+
+		return true;
+	}
+
+	const google::protobuf::EnumValueDescriptor * pDefaultEnumValueDescriptor = p_pField->default_value_enum();
+
+	if (nullptr == pDefaultEnumValueDescriptor)
+	{
+		return CCLOGERROR("Field \"%s\"'s Value Is Required! Message Type : \"%s\".", p_pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
+	}
+
+	if (p_bRepeated)
+	{
+		p_pReflection->AddEnum(p_pMessage, p_pField, pDefaultEnumValueDescriptor);
+	}
+	else
+	{
+		p_pReflection->SetEnum(p_pMessage, p_pField, pDefaultEnumValueDescriptor);
+	}
+
+	if (p_pField->is_required())
+	{
+		CCLOGWARN("Field \"%s\"'s Value Is Required, Used Default%s Value \"%s\" (%d). Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", pDefaultEnumValueDescriptor->full_name().c_str(), pDefaultEnumValueDescriptor->number(), p_pMessage->GetTypeName().c_str());
+	}
+#if defined(_DEBUG)
+	else
+	{
+		CCLOGINFO("Field \"%s\"'s Value Is Optional Or Repeated, Used Default%s Value \"%s\" (%d). Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", pDefaultEnumValueDescriptor->full_name().c_str(), pDefaultEnumValueDescriptor->number(), p_pMessage->GetTypeName().c_str());
+	}
+#endif
+
+	return true;
+}
+
+bool ProtocolGenerator::_FillMessageValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, const ProtocolGenerator::MessagePlan * p_pChildPlan)
+{
+	if (nullptr != p_pProtocolData && p_pProtocolData->eDataType == ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_MULTI && !p_pProtocolData->vecValues.empty())
+	{
+		if (nullptr == p_pChildPlan)
+		{
+			return CCLOGERROR("Field \"%s\"'s Descriptor Is NULL! Message Type : \"%s\".", p_pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
+		}
+
+		google::protobuf::Message * pSubMessage = nullptr;
+
+		// 子消息直接由父消息创建并持有，不再通过GenerateMessage按名字查找类型
+
+		if (p_pField->is_repeated())
+		{
+			pSubMessage = p_pReflection->AddMessage(p_pMessage, p_pField, &(this->m_cMessageFactory));
+		}
+		else
+		{
+			pSubMessage = p_pReflection->MutableMessage(p_pMessage, p_pField, &(this->m_cMessageFactory));
+		}
+
+		if (nullptr == pSubMessage)
+		{
+			return false;
+		}
+
+		return this->_FillMessageDatas(pSubMessage, p_pChildPlan, p_pProtocolData->vecValues);
+	}
+
+	// 嵌套的message不会有默认值，因此这里不处理默认值的情况
+
+	if (p_pField->is_required())
+	{
+		return CCLOGERROR("Field \"%s\"'s Value Is Required! Message Type : \"%s\".", p_pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
+	}
+
+	if (p_pField->is_optional())
+	{
+		return true;
+	}
+
+	if (p_pField->is_repeated())
+	{
+		return true;
+	}
+
+	return CCLOGERROR("Field \"%s\" Fill Message Value With Error! Message Type : \"%s\".", p_pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
+}
+
+bool ProtocolGenerator::_FillRepeatedInt32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData)
+{
+	if (nullptr == p_pProtocolData)
+	{
+		return true;
+	}
+
+	if (p_pProtocolData->eDataType != ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_MULTI)
+	{
+		return false;
+	}
+
+	bool bSuccess = false;
+
+	for (auto pIter = p_pProtocolData->vecValues.begin(), pIterEnd = p_pProtocolData->vecValues.end(); pIter != pIterEnd; ++pIter)
+	{
+		bSuccess = false;
+
+		CC_BREAK_IF(!this->_FillInt32Value(p_pMessage, p_pField, p_pReflection, &(*pIter), true));
+
+		bSuccess = true;
+	}
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::_FillRepeatedInt64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData)
+{
+	if (nullptr == p_pProtocolData)
+	{
+		return true;
+	}
+
+	if (p_pProtocolData->eDataType != ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_MULTI)
+	{
+		return false;
+	}
+
+	bool bSuccess = false;
+
+	uint32_t nIndex = 0;
+
+	for (auto pIter = p_pProtocolData->vecValues.begin(), pIterEnd = p_pProtocolData->vecValues.end(); pIter != pIterEnd; ++pIter)
+	{
+		bSuccess = false;
+
+		CC_BREAK_IF(!this->_FillInt64Value(p_pMessage, p_pField, p_pReflection, &(*pIter), true));
+
+		bSuccess = true;
+	}
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::_FillRepeatedUInt32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData)
+{
+	if (nullptr == p_pProtocolData)
+	{
+		return true;
+	}
+
+	if (p_pProtocolData->eDataType != ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_MULTI)
+	{
+		return false;
+	}
+
+	bool bSuccess = false;
+
+	uint32_t nIndex = 0;
+
+	for (auto pIter = p_pProtocolData->vecValues.begin(), pIterEnd = p_pProtocolData->vecValues.end(); pIter != pIterEnd; ++pIter)
+	{
+		bSuccess = false;
+
+		CC_BREAK_IF(!this->_FillUInt32Value(p_pMessage, p_pField, p_pReflection, &(*pIter), true));
+
+		bSuccess = true;
+	}
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::_FillRepeatedUInt64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData)
+{
+	if (nullptr == p_pProtocolData)
+	{
+		return true;
+	}
+
+	if (p_pProtocolData->eDataType != ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_MULTI)
+	{
+		return false;
+	}
+
+	bool bSuccess = false;
+
+	uint32_t nIndex = 0;
+
+	for (auto pIter = p_pProtocolData->vecValues.begin(), pIterEnd = p_pProtocolData->vecValues.end(); pIter != pIterEnd; ++pIter)
+	{
+		bSuccess = false;
+
+		CC_BREAK_IF(!this->_FillUInt64Value(p_pMessage, p_pField, p_pReflection, &(*pIter), true));
+
+		bSuccess = true;
+	}
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::_FillRepeatedFloat32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData)
+{
+	if (nullptr == p_pProtocolData)
+	{
+		return true;
+	}
+
+	if (p_pProtocolData->eDataType != ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_MULTI)
+	{
+		return false;
+	}
+
+	bool bSuccess = false;
+
+	uint32_t nIndex = 0;
+
+	for (auto pIter = p_pProtocolData->vecValues.begin(), pIterEnd = p_pProtocolData->vecValues.end(); pIter != pIterEnd; ++pIter)
+	{
+		bSuccess = false;
+
+		CC_BREAK_IF(!this->_FillFloat32Value(p_pMessage, p_pField, p_pReflection, &(*pIter), true));
+
+		bSuccess = true;
+	}
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::_FillRepeatedFloat64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData)
+{
+	if (nullptr == p_pProtocolData)
+	{
+		return true;
+	}
+
+	if (p_pProtocolData->eDataType != ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_MULTI)
+	{
+		return false;
+	}
+
+	bool bSuccess = false;
+
+	uint32_t nIndex = 0;
+
+	for (auto pIter = p_pProtocolData->vecValues.begin(), pIterEnd = p_pProtocolData->vecValues.end(); pIter != pIterEnd; ++pIter)
+	{
+		bSuccess = false;
+
+		CC_BREAK_IF(!this->_FillFloat64Value(p_pMessage, p_pField, p_pReflection, &(*pIter), true));
+
+		bSuccess = true;
+	}
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::_FillRepeatedBoolValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData)
+{
+	if (nullptr == p_pProtocolData)
+	{
+		return true;
+	}
+
+	if (p_pProtocolData->eDataType != ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_MULTI)
+	{
+		return false;
+	}
+
+	bool bSuccess = false;
+
+	uint32_t nIndex = 0;
+
+	for (auto pIter = p_pProtocolData->vecValues.begin(), pIterEnd = p_pProtocolData->vecValues.end(); pIter != pIterEnd; ++pIter)
+	{
+		bSuccess = false;
+
+		CC_BREAK_IF(!this->_FillBoolValue(p_pMessage, p_pField, p_pReflection, &(*pIter), true));
+
+		bSuccess = true;
+	}
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::_FillRepeatedStringValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData)
+{
+	if (nullptr == p_pProtocolData)
+	{
+		return true;
+	}
+
+	if (p_pProtocolData->eDataType != ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_MULTI)
+	{
+		return false;
+	}
+
+	bool bSuccess = false;
+
+	uint32_t nIndex = 0;
+
+	for (auto pIter = p_pProtocolData->vecValues.begin(), pIterEnd = p_pProtocolData->vecValues.end(); pIter != pIterEnd; ++pIter)
+	{
+		bSuccess = false;
+
+		CC_BREAK_IF(!this->_FillStringValue(p_pMessage, p_pField, p_pReflection, &(*pIter), true));
+
+		bSuccess = true;
+	}
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::_FillRepeatedEnumValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData)
+{
+	if (nullptr == p_pProtocolData)
+	{
+		return true;
+	}
+
+	if (p_pProtocolData->eDataType != ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_MULTI)
+	{
+		return false;
+	}
+
+	bool bSuccess = false;
+
+	uint32_t nIndex = 0;
+
+	for (auto pIter = p_pProtocolData->vecValues.begin(), pIterEnd = p_pProtocolData->vecValues.end(); pIter != pIterEnd; ++pIter)
+	{
+		bSuccess = false;
+
+		CC_BREAK_IF(!this->_FillEnumValue(p_pMessage, p_pField, p_pReflection, &(*pIter), true));
+
+		bSuccess = true;
+	}
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::_FillRepeatedMessageValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, const ProtocolGenerator::MessagePlan * p_pChildPlan)
+{
+	if (nullptr == p_pProtocolData)
+	{
+		return true;
+	}
+
+	if (p_pProtocolData->eDataType != ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_MULTI)
+	{
+		return false;
+	}
+
+	bool bSuccess = false;
+
+	uint32_t nIndex = 0;
+
+	for (auto pIter = p_pProtocolData->vecValues.begin(), pIterEnd = p_pProtocolData->vecValues.end(); pIter != pIterEnd; ++pIter)
+	{
+		bSuccess = false;
+
+		CC_BREAK_IF(!this->_FillMessageValue(p_pMessage, p_pField, p_pReflection, &(*pIter), p_pChildPlan));
+
+		bSuccess = true;
+	}
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::_FillMessageLuaDatas(google::protobuf::Message * p_pMessage, const ProtocolGenerator::MessagePlan * p_pMessagePlan, lua_State * p_pLuaState, int32_t p_nIndex)
+{
+	if (nullptr == p_pMessage || nullptr == p_pMessagePlan)
+	{
+		return false;
+	}
+
+	const google::protobuf::Reflection * pReflection = p_pMessage->GetReflection();
+
+	if (nullptr == pReflection)
+	{
+		return CCLOGERROR("Message Type \"%s\"'s Reflection Is NULL!", p_pMessage->GetTypeName().c_str()), false;
+	}
+
+	bool bSuccess = true;
+
+	for (auto pIter = p_pMessagePlan->vecFields.begin(), pIterEnd = p_pMessagePlan->vecFields.end(); pIter != pIterEnd; ++pIter)
+	{
+		this->_PushLuaFieldName(p_pLuaState, &(*pIter));
+		lua_rawget(p_pLuaState, p_nIndex);
+
+		// stack now contains: -1 => field value (or nil)
+
+		bSuccess = this->_FillMessageLuaFieldValue(p_pMessage, &(*pIter), pReflection, p_pLuaState, lua_gettop(p_pLuaState));
+
+		lua_pop(p_pLuaState, 1);
+
+		CC_BREAK_IF(!bSuccess);
+	}
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::_FillMessageLuaFieldValue(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex)
+{
+	if (lua_isnil(p_pLuaState, p_nIndex))
+	{
+		// oneof中没有赋值的字段不能设置默认值，否则会覆盖掉同一个oneof中已经赋值的字段
+
+		if (nullptr != p_pFieldPlan->pField->real_containing_oneof())
+		{
+			return true;
+		}
+
+		// table中没有这个字段时和ProtocolData的处理一致：required报错，其余使用默认值
+
+		return this->_FillMessageFileValue(p_pMessage, p_pFieldPlan, p_pReflection, nullptr);
+	}
+
+	if (!p_pFieldPlan->bRepeated)
+	{
+		return this->_FillLuaFieldValue(p_pMessage, p_pFieldPlan, p_pReflection, p_pLuaState, p_nIndex, false);
+	}
+
+	if (!lua_istable(p_pLuaState, p_nIndex))
+	{
+		return CCLOGERROR("Repeated Field \"%s\"'s Value Is Not A Table! Message Type : \"%s\".", p_pFieldPlan->pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
+	}
+
+	bool bSuccess = true;
+
+	int32_t nCount = static_cast<int32_t>(lua_objlen(p_pLuaState, p_nIndex));
+
+	for (int32_t i = 1; i <= nCount; ++i)
+	{
+		lua_rawgeti(p_pLuaState, p_nIndex, i);
+
+		bSuccess = this->_FillLuaFieldValue(p_pMessage, p_pFieldPlan, p_pReflection, p_pLuaState, lua_gettop(p_pLuaState), true);
+
+		lua_pop(p_pLuaState, 1);
+
+		CC_BREAK_IF(!bSuccess);
+	}
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::_FillLuaFieldValue(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bRepeated)
+{
+	if (nullptr != p_pFieldPlan->pChildPlan)
+	{
+		return this->_FillMessageLuaValue(p_pMessage, p_pFieldPlan->pField, p_pReflection, p_pLuaState, p_nIndex, p_pFieldPlan->pChildPlan);
+	}
+	else if (nullptr != p_pFieldPlan->pFillLuaValueHandler)
+	{
+		return (this->*p_pFieldPlan->pFillLuaValueHandler)(p_pMessage, p_pFieldPlan->pField, p_pReflection, p_pLuaState, p_nIndex, p_bRepeated);
+	}
+	else
+	{
+		return CCLOGERROR("Field \"%s\"'s Type(%d) Is Unsupported!", p_pFieldPlan->pField->name().c_str(), static_cast<int32_t>(p_pFieldPlan->pField->cpp_type())), false;
+	}
+}
+
+bool ProtocolGenerator::_FillInt32LuaValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bRepeated)
+{
+	if (!lua_isnumber(p_pLuaState, p_nIndex))
+	{
+		return CCLOGERROR("Field \"%s\"'s Value Is Not A Number! Message Type : \"%s\".", p_pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
+	}
+
+	int32_t nValue = static_cast<int32_t>(lua_tointeger(p_pLuaState, p_nIndex));
+
+	if (p_bRepeated)
+	{
+		p_pReflection->AddInt32(p_pMessage, p_pField, nValue);
+	}
+	else
+	{
+		p_pReflection->SetInt32(p_pMessage, p_pField, nValue);
+	}
+
+	return true;
+}
+
+bool ProtocolGenerator::_FillInt64LuaValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bRepeated)
+{
+	if (!lua_isnumber(p_pLuaState, p_nIndex))
+	{
+		return CCLOGERROR("Field \"%s\"'s Value Is Not A Number! Message Type : \"%s\".", p_pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
+	}
+
+	int64_t nValue = GetLuaInt64Value(p_pLuaState, p_nIndex);
+
+	if (p_bRepeated)
+	{
+		p_pReflection->AddInt64(p_pMessage, p_pField, nValue);
+	}
+	else
+	{
+		p_pReflection->SetInt64(p_pMessage, p_pField, nValue);
+	}
+
+	return true;
+}
+
+bool ProtocolGenerator::_FillUInt32LuaValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bRepeated)
+{
+	if (!lua_isnumber(p_pLuaState, p_nIndex))
+	{
+		return CCLOGERROR("Field \"%s\"'s Value Is Not A Number! Message Type : \"%s\".", p_pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
+	}
+
+	uint32_t uValue = GetLuaUInt32Value(p_pLuaState, p_nIndex);
+
+	if (p_bRepeated)
+	{
+		p_pReflection->AddUInt32(p_pMessage, p_pField, uValue);
+	}
+	else
+	{
+		p_pReflection->SetUInt32(p_pMessage, p_pField, uValue);
+	}
+
+	return true;
+}
+
+bool ProtocolGenerator::_FillUInt64LuaValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bRepeated)
+{
+	if (!lua_isnumber(p_pLuaState, p_nIndex))
+	{
+		return CCLOGERROR("Field \"%s\"'s Value Is Not A Number! Message Type : \"%s\".", p_pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
+	}
+
+	uint64_t uValue = GetLuaUInt64Value(p_pLuaState, p_nIndex);
+
+	if (p_bRepeated)
+	{
+		p_pReflection->AddUInt64(p_pMessage, p_pField, uValue);
+	}
+	else
+	{
+		p_pReflection->SetUInt64(p_pMessage, p_pField, uValue);
+	}
+
+	return true;
+}
+
+bool ProtocolGenerator::_FillFloat32LuaValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bRepeated)
+{
+	if (!lua_isnumber(p_pLuaState, p_nIndex))
+	{
+		return CCLOGERROR("Field \"%s\"'s Value Is Not A Number! Message Type : \"%s\".", p_pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
+	}
+
+	float32_t fValue = static_cast<float32_t>(lua_tonumber(p_pLuaState, p_nIndex));
+
+	if (p_bRepeated)
+	{
+		p_pReflection->AddFloat(p_pMessage, p_pField, fValue);
+	}
+	else
+	{
+		p_pReflection->SetFloat(p_pMessage, p_pField, fValue);
+	}
+
+	return true;
+}
+
+bool ProtocolGenerator::_FillFloat64LuaValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bRepeated)
+{
+	if (!lua_isnumber(p_pLuaState, p_nIndex))
+	{
+		return CCLOGERROR("Field \"%s\"'s Value Is Not A Number! Message Type : \"%s\".", p_pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
+	}
+
+	float64_t fValue = lua_tonumber(p_pLuaState, p_nIndex);
+
+	if (p_bRepeated)
+	{
+		p_pReflection->AddDouble(p_pMessage, p_pField, fValue);
+	}
+	else
+	{
+		p_pReflection->SetDouble(p_pMessage, p_pField, fValue);
+	}
+
+	return true;
+}
+
+bool ProtocolGenerator::_FillBoolLuaValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bRepeated)
+{
+	bool bValue = false;
+
+	if (!GetLuaBoolValue(p_pLuaState, p_nIndex, bValue))
+	{
+		return CCLOGERROR("Boolean Field \"%s\"'s Value Is Invalid! It Must Be true Or false. Message Type : \"%s\".", p_pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
+	}
+
+	if (p_bRepeated)
+	{
+		p_pReflection->AddBool(p_pMessage, p_pField, bValue);
+	}
+	else
+	{
+		p_pReflection->SetBool(p_pMessage, p_pField, bValue);
+	}
+
+	return true;
+}
+
+bool ProtocolGenerator::_FillStringLuaValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bRepeated)
+{
+	if (!lua_isstring(p_pLuaState, p_nIndex))
+	{
+		return CCLOGERROR("Field \"%s\"'s Value Is Not A String! Message Type : \"%s\".", p_pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
+	}
+
+	size_t uLength = 0;
+
+	const char * pszValue = lua_tolstring(p_pLuaState, p_nIndex, &uLength);
+
+	if (p_bRepeated)
+	{
+		p_pReflection->AddString(p_pMessage, p_pField, std::string(pszValue, uLength));
+	}
+	else
+	{
+		p_pReflection->SetString(p_pMessage, p_pField, std::string(pszValue, uLength));
+	}
+
+	return true;
+}
+
+bool ProtocolGenerator::_FillEnumLuaValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bRepeated)
+{
+	if (!lua_isnumber(p_pLuaState, p_nIndex))
+	{
+		return CCLOGERROR("Field \"%s\"'s Value Is Not A Number! Message Type : \"%s\".", p_pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
+	}
+
+	int32_t nValue = static_cast<int32_t>(lua_tointeger(p_pLuaState, p_nIndex));
+
+	const google::protobuf::EnumValueDescriptor * pEnumValueDescriptor = p_pField->enum_type()->FindValueByNumber(nValue);
+
+	if (nullptr == pEnumValueDescriptor)
+	{
+		return CCLOGERROR("Field \"%s\"'s EnumValueDescriptor(%d) Is NULL! Message Type : \"%s\".", p_pField->name().c_str(), nValue, p_pMessage->GetTypeName().c_str()), false;
+	}
+
+	if (p_bRepeated)
+	{
+		p_pReflection->AddEnum(p_pMessage, p_pField, pEnumValueDescriptor);
+	}
+	else
+	{
+		p_pReflection->SetEnum(p_pMessage, p_pField, pEnumValueDescriptor);
+	}
+
+	return true;
+}
+
+bool ProtocolGenerator::_FillMessageLuaValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex, const ProtocolGenerator::MessagePlan * p_pChildPlan)
+{
+	if (!lua_istable(p_pLuaState, p_nIndex))
+	{
+		return CCLOGERROR("Field \"%s\"'s Value Is Not A Table! Message Type : \"%s\".", p_pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
+	}
+
+	lua_pushnil(p_pLuaState);
+
+	if (0 == lua_next(p_pLuaState, p_nIndex))
+	{
+		// 空table和没有赋值一样处理，不创建子消息
+
+		return this->_FillMessageValue(p_pMessage, p_pField, p_pReflection, nullptr, p_pChildPlan);
+	}
+
+	lua_pop(p_pLuaState, 2); // pop key + value
+
+	google::protobuf::Message * pSubMessage = nullptr;
+
+	if (p_pField->is_repeated())
+	{
+		pSubMessage = p_pReflection->AddMessage(p_pMessage, p_pField, &(this->m_cMessageFactory));
+	}
+	else
+	{
+		pSubMessage = p_pReflection->MutableMessage(p_pMessage, p_pField, &(this->m_cMessageFactory));
+	}
+
+	if (nullptr == pSubMessage)
+	{
+		return false;
+	}
+
+	return this->_FillMessageLuaDatas(pSubMessage, p_pChildPlan, p_pLuaState, p_nIndex);
+}
+
+bool ProtocolGenerator::_EncodeMessageLuaDatas(ProtocolGenerator::WireEncodeContext & p_cContext, const ProtocolGenerator::MessagePlan * p_pMessagePlan, lua_State * p_pLuaState, int32_t p_nIndex)
+{
+	bool bSuccess = true;
+
+	for (auto pIter = p_pMessagePlan->vecWireFields.begin(), pIterEnd = p_pMessagePlan->vecWireFields.end(); pIter != pIterEnd; ++pIter)
+	{
+		this->_PushLuaFieldName(p_pLuaState, *pIter);
+		lua_rawget(p_pLuaState, p_nIndex);
+
+		bSuccess = this->_EncodeLuaFieldValue(p_cContext, *pIter, p_pLuaState, p_nIndex, lua_gettop(p_pLuaState));
+
+		lua_pop(p_pLuaState, 1);
+
+		CC_BREAK_IF(!bSuccess);
+	}
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::_EncodeLuaFieldValue(ProtocolGenerator::WireEncodeContext & p_cContext, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState, int32_t p_nTableIndex, int32_t p_nIndex)
+{
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
+
+	// 每个分支都和GenerateMessage填充字段的方式保持一致，保证编码结果和SerializeToArray相同
+
+	if (lua_isnil(p_pLuaState, p_nIndex))
+	{
+		if (p_pFieldPlan->bRequired)
+		{
+			return CCLOGERROR("Field \"%s\"'s Value Is Required! Message Type : \"%s\".", pField->name().c_str(), pField->containing_type()->full_name().c_str()), false;
 		}
-		return this->_FillInt64Value(p_pMessage, p_pField, p_pReflection, p_pProtocolData, false);
+
+		if (p_pFieldPlan->bRepeated || nullptr != p_pFieldPlan->pChildPlan || nullptr != pField->real_containing_oneof() || !p_pFieldPlan->bHasPresence)
+		{
+			return true;
+		}
+
+		ProtocolGenerator::WireValue cDefaultValue;
+
+		if (!this->_GetDefaultWireValue(p_pFieldPlan, cDefaultValue))
+		{
+			return false;
+		}
+
+		p_cContext.WriteVarint(p_pFieldPlan->uTag);
+		p_cContext.WriteValue(p_pFieldPlan->uTag & 0x07, cDefaultValue);
+
+		return true;
 	}
-	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_UINT32)
+
+	if (p_pFieldPlan->bRepeated)
 	{
-		if (p_pField->is_repeated())
+		return this->_EncodeLuaRepeatedValue(p_cContext, p_pFieldPlan, p_pLuaState, p_nIndex);
+	}
+
+	if (nullptr != pField->real_containing_oneof() && this->_IsLuaOneofOverridden(p_pFieldPlan, p_pLuaState, p_nTableIndex))
+	{
+		return true;
+	}
+
+	if (nullptr != p_pFieldPlan->pChildPlan)
+	{
+		if (!lua_istable(p_pLuaState, p_nIndex))
+		{
+			return CCLOGERROR("Field \"%s\"'s Value Is Not A Table! Message Type : \"%s\".", pField->name().c_str(), pField->containing_type()->full_name().c_str()), false;
+		}
+
+		if (IsLuaTableEmpty(p_pLuaState, p_nIndex))
 		{
-			return this->_FillRepeatedUInt32Value(p_pMessage, p_pField, p_pReflection, p_pProtocolData);
+			if (p_pFieldPlan->bRequired)
+			{
+				return CCLOGERROR("Field \"%s\"'s Value Is Required! Message Type : \"%s\".", pField->name().c_str(), pField->containing_type()->full_name().c_str()), false;
+			}
+			return true;
 		}
-		return this->_FillUInt32Value(p_pMessage, p_pField, p_pReflection, p_pProtocolData, false);
+
+		return this->_EncodeLuaMessageValue(p_cContext, p_pFieldPlan, p_pLuaState, p_nIndex);
 	}
-	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_UINT64)
+
+	ProtocolGenerator::WireValue cValue;
+
+	if (!this->_GetLuaWireValue(p_pFieldPlan, p_pLuaState, p_nIndex, cValue))
 	{
-		if (p_pField->is_repeated())
+		return false;
+	}
+
+	// 没有presence的字段（proto3）等于默认值时不会被序列化
+
+	if (!p_pFieldPlan->bHasPresence && 0 == cValue.uValue && 0 == cValue.uLength)
+	{
+		return true;
+	}
+
+	p_cContext.WriteVarint(p_pFieldPlan->uTag);
+	p_cContext.WriteValue(p_pFieldPlan->uTag & 0x07, cValue);
+
+	return true;
+}
+
+bool ProtocolGenerator::_EncodeLuaRepeatedValue(ProtocolGenerator::WireEncodeContext & p_cContext, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState, int32_t p_nIndex)
+{
+	if (!lua_istable(p_pLuaState, p_nIndex))
+	{
+		return CCLOGERROR("Repeated Field \"%s\"'s Value Is Not A Table! Message Type : \"%s\".", p_pFieldPlan->pField->name().c_str(), p_pFieldPlan->pField->containing_type()->full_name().c_str()), false;
+	}
+
+	int32_t nCount = static_cast<int32_t>(lua_objlen(p_pLuaState, p_nIndex));
+
+	if (nCount <= 0)
+	{
+		return true;
+	}
+
+	bool bSuccess = true;
+
+	ProtocolGenerator::WireValue cValue;
+
+	if (0 != p_pFieldPlan->uPackedTag)
+	{
+		p_cContext.WriteVarint(p_pFieldPlan->uPackedTag);
+
+		size_t uStartSize = p_cContext.uSize;
+		size_t uLengthIndex = p_cContext.BeginLength();
+
+		for (int32_t i = 1; i <= nCount; ++i)
+		{
+			lua_rawgeti(p_pLuaState, p_nIndex, i);
+
+			bSuccess = this->_GetLuaWireValue(p_pFieldPlan, p_pLuaState, lua_gettop(p_pLuaState), cValue);
+
+			if (bSuccess)
+			{
+				p_cContext.WriteValue(p_pFieldPlan->uTag & 0x07, cValue);
+			}
+
+			lua_pop(p_pLuaState, 1);
+
+			CC_BREAK_IF(!bSuccess);
+		}
+
+		p_cContext.EndLength(uLengthIndex, uStartSize);
+
+		return bSuccess;
+	}
+
+	for (int32_t i = 1; i <= nCount; ++i)
+	{
+		lua_rawgeti(p_pLuaState, p_nIndex, i);
+
+		int32_t nValueIndex = lua_gettop(p_pLuaState);
+
+		if (nullptr != p_pFieldPlan->pChildPlan)
+		{
+			if (!lua_istable(p_pLuaState, nValueIndex))
+			{
+				bSuccess = false;
+
+				CCLOGERROR("Field \"%s\"'s Value Is Not A Table! Message Type : \"%s\".", p_pFieldPlan->pField->name().c_str(), p_pFieldPlan->pField->containing_type()->full_name().c_str());
+			}
+			else if (!IsLuaTableEmpty(p_pLuaState, nValueIndex))
+			{
+				bSuccess = this->_EncodeLuaMessageValue(p_cContext, p_pFieldPlan, p_pLuaState, nValueIndex);
+			}
+		}
+		else
 		{
-			return this->_FillRepeatedUInt64Value(p_pMessage, p_pField, p_pReflection, p_pProtocolData);
+			bSuccess = this->_GetLuaWireValue(p_pFieldPlan, p_pLuaState, nValueIndex, cValue);
+
+			if (bSuccess)
+			{
+				p_cContext.WriteVarint(p_pFieldPlan->uTag);
+				p_cContext.WriteValue(p_pFieldPlan->uTag & 0x07, cValue);
+			}
 		}
-		return this->_FillUInt64Value(p_pMessage, p_pField, p_pReflection, p_pProtocolData, false);
+
+		lua_pop(p_pLuaState, 1);
+
+		CC_BREAK_IF(!bSuccess);
 	}
-	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE)
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::_EncodeLuaMessageValue(ProtocolGenerator::WireEncodeContext & p_cContext, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState, int32_t p_nIndex)
+{
+	if (p_pFieldPlan->pField->type() == google::protobuf::FieldDescriptor::TYPE_GROUP)
 	{
-		if (p_pField->is_repeated())
+		p_cContext.WriteVarint(p_pFieldPlan->uTag);
+
+		bool bSuccess = this->_EncodeMessageLuaDatas(p_cContext, p_pFieldPlan->pChildPlan, p_pLuaState, p_nIndex);
+
+		p_cContext.WriteVarint(google::protobuf::internal::WireFormatLite::MakeTag(p_pFieldPlan->pField->number(), google::protobuf::internal::WireFormatLite::WIRETYPE_END_GROUP));
+
+		return bSuccess;
+	}
+
+	p_cContext.WriteVarint(p_pFieldPlan->uTag);
+
+	size_t uStartSize = p_cContext.uSize;
+	size_t uLengthIndex = p_cContext.BeginLength();
+
+	bool bSuccess = this->_EncodeMessageLuaDatas(p_cContext, p_pFieldPlan->pChildPlan, p_pLuaState, p_nIndex);
+
+	p_cContext.EndLength(uLengthIndex, uStartSize);
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::_GetLuaWireValue(const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState, int32_t p_nIndex, ProtocolGenerator::WireValue & p_cValue)
+{
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
+
+	google::protobuf::FieldDescriptor::Type eType = p_pFieldPlan->eType;
+
+	if (eType == google::protobuf::FieldDescriptor::TYPE_STRING || eType == google::protobuf::FieldDescriptor::TYPE_BYTES)
+	{
+		if (!lua_isstring(p_pLuaState, p_nIndex))
 		{
-			return this->_FillRepeatedFloat64Value(p_pMessage, p_pField, p_pReflection, p_pProtocolData);
+			return CCLOGERROR("Field \"%s\"'s Value Is Not A String! Message Type : \"%s\".", pField->name().c_str(), pField->containing_type()->full_name().c_str()), false;
 		}
-		return this->_FillFloat64Value(p_pMessage, p_pField, p_pReflection, p_pProtocolData, false);
+
+		p_cValue.pszData = lua_tolstring(p_pLuaState, p_nIndex, &p_cValue.uLength);
+
+		return true;
 	}
-	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_FLOAT)
+
+	p_cValue.uLength = 0;
+
+	if (eType == google::protobuf::FieldDescriptor::TYPE_BOOL)
+	{
+		bool bValue = false;
+
+		if (!GetLuaBoolValue(p_pLuaState, p_nIndex, bValue))
+		{
+			return CCLOGERROR("Boolean Field \"%s\"'s Value Is Invalid! It Must Be true Or false. Message Type : \"%s\".", pField->name().c_str(), pField->containing_type()->full_name().c_str()), false;
+		}
+
+		return p_cValue.uValue = bValue ? 1 : 0, true;
+	}
+
+	if (!lua_isnumber(p_pLuaState, p_nIndex))
+	{
+		return CCLOGERROR("Field \"%s\"'s Value Is Not A Number! Message Type : \"%s\".", pField->name().c_str(), pField->containing_type()->full_name().c_str()), false;
+	}
+
+	switch (eType)
+	{
+	case google::protobuf::FieldDescriptor::TYPE_INT32:
+	case google::protobuf::FieldDescriptor::TYPE_SINT32:
+	case google::protobuf::FieldDescriptor::TYPE_SFIXED32:
+		p_cValue.uValue = GetWireInt32Value(eType, static_cast<int32_t>(lua_tointeger(p_pLuaState, p_nIndex)));
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_INT64:
+	case google::protobuf::FieldDescriptor::TYPE_SINT64:
+	case google::protobuf::FieldDescriptor::TYPE_SFIXED64:
+		p_cValue.uValue = GetWireInt64Value(eType, GetLuaInt64Value(p_pLuaState, p_nIndex));
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_UINT32:
+	case google::protobuf::FieldDescriptor::TYPE_FIXED32:
+		p_cValue.uValue = GetLuaUInt32Value(p_pLuaState, p_nIndex);
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_UINT64:
+	case google::protobuf::FieldDescriptor::TYPE_FIXED64:
+		p_cValue.uValue = GetLuaUInt64Value(p_pLuaState, p_nIndex);
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_FLOAT:
+		p_cValue.uValue = google::protobuf::internal::WireFormatLite::EncodeFloat(static_cast<float32_t>(lua_tonumber(p_pLuaState, p_nIndex)));
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_DOUBLE:
+		p_cValue.uValue = google::protobuf::internal::WireFormatLite::EncodeDouble(lua_tonumber(p_pLuaState, p_nIndex));
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_ENUM:
+		{
+			int32_t nValue = static_cast<int32_t>(lua_tointeger(p_pLuaState, p_nIndex));
+
+			if (nullptr == pField->enum_type()->FindValueByNumber(nValue))
+			{
+				return CCLOGERROR("Field \"%s\"'s EnumValueDescriptor(%d) Is NULL! Message Type : \"%s\".", pField->name().c_str(), nValue, pField->containing_type()->full_name().c_str()), false;
+			}
+
+			p_cValue.uValue = GetWireInt32Value(eType, nValue);
+		}
+		break;
+	default:
+		return CCLOGERROR("Field \"%s\"'s Type(%d) Is Unsupported!", pField->name().c_str(), static_cast<int32_t>(eType)), false;
+	}
+
+	return true;
+}
+
+bool ProtocolGenerator::_GetDefaultWireValue(const ProtocolGenerator::FieldPlan * p_pFieldPlan, ProtocolGenerator::WireValue & p_cValue)
+{
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
+
+	google::protobuf::FieldDescriptor::Type eType = p_pFieldPlan->eType;
+
+	switch (pField->cpp_type())
+	{
+	case google::protobuf::FieldDescriptor::CPPTYPE_INT32:
+		p_cValue.uValue = GetWireInt32Value(eType, pField->default_value_int32());
+		break;
+	case google::protobuf::FieldDescriptor::CPPTYPE_INT64:
+		p_cValue.uValue = GetWireInt64Value(eType, pField->default_value_int64());
+		break;
+	case google::protobuf::FieldDescriptor::CPPTYPE_UINT32:
+		p_cValue.uValue = pField->default_value_uint32();
+		break;
+	case google::protobuf::FieldDescriptor::CPPTYPE_UINT64:
+		p_cValue.uValue = pField->default_value_uint64();
+		break;
+	case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT:
+		p_cValue.uValue = google::protobuf::internal::WireFormatLite::EncodeFloat(pField->default_value_float());
+		break;
+	case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE:
+		p_cValue.uValue = google::protobuf::internal::WireFormatLite::EncodeDouble(pField->default_value_double());
+		break;
+	case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
+		p_cValue.uValue = pField->default_value_bool() ? 1 : 0;
+		break;
+	case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
+		p_cValue.uValue = GetWireInt32Value(eType, pField->default_value_enum()->number());
+		break;
+	case google::protobuf::FieldDescriptor::CPPTYPE_STRING:
+		p_cValue.pszData = pField->default_value_string().data();
+		p_cValue.uLength = pField->default_value_string().size();
+		break;
+	default:
+		return CCLOGERROR("Field \"%s\"'s Type(%d) Is Unsupported!", pField->name().c_str(), static_cast<int32_t>(eType)), false;
+	}
+
+	return true;
+}
+
+bool ProtocolGenerator::_IsLuaOneofOverridden(const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState, int32_t p_nTableIndex)
+{
+	// GenerateMessage按声明顺序填充字段，同一个oneof中后声明的字段会覆盖先声明的字段
+
+	const google::protobuf::OneofDescriptor * pOneof = p_pFieldPlan->pField->real_containing_oneof();
+
+	bool bOverridden = false;
+
+	for (int32_t i = p_pFieldPlan->pField->index_in_oneof() + 1; i < pOneof->field_count() && !bOverridden; ++i)
+	{
+		const google::protobuf::FieldDescriptor * pField = pOneof->field(i);
+
+		this->_PushLuaFieldName(p_pLuaState, &(p_pFieldPlan->pContainingPlan->vecFields[pField->index()]));
+		lua_rawget(p_pLuaState, p_nTableIndex);
+
+		bOverridden = !lua_isnil(p_pLuaState, -1);
+
+		if (bOverridden && pField->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
+		{
+			bOverridden = lua_istable(p_pLuaState, -1) && !IsLuaTableEmpty(p_pLuaState, lua_gettop(p_pLuaState));
+		}
+
+		lua_pop(p_pLuaState, 1);
+	}
+
+	return bOverridden;
+}
+
+bool ProtocolGenerator::_DecodeMessage(const ProtocolGenerator::MessagePlan * p_pMessagePlan, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState)
+{
+	// 解码成功时压入一个table，失败时栈保持不变；调用前字段名缓存需要已经准备好
+
+	google::protobuf::io::CodedInputStream cInput(p_pszDataBuffer, p_nDataSize);
+
+	return this->_DecodeMessage(p_pMessagePlan, cInput, p_nDataSize, p_pLuaState);
+}
+
+bool ProtocolGenerator::_DecodeMessage(const ProtocolGenerator::MessagePlan * p_pMessagePlan, google::protobuf::io::CodedInputStream & p_cInput, const int32_t p_nDataSize, lua_State * p_pLuaState)
+{
+	// p_cInput可以来自不连续的内存（例如环形缓冲区），只读取p_nDataSize个字节
+
+	google::protobuf::io::CodedInputStream::Limit nLimit = p_cInput.PushLimit(p_nDataSize);
+
+	lua_createtable(p_pLuaState, 0, (this->_GetContext()->bSparseDecode || p_pMessagePlan->bSparse) ? 0 : static_cast<int32_t>(p_pMessagePlan->vecFields.size()));
+
+	if (!this->_DecodeMessageDatas(p_cInput, p_pMessagePlan, p_pLuaState, 0))
+	{
+		lua_pop(p_pLuaState, 1);
+
+		return false;
+	}
+
+	p_cInput.PopLimit(nLimit);
+
+	return true;
+}
+
+bool ProtocolGenerator::_DispatchFrame(uint32_t p_uMessageId, google::protobuf::io::CodedInputStream & p_cInput, const int32_t p_nBodySize, lua_State * p_pLuaState, int32_t p_nHandlerIndex, int32_t p_nResultIndex, int32_t & p_nCount)
+{
+	// 解码一帧，p_nHandlerIndex为0时追加到p_nResultIndex处的数组，否则调用handler(消息号, table)
+
+	const ProtocolGenerator::MessagePlan * pMessagePlan = this->_FindMessagePlan(p_uMessageId);
+
+	if (nullptr == pMessagePlan)
+	{
+		return CCLOGERROR("Message Id %u Is Not Registered!", p_uMessageId), false;
+	}
+
+	if (!this->_DecodeMessage(pMessagePlan, p_cInput, p_nBodySize, p_pLuaState))
+	{
+		return CCLOGERROR("Message Id %u Decode Fail!", p_uMessageId), false;
+	}
+
+	this->_DeliverFrame(p_uMessageId, p_pLuaState, p_nHandlerIndex, p_nResultIndex, p_nCount);
+
+	return true;
+}
+
+void ProtocolGenerator::_DeliverFrame(uint32_t p_uMessageId, lua_State * p_pLuaState, int32_t p_nHandlerIndex, int32_t p_nResultIndex, int32_t & p_nCount)
+{
+	// 栈顶为解码出的table，p_nHandlerIndex为0时追加到p_nResultIndex处的数组，否则调用handler(消息号, table)，结束时弹出table
+
+	if (0 == p_nHandlerIndex)
 	{
-		if (p_pField->is_repeated())
-		{
-			return this->_FillRepeatedFloat32Value(p_pMessage, p_pField, p_pReflection, p_pProtocolData);
-		}
-		return this->_FillFloat32Value(p_pMessage, p_pField, p_pReflection, p_pProtocolData, false);
+		lua_createtable(p_pLuaState, 2, 0);
+
+		lua_pushnumber(p_pLuaState, p_uMessageId);
+		lua_rawseti(p_pLuaState, -2, 1);
+
+		lua_pushvalue(p_pLuaState, -2);
+		lua_rawseti(p_pLuaState, -2, 2);
+
+		lua_rawseti(p_pLuaState, p_nResultIndex, ++p_nCount);
+		lua_pop(p_pLuaState, 1);
 	}
-	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_BOOL)
+	else
 	{
-		if (p_pField->is_repeated())
+		lua_pushvalue(p_pLuaState, p_nHandlerIndex);
+		lua_pushnumber(p_pLuaState, p_uMessageId);
+		lua_pushvalue(p_pLuaState, -3);
+
+		// handler运行在自己的栈帧中，其中再调用进来的代码（例如消息视图的元方法）不能使用调用者栈上的缓存索引
+
+		ProtocolGenerator::Context * pContext = this->_GetContext();
+
+		int32_t nCacheIndex = pContext->nLuaNameCacheIndex;
+
+		pContext->nLuaNameCacheIndex = 0;
+
+		if (0 != lua_pcall(p_pLuaState, 2, 0, 0))
 		{
-			return this->_FillRepeatedBoolValue(p_pMessage, p_pField, p_pReflection, p_pProtocolData);
+			CCLOGERROR("Message Id %u Handler Error : %s", p_uMessageId, lua_tostring(p_pLuaState, -1));
+
+			lua_pop(p_pLuaState, 1);
 		}
-		return this->_FillBoolValue(p_pMessage, p_pField, p_pReflection, p_pProtocolData, false);
+
+		pContext->nLuaNameCacheIndex = nCacheIndex;
+
+		lua_pop(p_pLuaState, 1);
 	}
-	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_ENUM)
+}
+
+int32_t ProtocolGenerator::_ReadFrameHeader(const unsigned char * p_pszDataBuffer, size_t p_uDataSize, uint32_t & p_uMessageId, uint32_t & p_uBodySize) const
+{
+	// 返回帧头的字节数，数据不够时返回0，帧头错误时返回-1
+
+	uint32_t uLength = 0;
+
+	int32_t nLengthSize = ReadFrameField(p_pszDataBuffer, p_uDataSize, this->m_cFrameFormat.eLengthType, this->m_cFrameFormat.bBigEndian, uLength);
+
+	if (nLengthSize <= 0)
 	{
-		if (p_pField->is_repeated())
-		{
-			return this->_FillRepeatedEnumValue(p_pMessage, p_pField, p_pReflection, p_pProtocolData);
-		}
-		return this->_FillEnumValue(p_pMessage, p_pField, p_pReflection, p_pProtocolData, false);
+		return nLengthSize;
 	}
-	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_STRING)
+
+	if (uLength > this->m_cFrameFormat.uMaxFrameSize)
 	{
-		if (p_pField->is_repeated())
-		{
-			return this->_FillRepeatedStringValue(p_pMessage, p_pField, p_pReflection, p_pProtocolData);
-		}
-		return this->_FillStringValue(p_pMessage, p_pField, p_pReflection, p_pProtocolData, false);
+		return -1;
 	}
-	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
+
+	int32_t nIdSize = ReadFrameField(p_pszDataBuffer + nLengthSize, p_uDataSize - nLengthSize, this->m_cFrameFormat.eIdType, this->m_cFrameFormat.bBigEndian, p_uMessageId);
+
+	if (nIdSize < 0 || (nIdSize > 0 && static_cast<uint32_t>(nIdSize) > uLength))
 	{
-		if (p_pField->is_repeated())
-		{
-			return this->_FillRepeatedMessageValue(p_pMessage, p_pField, p_pReflection, p_pProtocolData);
-		}
-		return this->_FillMessageValue(p_pMessage, p_pField, p_pReflection, p_pProtocolData, false);
+		return -1;
 	}
-	else
+
+	if (0 == nIdSize)
 	{
-		return CCLOGERROR("Field \"%s\"'s Type(%d) Is Unsupported!", p_pField->name().c_str(), static_cast<int32_t>(eType)), false;
+		// 消息号还没收全时，先确认长度本身是合法的
+
+		return p_uDataSize - nLengthSize >= uLength ? -1 : 0;
 	}
+
+	p_uBodySize = uLength - static_cast<uint32_t>(nIdSize);
+
+	return nLengthSize + nIdSize;
 }
 
-bool ProtocolGenerator::_FillInt32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated)
+bool ProtocolGenerator::_DecodeMessageDatas(google::protobuf::io::CodedInputStream & p_cInput, const ProtocolGenerator::MessagePlan * p_pMessagePlan, lua_State * p_pLuaState, uint32_t p_uEndGroupTag)
 {
-	if (nullptr != p_pProtocolData && p_pProtocolData->eDataType == ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_VALUE && !p_pProtocolData->strValue.empty())
+	// 解码到栈顶的table，同一个字段多次出现时和ParseFromArray一样：标量取最后一个值，子消息合并，repeated追加
+
+	std::vector<bool> vecReplaced; // 只在合并解码遇到替换数组的字段时才分配
+
+	for (;;)
 	{
-		int32_t nValue = 0;
+		uint32_t uTag = p_cInput.ReadTag();
 
-		sscanf(p_pProtocolData->strValue.c_str(), "%d", &nValue);
+		if (0 == uTag)
+		{
+			// 正常结束时一定刚好读完当前的limit，group必须以END_GROUP结束
 
-		if (p_bRepeated)
+			if (0 != p_uEndGroupTag || 0 != p_cInput.BytesUntilLimit())
+			{
+				return false;
+			}
+
+			break;
+		}
+
+		uint32_t uWireType = google::protobuf::internal::WireFormatLite::GetTagWireType(uTag);
+
+		if (uWireType == google::protobuf::internal::WireFormatLite::WIRETYPE_END_GROUP)
 		{
-			p_pReflection->AddInt32(p_pMessage, p_pField, nValue);
+			if (uTag != p_uEndGroupTag)
+			{
+				return false;
+			}
+
+			break;
 		}
-		else
+
+		const ProtocolGenerator::FieldPlan * pFieldPlan = p_pMessagePlan->FindFieldPlan(google::protobuf::internal::WireFormatLite::GetTagFieldNumber(uTag));
+
+		if (nullptr == pFieldPlan || !IsWireTypeAccepted(pFieldPlan, uWireType))
 		{
-			p_pReflection->SetInt32(p_pMessage, p_pField, nValue);
+			if (!google::protobuf::internal::WireFormatLite::SkipField(&p_cInput, uTag))
+			{
+				return false;
+			}
+
+			continue;
+		}
+
+		if (pFieldPlan->bMergeReplace && this->_GetContext()->bMergeDecode)
+		{
+			// 非packed的repeated字段每个元素单独出现，只在当前消息中第一次出现时清空原来的数组
+
+			size_t uFieldIndex = static_cast<size_t>(pFieldPlan->pField->index());
+
+			if (vecReplaced.size() <= uFieldIndex || !vecReplaced[uFieldIndex])
+			{
+				vecReplaced.resize(p_pMessagePlan->vecFields.size(), false);
+				vecReplaced[uFieldIndex] = true;
+
+				this->_ClearLuaFieldArray(pFieldPlan, p_pLuaState);
+			}
 		}
 
-		return p_pReflection->SetInt32(p_pMessage, p_pField, nValue), true;
+		if (!this->_DecodeWireFieldValue(p_cInput, pFieldPlan, p_pLuaState, uWireType))
+		{
+			return CCLOGERROR("Field \"%s\" Decode Fail! Message Type : \"%s\".", pFieldPlan->pField->name().c_str(), p_pMessagePlan->pDescriptor->full_name().c_str()), false;
+		}
 	}
 
-	int32_t nDefaultValue = p_pField->default_value_int32();
+	return this->_DecodeDefaultDatas(p_pMessagePlan, p_pLuaState, true);
+}
 
-	if (p_bRepeated)
+bool ProtocolGenerator::_DecodeWireFieldValue(google::protobuf::io::CodedInputStream & p_cInput, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState, uint32_t p_uWireType)
+{
+	if (p_pFieldPlan->bRepeated)
 	{
-		p_pReflection->AddInt32(p_pMessage, p_pField, nDefaultValue);
+		return this->_DecodeWireRepeatedValue(p_cInput, p_pFieldPlan, p_pLuaState, p_uWireType);
 	}
-	else
+
+	this->_ClearLuaOneofFields(p_pFieldPlan, p_pLuaState);
+
+	if (nullptr != p_pFieldPlan->pChildPlan)
 	{
-		p_pReflection->SetInt32(p_pMessage, p_pField, nDefaultValue);
+		return this->_DecodeWireMessageValue(p_cInput, p_pFieldPlan, p_pLuaState);
 	}
 
-	if (p_pField->is_required())
+	this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
+
+	if (!this->_DecodeWireValue(p_cInput, p_pFieldPlan, p_pLuaState))
 	{
-		CCLOGWARN("Field \"%s\"'s Value Is Required, Used Default%s Value \"%d\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", nDefaultValue, p_pMessage->GetTypeName().c_str());
+		lua_pop(p_pLuaState, 1);
+
+		return false;
 	}
-#if defined(_DEBUG)
-	else
+
+	if (lua_isnil(p_pLuaState, -1))
 	{
-		CCLOGINFO("Field \"%s\"'s Value Is Optional Or Repeated, Used Default%s Value \"%d\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", nDefaultValue, p_pMessage->GetTypeName().c_str());
+		lua_pop(p_pLuaState, 2); // 未定义的枚举值，和ParseFromArray一样丢弃
+
+		return true;
 	}
-#endif
+
+	lua_rawset(p_pLuaState, -3);
 
 	return true;
 }
 
-bool ProtocolGenerator::_FillInt64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated)
+bool ProtocolGenerator::_DecodeWireRepeatedValue(google::protobuf::io::CodedInputStream & p_cInput, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState, uint32_t p_uWireType)
 {
-	if (nullptr != p_pProtocolData && p_pProtocolData->eDataType == ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_VALUE && !p_pProtocolData->strValue.empty())
+	bool bPacked = nullptr == p_pFieldPlan->pChildPlan && p_uWireType == google::protobuf::internal::WireFormatLite::WIRETYPE_LENGTH_DELIMITED && p_pFieldPlan->eType != google::protobuf::FieldDescriptor::TYPE_STRING && p_pFieldPlan->eType != google::protobuf::FieldDescriptor::TYPE_BYTES;
+
+	uint32_t uLength   = 0;
+	int32_t  nSizeHint = 0;
+
+	if (bPacked)
 	{
-		int64_t nValue = 0;
+		// packed编码，整段数据都是同一个字段的值，先算出元素个数，数组一次分配到位
 
-		sscanf(p_pProtocolData->strValue.c_str(), "%lld", &nValue);
+		// PushLimit不会超出外层的limit，长度超出剩余数据时要在这里报错，否则会把截断的数组当成完整的
 
-		if (p_bRepeated)
-		{
-			p_pReflection->AddInt64(p_pMessage, p_pField, nValue);
-		}
-		else
+		if (!p_cInput.ReadVarint32(&uLength) || (p_cInput.BytesUntilLimit() >= 0 && static_cast<uint32_t>(p_cInput.BytesUntilLimit()) < uLength))
 		{
-			p_pReflection->SetInt64(p_pMessage, p_pField, nValue);
+			return false;
 		}
 
-		return true;
+		nSizeHint = GetWirePackedCount(p_cInput, p_pFieldPlan->eType, uLength);
 	}
 
-	int64_t nDefaultValue = p_pField->default_value_int64();
+	this->_PushLuaFieldTable(p_pFieldPlan, p_pLuaState, nSizeHint, 0);
 
-	if (p_bRepeated)
-	{
-		p_pReflection->AddInt64(p_pMessage, p_pField, nDefaultValue);
-	}
-	else
-	{
-		p_pReflection->SetInt64(p_pMessage, p_pField, nDefaultValue);
-	}
+	int32_t nTop   = lua_gettop(p_pLuaState);
+	int32_t nCount = static_cast<int32_t>(lua_objlen(p_pLuaState, -1));
 
-	if (p_pField->is_required())
+	bool bSuccess = false;
+
+	do
 	{
-		CCLOGWARN("Field \"%s\"'s Value Is Required, Used Default%s Value \"%lld\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", nDefaultValue, p_pMessage->GetTypeName().c_str());
+		if (nullptr != p_pFieldPlan->pChildPlan)
+		{
+			this->_NewLuaTable(p_pLuaState, 0, static_cast<int32_t>(p_pFieldPlan->pChildPlan->vecFields.size()));
+
+			CC_BREAK_IF(!this->_DecodeWireMessageValue(p_cInput, p_pFieldPlan, p_pLuaState));
+
+			lua_rawseti(p_pLuaState, -2, ++nCount);
+		}
+		else if (bPacked)
+		{
+			// 整段数据在连续的内存中时（输入是一整块缓冲区时总是如此）直接批量解码，不再逐个元素经过CodedInputStream和_DecodeWireValue
+
+			const void * pData = nullptr;
+
+			int32_t nSize = 0;
+
+			if (p_cInput.GetDirectBufferPointer(&pData, &nSize) && static_cast<uint32_t>(nSize) >= uLength)
+			{
+				const uint8_t * pBytes = static_cast<const uint8_t *>(pData);
+
+				CC_BREAK_IF(!DecodeWirePackedValues(p_pFieldPlan, pBytes, pBytes + uLength, p_pLuaState, nCount));
+				CC_BREAK_IF(!p_cInput.Skip(static_cast<int32_t>(uLength)));
+			}
+			else
+			{
+				// 跨越环形缓冲区末尾的数据逐个元素读取
+
+				google::protobuf::io::CodedInputStream::Limit nLimit = p_cInput.PushLimit(static_cast<int32_t>(uLength));
+
+				bool bValid = true;
+
+				while (p_cInput.BytesUntilLimit() > 0)
+				{
+					bValid = this->_DecodeWireValue(p_cInput, p_pFieldPlan, p_pLuaState);
+
+					if (!bValid)
+					{
+						break;
+					}
+
+					if (lua_isnil(p_pLuaState, -1))
+					{
+						lua_pop(p_pLuaState, 1);
+					}
+					else
+					{
+						lua_rawseti(p_pLuaState, -2, ++nCount);
+					}
+				}
+
+				p_cInput.PopLimit(nLimit);
+
+				CC_BREAK_IF(!bValid);
+			}
+		}
+		else
+		{
+			CC_BREAK_IF(!this->_DecodeWireValue(p_cInput, p_pFieldPlan, p_pLuaState));
+
+			if (lua_isnil(p_pLuaState, -1))
+			{
+				lua_pop(p_pLuaState, 1);
+			}
+			else
+			{
+				lua_rawseti(p_pLuaState, -2, nCount + 1);
+			}
+		}
+
+		bSuccess = true;
 	}
-#if defined(_DEBUG)
-	else
+	while (false);
+
+	if (bSuccess && 0 == lua_objlen(p_pLuaState, nTop))
 	{
-		CCLOGINFO("Field \"%s\"'s Value Is Optional Or Repeated, Used Default%s Value \"%lld\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", nDefaultValue, p_pMessage->GetTypeName().c_str());
+		// 元素全部被丢弃时（closed enum的未知值）和反射解码一样不设置该字段，不留下空的table
+
+		this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
+		lua_pushnil(p_pLuaState);
+
+		lua_rawset(p_pLuaState, nTop - 1);
 	}
-#endif
 
-	return true;
+	// 失败时栈上可能还留着解码了一半的值，直接恢复到只有外层table的状态
+
+	lua_settop(p_pLuaState, nTop - 1);
+
+	return bSuccess;
 }
 
-bool ProtocolGenerator::_FillUInt32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated)
+bool ProtocolGenerator::_DecodeWireMessageValue(google::protobuf::io::CodedInputStream & p_cInput, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
 {
-	if (nullptr != p_pProtocolData && p_pProtocolData->eDataType == ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_VALUE && !p_pProtocolData->strValue.empty())
+	// 非repeated字段解码到已有的子table中（同一个子消息多次出现时合并），repeated字段解码到栈顶新建的table
+
+	bool bRepeated = p_pFieldPlan->bRepeated;
+
+	if (!bRepeated)
 	{
-		uint32_t uValue = 0;
+		this->_PushLuaFieldTable(p_pFieldPlan, p_pLuaState, 0, static_cast<int32_t>(p_pFieldPlan->pChildPlan->vecFields.size()));
+	}
 
-		sscanf(p_pProtocolData->strValue.c_str(), "%u", &uValue);
+	bool bSuccess = false;
 
-		if (p_bRepeated)
+	do
+	{
+		CC_BREAK_IF(!p_cInput.IncrementRecursionDepth());
+
+		if (p_pFieldPlan->eType == google::protobuf::FieldDescriptor::TYPE_GROUP)
 		{
-			p_pReflection->AddUInt32(p_pMessage, p_pField, uValue);
+			bSuccess = this->_DecodeMessageDatas(p_cInput, p_pFieldPlan->pChildPlan, p_pLuaState, google::protobuf::internal::WireFormatLite::MakeTag(p_pFieldPlan->pField->number(), google::protobuf::internal::WireFormatLite::WIRETYPE_END_GROUP));
 		}
 		else
 		{
-			p_pReflection->SetUInt32(p_pMessage, p_pField, uValue);
-		}
+			uint32_t uLength = 0;
 
-		return true;
-	}
+			if (p_cInput.ReadVarint32(&uLength))
+			{
+				google::protobuf::io::CodedInputStream::Limit nLimit = p_cInput.PushLimit(static_cast<int32_t>(uLength));
 
-	uint32_t uDefaultValue = p_pField->default_value_uint32();
+				bSuccess = this->_DecodeMessageDatas(p_cInput, p_pFieldPlan->pChildPlan, p_pLuaState, 0);
 
-	if (p_bRepeated)
-	{
-		p_pReflection->AddUInt32(p_pMessage, p_pField, uDefaultValue);
+				p_cInput.PopLimit(nLimit);
+			}
+		}
+
+		p_cInput.DecrementRecursionDepth();
 	}
-	else
+	while (false);
+
+	if (!bRepeated)
 	{
-		p_pReflection->SetUInt32(p_pMessage, p_pField, uDefaultValue);
+		lua_pop(p_pLuaState, 1);
 	}
 
-	if (p_pField->is_required())
-	{
-		CCLOGWARN("Field \"%s\"'s Value Is Required, Used Default%s Value \"%u\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", uDefaultValue, p_pMessage->GetTypeName().c_str());
+	return bSuccess;
+}
+
+bool ProtocolGenerator::_DecodeWireValue(google::protobuf::io::CodedInputStream & p_cInput, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
+{
+	// 读取一个值压入栈顶，proto2中未定义的枚举值压入nil
+
+	uint32_t uValue32 = 0;
+	uint64_t uValue64 = 0;
+
+	switch (p_pFieldPlan->eType)
+	{
+	case google::protobuf::FieldDescriptor::TYPE_INT32:
+		if (!p_cInput.ReadVarint64(&uValue64)) return false;
+		lua_pushnumber(p_pLuaState, static_cast<int32_t>(uValue64));
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_SINT32:
+		if (!p_cInput.ReadVarint32(&uValue32)) return false;
+		lua_pushnumber(p_pLuaState, google::protobuf::internal::WireFormatLite::ZigZagDecode32(uValue32));
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_SFIXED32:
+		if (!p_cInput.ReadLittleEndian32(&uValue32)) return false;
+		lua_pushnumber(p_pLuaState, static_cast<int32_t>(uValue32));
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_UINT32:
+		if (!p_cInput.ReadVarint32(&uValue32)) return false;
+		lua_pushnumber(p_pLuaState, uValue32);
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_FIXED32:
+		if (!p_cInput.ReadLittleEndian32(&uValue32)) return false;
+		lua_pushnumber(p_pLuaState, uValue32);
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_INT64:
+		if (!p_cInput.ReadVarint64(&uValue64)) return false;
+		PushLuaInt64Value(p_pLuaState, static_cast<int64_t>(uValue64));
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_SINT64:
+		if (!p_cInput.ReadVarint64(&uValue64)) return false;
+		PushLuaInt64Value(p_pLuaState, google::protobuf::internal::WireFormatLite::ZigZagDecode64(uValue64));
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_SFIXED64:
+		if (!p_cInput.ReadLittleEndian64(&uValue64)) return false;
+		PushLuaInt64Value(p_pLuaState, static_cast<int64_t>(uValue64));
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_UINT64:
+		if (!p_cInput.ReadVarint64(&uValue64)) return false;
+		PushLuaUInt64Value(p_pLuaState, uValue64);
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_FIXED64:
+		if (!p_cInput.ReadLittleEndian64(&uValue64)) return false;
+		PushLuaUInt64Value(p_pLuaState, uValue64);
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_FLOAT:
+		if (!p_cInput.ReadLittleEndian32(&uValue32)) return false;
+		lua_pushnumber(p_pLuaState, google::protobuf::internal::WireFormatLite::DecodeFloat(uValue32));
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_DOUBLE:
+		if (!p_cInput.ReadLittleEndian64(&uValue64)) return false;
+		lua_pushnumber(p_pLuaState, google::protobuf::internal::WireFormatLite::DecodeDouble(uValue64));
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_BOOL:
+		if (!p_cInput.ReadVarint64(&uValue64)) return false;
+		lua_pushboolean(p_pLuaState, 0 != uValue64);
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_ENUM:
+		{
+			if (!p_cInput.ReadVarint64(&uValue64)) return false;
+
+			int32_t nValue = static_cast<int32_t>(uValue64);
+
+			if (p_pFieldPlan->bClosedEnum && nullptr == p_pFieldPlan->pField->enum_type()->FindValueByNumber(nValue))
+			{
+				lua_pushnil(p_pLuaState);
+			}
+			else
+			{
+				lua_pushnumber(p_pLuaState, nValue);
+			}
+		}
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_STRING:
+	case google::protobuf::FieldDescriptor::TYPE_BYTES:
+		{
+			// 数据在连续的内存中时直接引用输入缓冲区，不需要拷贝到std::string；只有跨越环形缓冲区末尾的字符串才需要拼接
+
+			const void * pData = nullptr;
+
+			int32_t nSize = 0;
+
+			if (!p_cInput.ReadVarint32(&uValue32) || static_cast<int32_t>(uValue32) < 0) return false;
+
+			p_cInput.GetDirectBufferPointer(&pData, &nSize);
+
+			if (static_cast<int32_t>(uValue32) > nSize)
+			{
+				std::string strValue;
+
+				if (!p_cInput.ReadString(&strValue, static_cast<int32_t>(uValue32))) return false;
+
+				lua_pushlstring(p_pLuaState, strValue.data(), strValue.size());
+			}
+			else
+			{
+				lua_pushlstring(p_pLuaState, static_cast<const char *>(pData), uValue32);
+
+				p_cInput.Skip(static_cast<int32_t>(uValue32));
+			}
+		}
+		break;
+	default:
+		return CCLOGERROR("Field \"%s\"'s Type(%d) Is Unsupported!", p_pFieldPlan->pField->name().c_str(), static_cast<int32_t>(p_pFieldPlan->eType)), false;
 	}
-#if defined(_DEBUG)
-	else
+
+	return true;
+}
+
+bool ProtocolGenerator::_DecodeMessage(const ProtocolGenerator::MessagePlan * p_pMessagePlan, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, ProtocolGenerator::DecodedMessage & p_cDecodedMessage, bool p_bSparse) const
+{
+	// 先拷贝一份数据，字符串在中间结果中只记录位置，调用之后原来的缓冲区就可以复用
+
+	p_cDecodedMessage.Clean();
+
+	p_cDecodedMessage.pMessagePlan = p_pMessagePlan;
+	p_cDecodedMessage.bSparse      = p_bSparse;
+
+	p_cDecodedMessage.strBuffer.assign(reinterpret_cast<const char *>(p_pszDataBuffer), static_cast<size_t>(p_nDataSize));
+
+	google::protobuf::io::CodedInputStream cInput(reinterpret_cast<const uint8_t *>(p_cDecodedMessage.strBuffer.data()), p_nDataSize);
+
+	cInput.PushLimit(p_nDataSize);
+
+	if (!this->_DecodeIntermediateDatas(cInput, p_pMessagePlan, p_cDecodedMessage, 0))
 	{
-		CCLOGINFO("Field \"%s\"'s Value Is Optional Or Repeated, Used Default%s Value \"%u\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", uDefaultValue, p_pMessage->GetTypeName().c_str());
+		p_cDecodedMessage.Clean();
+
+		return CCLOGERROR("Message Type \"%s\" Decode Fail!", p_pMessagePlan->pDescriptor->full_name().c_str()), false;
 	}
-#endif
 
 	return true;
 }
 
-bool ProtocolGenerator::_FillUInt64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated)
+bool ProtocolGenerator::_DecodeIntermediateDatas(google::protobuf::io::CodedInputStream & p_cInput, const ProtocolGenerator::MessagePlan * p_pMessagePlan, ProtocolGenerator::DecodedMessage & p_cDecodedMessage, uint32_t p_uEndGroupTag) const
 {
-	if (nullptr != p_pProtocolData && p_pProtocolData->eDataType == ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_VALUE && !p_pProtocolData->strValue.empty())
-	{
-		uint64_t uValue = 0;
+	// 和_DecodeMessageDatas相同的检查，只是把值追加到中间结果，不访问lua_State
 
-		sscanf(p_pProtocolData->strValue.c_str(), "%llu", &uValue);
+	for (;;)
+	{
+		uint32_t uTag = p_cInput.ReadTag();
 
-		if (p_bRepeated)
+		if (0 == uTag)
 		{
-			p_pReflection->AddUInt64(p_pMessage, p_pField, uValue);
+			if (0 != p_uEndGroupTag || 0 != p_cInput.BytesUntilLimit())
+			{
+				return false;
+			}
+
+			break;
 		}
-		else
+
+		uint32_t uWireType = google::protobuf::internal::WireFormatLite::GetTagWireType(uTag);
+
+		if (uWireType == google::protobuf::internal::WireFormatLite::WIRETYPE_END_GROUP)
 		{
-			p_pReflection->SetUInt64(p_pMessage, p_pField, uValue);
+			if (uTag != p_uEndGroupTag)
+			{
+				return false;
+			}
+
+			break;
 		}
 
-		return true;
-	}
+		const ProtocolGenerator::FieldPlan * pFieldPlan = p_pMessagePlan->FindFieldPlan(google::protobuf::internal::WireFormatLite::GetTagFieldNumber(uTag));
 
-	uint64_t uDefaultValue = p_pField->default_value_uint64();
+		if (nullptr == pFieldPlan || !IsWireTypeAccepted(pFieldPlan, uWireType))
+		{
+			if (!google::protobuf::internal::WireFormatLite::SkipField(&p_cInput, uTag))
+			{
+				return false;
+			}
 
-	if (p_bRepeated)
-	{
-		p_pReflection->AddUInt64(p_pMessage, p_pField, uDefaultValue);
-	}
-	else
-	{
-		p_pReflection->SetUInt64(p_pMessage, p_pField, uDefaultValue);
-	}
+			continue;
+		}
 
-	if (p_pField->is_required())
-	{
-		CCLOGWARN("Field \"%s\"'s Value Is Required, Used Default%s Value \"%llu\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", uDefaultValue, p_pMessage->GetTypeName().c_str());
-	}
-#if defined(_DEBUG)
-	else
-	{
-		CCLOGINFO("Field \"%s\"'s Value Is Optional Or Repeated, Used Default%s Value \"%llu\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", uDefaultValue, p_pMessage->GetTypeName().c_str());
+		if (!this->_DecodeIntermediateField(p_cInput, pFieldPlan, p_cDecodedMessage, uWireType))
+		{
+			return CCLOGERROR("Field \"%s\" Decode Fail! Message Type : \"%s\".", pFieldPlan->pField->name().c_str(), p_pMessagePlan->pDescriptor->full_name().c_str()), false;
+		}
 	}
-#endif
 
 	return true;
 }
 
-bool ProtocolGenerator::_FillFloat32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated)
+bool ProtocolGenerator::_DecodeIntermediateField(google::protobuf::io::CodedInputStream & p_cInput, const ProtocolGenerator::FieldPlan * p_pFieldPlan, ProtocolGenerator::DecodedMessage & p_cDecodedMessage, uint32_t p_uWireType) const
 {
-	if (nullptr != p_pProtocolData && p_pProtocolData->eDataType == ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_VALUE && !p_pProtocolData->strValue.empty())
+	std::vector<ProtocolGenerator::DecodedValue> & vecValues = p_cDecodedMessage.vecValues;
+
+	if (nullptr != p_pFieldPlan->pChildPlan)
 	{
-		float32_t fValue = 0.f;
+		ProtocolGenerator::DecodedValue cValue;
 
-		sscanf(p_pProtocolData->strValue.c_str(), "%f", &fValue);
+		cValue.pFieldPlan = p_pFieldPlan;
+		cValue.eValueType = ProtocolGenerator::DECODED_VALUE_TYPE::DECODED_VALUE_MESSAGE_BEGIN;
 
-		if (p_bRepeated)
+		vecValues.push_back(cValue);
+
+		if (!p_cInput.IncrementRecursionDepth())
 		{
-			p_pReflection->AddFloat(p_pMessage, p_pField, fValue);
+			return false;
+		}
+
+		bool bSuccess = false;
+
+		if (p_pFieldPlan->eType == google::protobuf::FieldDescriptor::TYPE_GROUP)
+		{
+			bSuccess = this->_DecodeIntermediateDatas(p_cInput, p_pFieldPlan->pChildPlan, p_cDecodedMessage, google::protobuf::internal::WireFormatLite::MakeTag(p_pFieldPlan->pField->number(), google::protobuf::internal::WireFormatLite::WIRETYPE_END_GROUP));
 		}
 		else
 		{
-			p_pReflection->SetFloat(p_pMessage, p_pField, fValue);
+			uint32_t uLength = 0;
+
+			if (p_cInput.ReadVarint32(&uLength))
+			{
+				google::protobuf::io::CodedInputStream::Limit nLimit = p_cInput.PushLimit(static_cast<int32_t>(uLength));
+
+				bSuccess = this->_DecodeIntermediateDatas(p_cInput, p_pFieldPlan->pChildPlan, p_cDecodedMessage, 0);
+
+				p_cInput.PopLimit(nLimit);
+			}
 		}
 
-		return true;
-	}
+		p_cInput.DecrementRecursionDepth();
 
-	float32_t fDefaultValue = p_pField->default_value_float();
+		cValue.eValueType = ProtocolGenerator::DECODED_VALUE_TYPE::DECODED_VALUE_MESSAGE_END;
 
-	if (p_bRepeated)
-	{
-		p_pReflection->AddFloat(p_pMessage, p_pField, fDefaultValue);
+		vecValues.push_back(cValue);
+
+		return bSuccess;
 	}
-	else
+
+	bool bPacked = p_pFieldPlan->bRepeated && p_uWireType == google::protobuf::internal::WireFormatLite::WIRETYPE_LENGTH_DELIMITED && p_pFieldPlan->eType != google::protobuf::FieldDescriptor::TYPE_STRING && p_pFieldPlan->eType != google::protobuf::FieldDescriptor::TYPE_BYTES;
+
+	if (!bPacked)
 	{
-		p_pReflection->SetFloat(p_pMessage, p_pField, fDefaultValue);
+		return this->_DecodeIntermediateValue(p_cInput, p_pFieldPlan, p_cDecodedMessage);
 	}
 
-	if (p_pField->is_required())
+	uint32_t uLength = 0;
+
+	if (!p_cInput.ReadVarint32(&uLength))
 	{
-		CCLOGWARN("Field \"%s\"'s Value Is Required, Used Default%s Value \"%f\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", fDefaultValue, p_pMessage->GetTypeName().c_str());
+		return false;
 	}
-#if defined(_DEBUG)
-	else
+
+	vecValues.reserve(vecValues.size() + GetWirePackedCount(p_cInput, p_pFieldPlan->eType, uLength));
+
+	google::protobuf::io::CodedInputStream::Limit nLimit = p_cInput.PushLimit(static_cast<int32_t>(uLength));
+
+	bool bValid = true;
+
+	while (bValid && p_cInput.BytesUntilLimit() > 0)
 	{
-		CCLOGINFO("Field \"%s\"'s Value Is Optional Or Repeated, Used Default%s Value \"%f\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", fDefaultValue, p_pMessage->GetTypeName().c_str());
+		bValid = this->_DecodeIntermediateValue(p_cInput, p_pFieldPlan, p_cDecodedMessage);
 	}
-#endif
 
-	return true;
+	p_cInput.PopLimit(nLimit);
+
+	return bValid;
 }
 
-bool ProtocolGenerator::_FillFloat64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated)
+bool ProtocolGenerator::_DecodeIntermediateValue(google::protobuf::io::CodedInputStream & p_cInput, const ProtocolGenerator::FieldPlan * p_pFieldPlan, ProtocolGenerator::DecodedMessage & p_cDecodedMessage) const
 {
-	if (nullptr != p_pProtocolData && p_pProtocolData->eDataType == ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_VALUE && !p_pProtocolData->strValue.empty())
-	{
-		float64_t fValue = 0;
+	// 和_DecodeWireValue一一对应，64位整数保留原值，到主线程再按__LUA_SET_INT64_AS_STRING__转换
+
+	ProtocolGenerator::DecodedValue cValue;
+
+	cValue.pFieldPlan = p_pFieldPlan;
+	cValue.eValueType = ProtocolGenerator::DECODED_VALUE_TYPE::DECODED_VALUE_NUMBER;
+
+	uint32_t uValue32 = 0;
+	uint64_t uValue64 = 0;
+
+	switch (p_pFieldPlan->eType)
+	{
+	case google::protobuf::FieldDescriptor::TYPE_INT32:
+		if (!p_cInput.ReadVarint64(&uValue64)) return false;
+		cValue.fNumber = static_cast<int32_t>(uValue64);
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_SINT32:
+		if (!p_cInput.ReadVarint32(&uValue32)) return false;
+		cValue.fNumber = google::protobuf::internal::WireFormatLite::ZigZagDecode32(uValue32);
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_SFIXED32:
+		if (!p_cInput.ReadLittleEndian32(&uValue32)) return false;
+		cValue.fNumber = static_cast<int32_t>(uValue32);
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_UINT32:
+		if (!p_cInput.ReadVarint32(&uValue32)) return false;
+		cValue.fNumber = uValue32;
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_FIXED32:
+		if (!p_cInput.ReadLittleEndian32(&uValue32)) return false;
+		cValue.fNumber = uValue32;
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_INT64:
+		if (!p_cInput.ReadVarint64(&uValue64)) return false;
+		cValue.eValueType = ProtocolGenerator::DECODED_VALUE_TYPE::DECODED_VALUE_INT64;
+		cValue.nInt64 = static_cast<int64_t>(uValue64);
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_SINT64:
+		if (!p_cInput.ReadVarint64(&uValue64)) return false;
+		cValue.eValueType = ProtocolGenerator::DECODED_VALUE_TYPE::DECODED_VALUE_INT64;
+		cValue.nInt64 = google::protobuf::internal::WireFormatLite::ZigZagDecode64(uValue64);
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_SFIXED64:
+		if (!p_cInput.ReadLittleEndian64(&uValue64)) return false;
+		cValue.eValueType = ProtocolGenerator::DECODED_VALUE_TYPE::DECODED_VALUE_INT64;
+		cValue.nInt64 = static_cast<int64_t>(uValue64);
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_UINT64:
+		if (!p_cInput.ReadVarint64(&uValue64)) return false;
+		cValue.eValueType = ProtocolGenerator::DECODED_VALUE_TYPE::DECODED_VALUE_UINT64;
+		cValue.uUInt64 = uValue64;
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_FIXED64:
+		if (!p_cInput.ReadLittleEndian64(&uValue64)) return false;
+		cValue.eValueType = ProtocolGenerator::DECODED_VALUE_TYPE::DECODED_VALUE_UINT64;
+		cValue.uUInt64 = uValue64;
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_FLOAT:
+		if (!p_cInput.ReadLittleEndian32(&uValue32)) return false;
+		cValue.fNumber = google::protobuf::internal::WireFormatLite::DecodeFloat(uValue32);
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_DOUBLE:
+		if (!p_cInput.ReadLittleEndian64(&uValue64)) return false;
+		cValue.fNumber = google::protobuf::internal::WireFormatLite::DecodeDouble(uValue64);
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_BOOL:
+		if (!p_cInput.ReadVarint64(&uValue64)) return false;
+		cValue.eValueType = ProtocolGenerator::DECODED_VALUE_TYPE::DECODED_VALUE_BOOL;
+		cValue.bBoolean = 0 != uValue64;
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_ENUM:
+		{
+			if (!p_cInput.ReadVarint64(&uValue64)) return false;
 
-		sscanf(p_pProtocolData->strValue.c_str(), "%lf", &fValue);
+			int32_t nValue = static_cast<int32_t>(uValue64);
 
-		if (p_bRepeated)
-		{
-			p_pReflection->AddDouble(p_pMessage, p_pField, fValue);
+			if (p_pFieldPlan->bClosedEnum && nullptr == p_pFieldPlan->pField->enum_type()->FindValueByNumber(nValue))
+			{
+				if (p_pFieldPlan->bRepeated)
+				{
+					return true; // repeated中未定义的枚举值直接丢弃
+				}
+
+				cValue.eValueType = ProtocolGenerator::DECODED_VALUE_TYPE::DECODED_VALUE_NIL;
+			}
+			else
+			{
+				cValue.fNumber = nValue;
+			}
 		}
-		else
+		break;
+	case google::protobuf::FieldDescriptor::TYPE_STRING:
+	case google::protobuf::FieldDescriptor::TYPE_BYTES:
 		{
-			p_pReflection->SetDouble(p_pMessage, p_pField, fValue);
-		}
+			// 输入就是strBuffer，直接记录字符串的位置
 
-		return true;
-	}
+			const void * pData = nullptr;
 
-	float64_t fDefaultValue = p_pField->default_value_double();
+			int32_t nSize = 0;
 
-	if (p_bRepeated)
-	{
-		p_pReflection->AddDouble(p_pMessage, p_pField, fDefaultValue);
-	}
-	else
-	{
-		p_pReflection->SetDouble(p_pMessage, p_pField, fDefaultValue);
-	}
+			if (!p_cInput.ReadVarint32(&uValue32) || static_cast<int32_t>(uValue32) < 0) return false;
 
-	if (p_pField->is_required())
-	{
-		CCLOGWARN("Field \"%s\"'s Value Is Required, Used Default%s Value \"%lf\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", fDefaultValue, p_pMessage->GetTypeName().c_str());
-	}
-#if defined(_DEBUG)
-	else
-	{
-		CCLOGINFO("Field \"%s\"'s Value Is Optional Or Repeated, Used Default%s Value \"%lf\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", fDefaultValue, p_pMessage->GetTypeName().c_str());
+			p_cInput.GetDirectBufferPointer(&pData, &nSize);
+
+			if (static_cast<int32_t>(uValue32) > nSize) return false;
+
+			cValue.eValueType = ProtocolGenerator::DECODED_VALUE_TYPE::DECODED_VALUE_STRING;
+			cValue.cString.uOffset = static_cast<uint32_t>(static_cast<const char *>(pData) - p_cDecodedMessage.strBuffer.data());
+			cValue.cString.uSize   = uValue32;
+
+			p_cInput.Skip(static_cast<int32_t>(uValue32));
+		}
+		break;
+	default:
+		return CCLOGERROR("Field \"%s\"'s Type(%d) Is Unsupported!", p_pFieldPlan->pField->name().c_str(), static_cast<int32_t>(p_pFieldPlan->eType)), false;
 	}
-#endif
+
+	p_cDecodedMessage.vecValues.push_back(cValue);
 
 	return true;
 }
 
-bool ProtocolGenerator::_FillBoolValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated)
+bool ProtocolGenerator::_PushDecodedDatas(const ProtocolGenerator::DecodedMessage & p_cDecodedMessage, size_t & p_uIndex, const ProtocolGenerator::MessagePlan * p_pMessagePlan, lua_State * p_pLuaState)
 {
-	if (nullptr != p_pProtocolData && p_pProtocolData->eDataType == ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_VALUE && !p_pProtocolData->strValue.empty())
+	// 按_DecodeWireFieldValue相同的规则写入栈顶的table，直到当前消息的MESSAGE_END
+
+	const std::vector<ProtocolGenerator::DecodedValue> & vecValues = p_cDecodedMessage.vecValues;
+
+	size_t uCount = vecValues.size();
+
+	while (p_uIndex < uCount)
 	{
-		if (0 == p_pProtocolData->strValue.compare("true"))
+		const ProtocolGenerator::DecodedValue & cValue = vecValues[p_uIndex++];
+		const ProtocolGenerator::FieldPlan * pFieldPlan = cValue.pFieldPlan;
+
+		if (cValue.eValueType == ProtocolGenerator::DECODED_VALUE_TYPE::DECODED_VALUE_MESSAGE_END)
 		{
-			if (p_bRepeated)
+			break;
+		}
+
+		if (!pFieldPlan->bRepeated)
+		{
+			this->_ClearLuaOneofFields(pFieldPlan, p_pLuaState);
+		}
+
+		if (cValue.eValueType == ProtocolGenerator::DECODED_VALUE_TYPE::DECODED_VALUE_MESSAGE_BEGIN)
+		{
+			int32_t nFieldCount = static_cast<int32_t>(pFieldPlan->pChildPlan->vecFields.size());
+
+			bool bSuccess = false;
+
+			if (pFieldPlan->bRepeated)
 			{
-				p_pReflection->AddBool(p_pMessage, p_pField, true);
+				this->_PushLuaFieldTable(pFieldPlan, p_pLuaState, 0, 0);
+
+				int32_t nLength = static_cast<int32_t>(lua_objlen(p_pLuaState, -1));
+
+				lua_createtable(p_pLuaState, 0, nFieldCount);
+
+				bSuccess = this->_PushDecodedDatas(p_cDecodedMessage, p_uIndex, pFieldPlan->pChildPlan, p_pLuaState);
+
+				lua_rawseti(p_pLuaState, -2, nLength + 1);
 			}
 			else
 			{
-				p_pReflection->SetBool(p_pMessage, p_pField, true);
+				this->_PushLuaFieldTable(pFieldPlan, p_pLuaState, 0, nFieldCount);
+
+				bSuccess = this->_PushDecodedDatas(p_cDecodedMessage, p_uIndex, pFieldPlan->pChildPlan, p_pLuaState);
 			}
-			return true;
+
+			lua_pop(p_pLuaState, 1);
+
+			if (!bSuccess)
+			{
+				return false;
+			}
+
+			continue;
 		}
-		else if (0 == p_pProtocolData->strValue.compare("false"))
+
+		if (pFieldPlan->bRepeated)
 		{
-			if (p_bRepeated)
+			// 同一个字段连续的值（例如packed数组）一次追加到数组中
+
+			size_t uEnd = p_uIndex;
+
+			while (uEnd < uCount && vecValues[uEnd].pFieldPlan == pFieldPlan && vecValues[uEnd].eValueType != ProtocolGenerator::DECODED_VALUE_TYPE::DECODED_VALUE_MESSAGE_END)
 			{
-				p_pReflection->AddBool(p_pMessage, p_pField, false);
+				++uEnd;
 			}
-			else
+
+			this->_PushLuaFieldTable(pFieldPlan, p_pLuaState, static_cast<int32_t>(uEnd - p_uIndex + 1), 0);
+
+			int32_t nLength = static_cast<int32_t>(lua_objlen(p_pLuaState, -1));
+
+			this->_PushDecodedValue(p_cDecodedMessage, cValue, p_pLuaState);
+			lua_rawseti(p_pLuaState, -2, ++nLength);
+
+			for (; p_uIndex < uEnd; ++p_uIndex)
 			{
-				p_pReflection->SetBool(p_pMessage, p_pField, false);
+				this->_PushDecodedValue(p_cDecodedMessage, vecValues[p_uIndex], p_pLuaState);
+				lua_rawseti(p_pLuaState, -2, ++nLength);
 			}
-			return true;
+
+			lua_pop(p_pLuaState, 1);
+
+			continue;
 		}
-		else
+
+		if (cValue.eValueType == ProtocolGenerator::DECODED_VALUE_TYPE::DECODED_VALUE_NIL)
 		{
-			return CCLOGERROR("Boolean Field \"%s\"'s Value(%s) Is Invalid! It Must Be \"true\" Or \"false\".", p_pField->name().c_str(), p_pProtocolData->strValue.c_str()), false;
+			continue;
 		}
-	}
 
-	bool bDefaultValue = p_pField->default_value_bool();
+		this->_PushLuaFieldName(p_pLuaState, pFieldPlan);
+		this->_PushDecodedValue(p_cDecodedMessage, cValue, p_pLuaState);
 
-	if (p_bRepeated)
-	{
-		p_pReflection->AddBool(p_pMessage, p_pField, bDefaultValue);
+		lua_rawset(p_pLuaState, -3);
 	}
-	else
-	{
-		p_pReflection->SetBool(p_pMessage, p_pField, bDefaultValue);
+
+	return this->_DecodeDefaultDatas(p_pMessagePlan, p_pLuaState, true);
+}
+
+void ProtocolGenerator::_PushDecodedValue(const ProtocolGenerator::DecodedMessage & p_cDecodedMessage, const ProtocolGenerator::DecodedValue & p_cValue, lua_State * p_pLuaState)
+{
+	switch (p_cValue.eValueType)
+	{
+	case ProtocolGenerator::DECODED_VALUE_TYPE::DECODED_VALUE_NUMBER:
+		lua_pushnumber(p_pLuaState, p_cValue.fNumber);
+		break;
+	case ProtocolGenerator::DECODED_VALUE_TYPE::DECODED_VALUE_INT64:
+		PushLuaInt64Value(p_pLuaState, p_cValue.nInt64);
+		break;
+	case ProtocolGenerator::DECODED_VALUE_TYPE::DECODED_VALUE_UINT64:
+		PushLuaUInt64Value(p_pLuaState, p_cValue.uUInt64);
+		break;
+	case ProtocolGenerator::DECODED_VALUE_TYPE::DECODED_VALUE_BOOL:
+		lua_pushboolean(p_pLuaState, p_cValue.bBoolean);
+		break;
+	case ProtocolGenerator::DECODED_VALUE_TYPE::DECODED_VALUE_STRING:
+		lua_pushlstring(p_pLuaState, p_cDecodedMessage.strBuffer.data() + p_cValue.cString.uOffset, p_cValue.cString.uSize);
+		break;
+	default:
+		lua_pushnil(p_pLuaState);
+		break;
 	}
+}
 
-	if (p_pField->is_required())
+void ProtocolGenerator::_ClearLuaOneofFields(const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
+{
+	// 设置oneof中的一个字段会清掉其他字段，被清掉的字段在解码结束时按默认值填充
+
+	if (nullptr == p_pFieldPlan->pOneof)
 	{
-		CCLOGWARN("Field \"%s\"'s Value Is Required, Used Default%s Value \"%s\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", bDefaultValue ? "true" : "false", p_pMessage->GetTypeName().c_str());
+		return;
 	}
-#if defined(_DEBUG)
-	else
+
+	for (int32_t i = 0; i < p_pFieldPlan->pOneof->field_count(); ++i)
 	{
-		CCLOGINFO("Field \"%s\"'s Value Is Optional Or Repeated, Used Default%s Value \"%s\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", bDefaultValue ? "true" : "false", p_pMessage->GetTypeName().c_str());
-	}
-#endif
+		const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pOneof->field(i);
 
-	return true;
+		if (pField != p_pFieldPlan->pField)
+		{
+			this->_PushLuaFieldName(p_pLuaState, &(p_pFieldPlan->pContainingPlan->vecFields[pField->index()]));
+			lua_pushnil(p_pLuaState);
+
+			lua_rawset(p_pLuaState, -3);
+		}
+	}
 }
 
-bool ProtocolGenerator::_FillStringValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated)
+void ProtocolGenerator::_ClearLuaFieldArray(const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
 {
-	if (nullptr != p_pProtocolData && p_pProtocolData->eDataType == ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_VALUE)
+	// 清空栈顶table中该字段已有的数组，数组table本身保留，之后的元素从1开始重新追加
+
+	this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
+	lua_rawget(p_pLuaState, -2);
+
+	if (lua_istable(p_pLuaState, -1))
 	{
-		if (p_bRepeated)
+		for (int32_t i = static_cast<int32_t>(lua_objlen(p_pLuaState, -1)); i > 0; --i)
 		{
-			p_pReflection->AddString(p_pMessage, p_pField, p_pProtocolData->strValue);
-		}
-		else
-		{
-			p_pReflection->SetString(p_pMessage, p_pField, p_pProtocolData->strValue);
+			lua_pushnil(p_pLuaState);
+			lua_rawseti(p_pLuaState, -2, i);
 		}
-		return true;
 	}
 
-	const std::string & strDefaultValue = p_pField->default_value_string();
+	lua_pop(p_pLuaState, 1);
+}
 
-	if (p_bRepeated)
+void ProtocolGenerator::_PushLuaFieldTable(const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState, int32_t p_nArraySize, int32_t p_nHashSize)
+{
+	// 压入栈顶table中该字段已有的table，没有时新建一个并设置到字段上
+
+	this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
+	lua_rawget(p_pLuaState, -2);
+
+	if (!lua_istable(p_pLuaState, -1))
 	{
-		p_pReflection->AddString(p_pMessage, p_pField, strDefaultValue);
+		lua_pop(p_pLuaState, 1);
+
+		this->_NewLuaTable(p_pLuaState, p_nArraySize, p_nHashSize);
+
+		this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
+		lua_pushvalue(p_pLuaState, -2);
+
+		lua_rawset(p_pLuaState, -4);
 	}
-	else
+}
+
+void ProtocolGenerator::_NewLuaTable(lua_State * p_pLuaState, int32_t p_nArraySize, int32_t p_nHashSize)
+{
+	// ParseMessageInto期间优先使用回收的table，它们已经清空，但保留了之前申请的数组和哈希空间
+
+	ProtocolGenerator::Context * pContext = this->_GetContext();
+
+	if (pContext->nLuaTablePoolSize > 0)
 	{
-		p_pReflection->SetString(p_pMessage, p_pField, strDefaultValue);
+		lua_rawgeti(p_pLuaState, pContext->nLuaTablePoolIndex, pContext->nLuaTablePoolSize);
+
+		lua_pushnil(p_pLuaState);
+		lua_rawseti(p_pLuaState, pContext->nLuaTablePoolIndex, pContext->nLuaTablePoolSize--);
+
+		return;
 	}
 
-	if (p_pField->is_required())
-	{
-		CCLOGWARN("Field \"%s\"'s Value Is Required, Used Default%s Value \"%s\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", strDefaultValue.c_str(), p_pMessage->GetTypeName().c_str());
+	lua_createtable(p_pLuaState, p_nArraySize, p_nHashSize);
+}
+
+void ProtocolGenerator::_RecycleLuaTable(const ProtocolGenerator::MessagePlan * p_pMessagePlan, lua_State * p_pLuaState, int32_t p_nIndex)
+{
+	// 把消息字段对应的子table（包括repeated消息的每个元素）清空后放入池中，再清空p_nIndex处的table本身
+	// 其他的键只清除，不回收它们的值；p_pMessagePlan为空时只清空table
+
+	ProtocolGenerator::Context * pContext = this->_GetContext();
+
+	if (nullptr != p_pMessagePlan)
+	{
+		for (auto pIter = p_pMessagePlan->vecFields.begin(), pIterEnd = p_pMessagePlan->vecFields.end(); pIter != pIterEnd; ++pIter)
+		{
+			const ProtocolGenerator::FieldPlan * pFieldPlan = &(*pIter);
+
+			if (!pFieldPlan->bRepeated && nullptr == pFieldPlan->pChildPlan)
+			{
+				continue;
+			}
+
+			this->_PushLuaFieldName(p_pLuaState, pFieldPlan);
+			lua_rawget(p_pLuaState, p_nIndex);
+
+			if (!lua_istable(p_pLuaState, -1))
+			{
+				lua_pop(p_pLuaState, 1); continue;
+			}
+
+			int32_t nTableIndex = lua_gettop(p_pLuaState);
+
+			if (pFieldPlan->bRepeated && nullptr != pFieldPlan->pChildPlan)
+			{
+				int32_t nCount = static_cast<int32_t>(lua_objlen(p_pLuaState, nTableIndex));
+
+				for (int32_t i = 1; i <= nCount; ++i)
+				{
+					lua_rawgeti(p_pLuaState, nTableIndex, i);
+
+					if (!lua_istable(p_pLuaState, -1))
+					{
+						lua_pop(p_pLuaState, 1); continue;
+					}
+
+					this->_RecycleLuaTable(pFieldPlan->pChildPlan, p_pLuaState, lua_gettop(p_pLuaState));
+
+					lua_rawseti(p_pLuaState, pContext->nLuaTablePoolIndex, ++pContext->nLuaTablePoolSize);
+				}
+			}
+
+			this->_RecycleLuaTable(pFieldPlan->bRepeated ? nullptr : pFieldPlan->pChildPlan, p_pLuaState, nTableIndex);
+
+			lua_rawseti(p_pLuaState, pContext->nLuaTablePoolIndex, ++pContext->nLuaTablePoolSize);
+		}
 	}
-#if defined(_DEBUG)
-	else
+
+	// 遍历时把已有的键设置为nil是允许的
+
+	lua_pushnil(p_pLuaState);
+
+	while (0 != lua_next(p_pLuaState, p_nIndex))
 	{
-		CCLOGINFO("Field \"%s\"'s Value Is Optional Or Repeated, Used Default%s Value \"%s\". Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", strDefaultValue.c_str(), p_pMessage->GetTypeName().c_str());
-	}
-#endif
+		lua_pop(p_pLuaState, 1);
 
-	return true;
+		lua_pushvalue(p_pLuaState, -1);
+		lua_pushnil(p_pLuaState);
+
+		lua_rawset(p_pLuaState, p_nIndex);
+	}
 }
 
-bool ProtocolGenerator::_FillEnumValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated)
+bool ProtocolGenerator::_DecodeDefaultDatas(const ProtocolGenerator::MessagePlan * p_pMessagePlan, lua_State * p_pLuaState, bool p_bCheckRequired)
 {
-	if (nullptr != p_pProtocolData && p_pProtocolData->eDataType == ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_VALUE && !p_pProtocolData->strValue.empty())
+	// 和Reflection读取一样，没有出现的非repeated字段使用默认值，子消息为填好默认值的table
+	// 稀疏解码时不填默认值，只检查required字段；合并解码的数据本来就只有变化的部分，不检查required字段
+
+	ProtocolGenerator::Context * pContext = this->_GetContext();
+
+	bool bSparse = pContext->bSparseDecode || p_pMessagePlan->bSparse;
+
+	bool bCheckRequired = p_bCheckRequired && !pContext->bMergeDecode;
+
+	if (bSparse && !bCheckRequired)
 	{
-		const google::protobuf::EnumDescriptor * pEnumDescriptor = p_pField->enum_type();
+		return true;
+	}
 
-		if (nullptr == pEnumDescriptor)
+	for (auto pIter = p_pMessagePlan->vecFields.begin(), pIterEnd = p_pMessagePlan->vecFields.end(); pIter != pIterEnd; ++pIter)
+	{
+		const ProtocolGenerator::FieldPlan * pFieldPlan = &(*pIter);
+
+		if (pFieldPlan->bRepeated || (bSparse && !pFieldPlan->bRequired))
 		{
-			return CCLOGERROR("Field \"%s\"'s Descriptor Is NULL! Message Type : \"%s\".", p_pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
+			continue;
 		}
 
-		int32_t nValue = 0;
+		this->_PushLuaFieldName(p_pLuaState, pFieldPlan);
+		lua_rawget(p_pLuaState, -2);
 
-		sscanf(p_pProtocolData->strValue.c_str(), "%d", &nValue);
+		bool bExist = !lua_isnil(p_pLuaState, -1);
 
-		const google::protobuf::EnumValueDescriptor * pEnumValueDescriptor = pEnumDescriptor->FindValueByNumber(nValue);
+		lua_pop(p_pLuaState, 1);
 
-		if (nullptr == pEnumValueDescriptor)
+		if (bExist)
 		{
-			return CCLOGERROR("Field \"%s\"'s EnumValueDescriptor(%d) Is NULL! Message Type : \"%s\".", p_pField->name().c_str(), nValue, p_pMessage->GetTypeName().c_str()), false;
+			continue;
 		}
 
-		if (p_bRepeated)
+		if (bCheckRequired && pFieldPlan->bRequired)
 		{
-			p_pReflection->AddEnum(p_pMessage, p_pField, pEnumValueDescriptor);
+			return CCLOGERROR("Required Field \"%s\" Is Missing! Message Type : \"%s\".", pFieldPlan->pField->name().c_str(), p_pMessagePlan->pDescriptor->full_name().c_str()), false;
 		}
-		else
+
+		if (bSparse)
 		{
-			p_pReflection->SetEnum(p_pMessage, p_pField, pEnumValueDescriptor);
+			continue;
 		}
 
-		return true;
-	}
+		this->_PushLuaFieldName(p_pLuaState, pFieldPlan);
 
-	const google::protobuf::EnumValueDescriptor * pDefaultEnumValueDescriptor = p_pField->default_value_enum();
+		this->_PushDefaultLuaValue(pFieldPlan, p_pLuaState);
 
-	if (nullptr == pDefaultEnumValueDescriptor)
-	{
-		return CCLOGERROR("Field \"%s\"'s Value Is Required! Message Type : \"%s\".", p_pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
+		lua_rawset(p_pLuaState, -3);
 	}
 
-	if (p_bRepeated)
-	{
-		p_pReflection->AddEnum(p_pMessage, p_pField, pDefaultEnumValueDescriptor);
-	}
-	else
+	return true;
+}
+
+void ProtocolGenerator::_PushMessageView(lua_State * p_pLuaState, ProtocolGenerator::MessageView & p_cView)
+{
+	void * pMemory = lua_newuserdata(p_pLuaState, sizeof(ProtocolGenerator::MessageView));
+
+	new (pMemory) ProtocolGenerator::MessageView(std::move(p_cView));
+
+	if (0 != luaL_newmetatable(p_pLuaState, s_pszMessageViewMetatable))
 	{
-		p_pReflection->SetEnum(p_pMessage, p_pField, pDefaultEnumValueDescriptor);
+		lua_pushcfunction(p_pLuaState, &ProtocolGenerator::_LuaMessageViewIndex);
+		lua_setfield(p_pLuaState, -2, "__index");
+
+		lua_pushcfunction(p_pLuaState, &ProtocolGenerator::_LuaMessageViewLength);
+		lua_setfield(p_pLuaState, -2, "__len");
+
+		lua_pushcfunction(p_pLuaState, &ProtocolGenerator::_LuaMessageViewPairs);
+		lua_setfield(p_pLuaState, -2, "__pairs");
+
+		lua_pushcfunction(p_pLuaState, &ProtocolGenerator::_LuaMessageViewGC);
+		lua_setfield(p_pLuaState, -2, "__gc");
 	}
 
-	if (p_pField->is_required())
+	lua_setmetatable(p_pLuaState, -2);
+}
+
+bool ProtocolGenerator::_PushMessageViewField(const ProtocolGenerator::MessageView * p_pView, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
+{
+	// 扫描一遍消息数据，只解码这一个字段；和ParseFromArray一样标量取最后一个值，子消息合并，repeated追加
+
+	bool bLazyMessage = nullptr != p_pFieldPlan->pChildPlan && p_pFieldPlan->eType != google::protobuf::FieldDescriptor::TYPE_GROUP;
+	bool bEager       = !bLazyMessage && (p_pFieldPlan->bRepeated || nullptr != p_pFieldPlan->pChildPlan);
+
+	std::vector<std::pair<const char *, int32_t> > vecSlices;
+
+	int32_t nTop = lua_gettop(p_pLuaState);
+
+	if (bEager)
 	{
-		CCLOGWARN("Field \"%s\"'s Value Is Required, Used Default%s Value \"%s\" (%d). Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", pDefaultEnumValueDescriptor->full_name().c_str(), pDefaultEnumValueDescriptor->number(), p_pMessage->GetTypeName().c_str());
+		lua_createtable(p_pLuaState, 0, 1); // repeated标量和group直接解码成table，放在临时table的同名字段中
 	}
-#if defined(_DEBUG)
 	else
 	{
-		CCLOGINFO("Field \"%s\"'s Value Is Optional Or Repeated, Used Default%s Value \"%s\" (%d). Message Type : \"%s\".", p_pField->name().c_str(), p_pField->has_default_value() ? " Specified" : "", pDefaultEnumValueDescriptor->full_name().c_str(), pDefaultEnumValueDescriptor->number(), p_pMessage->GetTypeName().c_str());
+		lua_pushnil(p_pLuaState); // 非repeated标量的当前值
 	}
-#endif
 
-	return true;
-}
+	int32_t nValueIndex = lua_gettop(p_pLuaState);
 
-bool ProtocolGenerator::_FillMessageValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated)
-{
-	if (nullptr != p_pProtocolData && p_pProtocolData->eDataType == ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_MULTI && !p_pProtocolData->vecValues.empty())
+	google::protobuf::io::CodedInputStream cInput(reinterpret_cast<const uint8_t *>(p_pView->pData), p_pView->nSize);
+
+	bool bSuccess = true;
+
+	for (;;)
 	{
-		const google::protobuf::Descriptor * pDescriptor = p_pField->message_type();
+		uint32_t uTag = cInput.ReadTag();
 
-		if (nullptr == pDescriptor)
+		if (0 == uTag)
 		{
-			return CCLOGERROR("Field \"%s\"'s Descriptor Is NULL! Message Type : \"%s\".", p_pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
+			bSuccess = cInput.ConsumedEntireMessage(); break;
 		}
 
-		bool bSuccess = true;
+		uint32_t uWireType = google::protobuf::internal::WireFormatLite::GetTagWireType(uTag);
 
-		google::protobuf::Message * pSubMessage = nullptr;
+		const ProtocolGenerator::FieldPlan * pFieldPlan = p_pView->pMessagePlan->FindFieldPlan(google::protobuf::internal::WireFormatLite::GetTagFieldNumber(uTag));
 
-		if (p_pField->is_repeated())
+		if (pFieldPlan != p_pFieldPlan || !IsWireTypeAccepted(pFieldPlan, uWireType))
 		{
-//			int32_t nFieldCountBefore = p_pReflection->FieldSize(*p_pMessage, p_pField);
+			if (nullptr != pFieldPlan && nullptr != p_pFieldPlan->pOneof && pFieldPlan->pOneof == p_pFieldPlan->pOneof && IsWireTypeAccepted(pFieldPlan, uWireType))
+			{
+				// 同一个oneof中后出现的字段会清掉之前的值
 
-			pSubMessage = p_pReflection->AddMessage(p_pMessage, p_pField, &(this->m_cMessageFactory));
+				vecSlices.clear();
 
-			if (nullptr == pSubMessage)
-			{
-				bSuccess = false;
+				if (bEager)
+				{
+					lua_createtable(p_pLuaState, 0, 1);
+				}
+				else
+				{
+					lua_pushnil(p_pLuaState);
+				}
+
+				lua_replace(p_pLuaState, nValueIndex);
 			}
 
-//			int32_t nFieldCountAfter = p_pReflection->FieldSize(*p_pMessage, p_pField);
+			bSuccess = google::protobuf::internal::WireFormatLite::SkipField(&cInput, uTag);
 
-			if (bSuccess)
-			{
-				bSuccess = this->_FillMessageDatas(pSubMessage, pSubMessage->GetDescriptor(), p_pProtocolData->vecValues);
-			}
+			CC_BREAK_IF(!bSuccess);
+
+			continue;
+		}
+
+		if (bLazyMessage)
+		{
+			uint32_t uLength = 0;
+
+			bSuccess = cInput.ReadVarint32(&uLength) && static_cast<int64_t>(uLength) <= cInput.BytesUntilLimit();
+
+			CC_BREAK_IF(!bSuccess);
+
+			vecSlices.push_back(std::make_pair(p_pView->pData + cInput.CurrentPosition(), static_cast<int32_t>(uLength)));
+
+			cInput.Skip(static_cast<int32_t>(uLength));
+		}
+		else if (bEager)
+		{
+			bSuccess = this->_DecodeWireFieldValue(cInput, p_pFieldPlan, p_pLuaState, uWireType);
+
+			CC_BREAK_IF(!bSuccess);
 		}
 		else
 		{
-			pSubMessage = this->GenerateMessage(pDescriptor->name().c_str(), p_pProtocolData->vecValues);
+			bSuccess = this->_DecodeWireValue(cInput, p_pFieldPlan, p_pLuaState);
 
-			if (nullptr == pSubMessage)
+			CC_BREAK_IF(!bSuccess);
+
+			if (lua_isnil(p_pLuaState, -1))
 			{
-				bSuccess = false;
+				lua_pop(p_pLuaState, 1); // 未定义的枚举值，保留之前的值
 			}
-
-			if (bSuccess)
+			else
 			{
-				p_pReflection->SetAllocatedMessage(p_pMessage, pSubMessage, p_pField);
+				lua_replace(p_pLuaState, nValueIndex);
 			}
 		}
+	}
 
-		if (!bSuccess)
+	if (!bSuccess)
+	{
+		lua_settop(p_pLuaState, nTop);
+
+		return CCLOGERROR("Field \"%s\" Decode Fail! Message Type : \"%s\".", p_pFieldPlan->pField->name().c_str(), p_pView->pMessagePlan->pDescriptor->full_name().c_str()), false;
+	}
+
+	if (bLazyMessage)
+	{
+		lua_pop(p_pLuaState, 1);
+
+		if (p_pFieldPlan->bRepeated && vecSlices.empty())
 		{
-			CC_SAFE_DELETE(pSubMessage);
+			lua_pushnil(p_pLuaState); // 和ParseMessage一样，没有元素的repeated字段为nil
+
+			return true;
 		}
 
-		return bSuccess;
-	}
+		ProtocolGenerator::MessageView cView;
 
-	// 嵌套的message不会有默认值，因此这里不处理默认值的情况
+		cView.pGenerator   = this;
+		cView.pMessagePlan = p_pFieldPlan->pChildPlan;
+		cView.pBuffer      = p_pView->pBuffer;
+		cView.bCache       = p_pView->bCache;
 
-	if (p_pField->is_required())
-	{
-		return CCLOGERROR("Field \"%s\"'s Value Is Required! Message Type : \"%s\".", p_pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
-	}
+		if (p_pFieldPlan->bRepeated)
+		{
+			cView.pFieldPlan  = p_pFieldPlan;
+			cView.vecElements = std::move(vecSlices);
+		}
+		else if (vecSlices.size() == 1)
+		{
+			cView.pData = vecSlices[0].first;
+			cView.nSize = vecSlices[0].second;
+		}
+		else if (vecSlices.size() > 1)
+		{
+			// 同一个子消息出现多次时，把几段数据拼接起来，解码的结果就是合并之后的消息
+
+			std::string * pMerged = new std::string();
+
+			for (auto pIter = vecSlices.begin(), pIterEnd = vecSlices.end(); pIter != pIterEnd; ++pIter)
+			{
+				pMerged->append(pIter->first, pIter->second);
+			}
+
+			cView.pBuffer.reset(pMerged);
+			cView.pData = pMerged->data();
+			cView.nSize = static_cast<int32_t>(pMerged->size());
+		}
+
+		this->_PushMessageView(p_pLuaState, cView);
 
-	if (p_pField->is_optional())
-	{
 		return true;
 	}
 
-	if (p_pField->is_repeated())
+	if (bEager)
 	{
-		return true;
-	}
+		this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
+		lua_rawget(p_pLuaState, -2);
 
-	return CCLOGERROR("Field \"%s\" Fill Message Value With Error! Message Type : \"%s\".", p_pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
-}
+		lua_remove(p_pLuaState, -2);
+
+		if (lua_isnil(p_pLuaState, -1) && !p_pFieldPlan->bRepeated)
+		{
+			lua_pop(p_pLuaState, 1);
+
+			this->_PushDefaultLuaValue(p_pFieldPlan, p_pLuaState);
+		}
 
-bool ProtocolGenerator::_FillRepeatedInt32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData)
-{
-	if (nullptr == p_pProtocolData)
-	{
 		return true;
 	}
 
-	if (p_pProtocolData->eDataType != ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_MULTI)
+	if (lua_isnil(p_pLuaState, -1))
 	{
-		return false;
-	}
+		lua_pop(p_pLuaState, 1);
 
-	bool bSuccess = false;
+		this->_PushDefaultLuaValue(p_pFieldPlan, p_pLuaState);
+	}
 
-	for (auto pIter = p_pProtocolData->vecValues.begin(), pIterEnd = p_pProtocolData->vecValues.end(); pIter != pIterEnd; ++pIter)
-	{
-		bSuccess = false;
+	return true;
+}
 
-		CC_BREAK_IF(!this->_FillInt32Value(p_pMessage, p_pField, p_pReflection, &(*pIter), true));
+void ProtocolGenerator::_PushMessageViewElement(const ProtocolGenerator::MessageView * p_pView, int32_t p_nElementIndex, lua_State * p_pLuaState)
+{
+	ProtocolGenerator::MessageView cView;
 
-		bSuccess = true;
-	}
+	cView.pGenerator   = this;
+	cView.pMessagePlan = p_pView->pMessagePlan;
+	cView.pBuffer      = p_pView->pBuffer;
+	cView.pData        = p_pView->vecElements[p_nElementIndex].first;
+	cView.nSize        = p_pView->vecElements[p_nElementIndex].second;
+	cView.bCache       = p_pView->bCache;
 
-	return bSuccess;
+	this->_PushMessageView(p_pLuaState, cView);
 }
 
-bool ProtocolGenerator::_FillRepeatedInt64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData)
+void ProtocolGenerator::_IndexMessageView(lua_State * p_pLuaState, int32_t p_nViewIndex, int32_t p_nKeyIndex)
 {
-	if (nullptr == p_pProtocolData)
+	// 把视图中p_nKeyIndex对应的值压入栈顶，不存在的字段压入nil
+
+	ProtocolGenerator::MessageView * pView = static_cast<ProtocolGenerator::MessageView *>(luaL_checkudata(p_pLuaState, p_nViewIndex, s_pszMessageViewMetatable));
+
+	if (LUA_NOREF != pView->nCacheRef)
 	{
-		return true;
+		lua_rawgeti(p_pLuaState, LUA_REGISTRYINDEX, pView->nCacheRef);
+		lua_pushvalue(p_pLuaState, p_nKeyIndex);
+		lua_rawget(p_pLuaState, -2);
+
+		lua_remove(p_pLuaState, -2);
+
+		if (!lua_isnil(p_pLuaState, -1))
+		{
+			return;
+		}
+
+		lua_pop(p_pLuaState, 1);
 	}
 
-	if (p_pProtocolData->eDataType != ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_MULTI)
+	bool bFound = false;
+
+	if (nullptr != pView->pFieldPlan)
 	{
-		return false;
-	}
+		lua_Number fIndex = lua_type(p_pLuaState, p_nKeyIndex) == LUA_TNUMBER ? lua_tonumber(p_pLuaState, p_nKeyIndex) : 0;
 
-	bool bSuccess = false;
+		int32_t nIndex = static_cast<int32_t>(fIndex);
 
-	uint32_t nIndex = 0;
+		if (nIndex == fIndex && nIndex >= 1 && nIndex <= static_cast<int32_t>(pView->vecElements.size()))
+		{
+			pView->pGenerator->_PushMessageViewElement(pView, nIndex - 1, p_pLuaState);
 
-	for (auto pIter = p_pProtocolData->vecValues.begin(), pIterEnd = p_pProtocolData->vecValues.end(); pIter != pIterEnd; ++pIter)
+			bFound = true;
+		}
+	}
+	else if (lua_type(p_pLuaState, p_nKeyIndex) == LUA_TSTRING)
 	{
-		bSuccess = false;
+		size_t uLength = 0;
 
-		CC_BREAK_IF(!this->_FillInt64Value(p_pMessage, p_pField, p_pReflection, &(*pIter), true));
+		const char * pszName = lua_tolstring(p_pLuaState, p_nKeyIndex, &uLength);
 
-		bSuccess = true;
-	}
+		int32_t nFieldIndex = pView->pMessagePlan->FindFieldIndex(std::string(pszName, uLength));
 
-	return bSuccess;
-}
+		bFound = nFieldIndex >= 0 && pView->pGenerator->_PushMessageViewField(pView, &(pView->pMessagePlan->vecFields[nFieldIndex]), p_pLuaState);
+	}
 
-bool ProtocolGenerator::_FillRepeatedUInt32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData)
-{
-	if (nullptr == p_pProtocolData)
+	if (!bFound)
 	{
-		return true;
+		lua_pushnil(p_pLuaState); return;
 	}
 
-	if (p_pProtocolData->eDataType != ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_MULTI)
+	if (pView->bCache)
 	{
-		return false;
+		if (LUA_NOREF == pView->nCacheRef)
+		{
+			lua_newtable(p_pLuaState);
+
+			pView->nCacheRef = luaL_ref(p_pLuaState, LUA_REGISTRYINDEX);
+		}
+
+		lua_rawgeti(p_pLuaState, LUA_REGISTRYINDEX, pView->nCacheRef);
+		lua_pushvalue(p_pLuaState, p_nKeyIndex);
+		lua_pushvalue(p_pLuaState, -3);
+
+		lua_rawset(p_pLuaState, -3);
+		lua_pop(p_pLuaState, 1);
 	}
+}
 
-	bool bSuccess = false;
+int ProtocolGenerator::_LuaMessageViewIndex(lua_State * p_pLuaState)
+{
+	// 元方法可能在任意调用中触发，使用自己的字段名缓存范围，不沿用外层调用设置的栈索引
 
-	uint32_t nIndex = 0;
+	ProtocolGenerator::MessageView * pView = static_cast<ProtocolGenerator::MessageView *>(luaL_checkudata(p_pLuaState, 1, s_pszMessageViewMetatable));
 
-	for (auto pIter = p_pProtocolData->vecValues.begin(), pIterEnd = p_pProtocolData->vecValues.end(); pIter != pIterEnd; ++pIter)
-	{
-		bSuccess = false;
+	lua_settop(p_pLuaState, 2);
 
-		CC_BREAK_IF(!this->_FillUInt32Value(p_pMessage, p_pField, p_pReflection, &(*pIter), true));
+	int32_t nPrevCacheIndex = pView->pGenerator->_BeginLuaNameCache(p_pLuaState, 3);
 
-		bSuccess = true;
-	}
+	ProtocolGenerator::_IndexMessageView(p_pLuaState, 1, 2);
 
-	return bSuccess;
-}
+	pView->pGenerator->_EndLuaNameCache(p_pLuaState, nPrevCacheIndex);
 
-bool ProtocolGenerator::_FillRepeatedUInt64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData)
-{
-	if (nullptr == p_pProtocolData)
-	{
-		return true;
-	}
+	// Lua 5.1和默认的LuaJIT不会对userdata调用__pairs，没有同名字段时view:pairs()返回和__pairs一样的迭代器
 
-	if (p_pProtocolData->eDataType != ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_MULTI)
+	if (lua_isnil(p_pLuaState, -1) && lua_type(p_pLuaState, 2) == LUA_TSTRING && 0 == strcmp(lua_tostring(p_pLuaState, 2), "pairs"))
 	{
-		return false;
+		lua_pop(p_pLuaState, 1);
+		lua_pushcfunction(p_pLuaState, &ProtocolGenerator::_LuaMessageViewPairs);
 	}
 
-	bool bSuccess = false;
+	return 1;
+}
 
-	uint32_t nIndex = 0;
+int ProtocolGenerator::_LuaMessageViewLength(lua_State * p_pLuaState)
+{
+	// 和普通的table一样，消息视图的长度为0，repeated视图为元素个数
 
-	for (auto pIter = p_pProtocolData->vecValues.begin(), pIterEnd = p_pProtocolData->vecValues.end(); pIter != pIterEnd; ++pIter)
-	{
-		bSuccess = false;
+	ProtocolGenerator::MessageView * pView = static_cast<ProtocolGenerator::MessageView *>(luaL_checkudata(p_pLuaState, 1, s_pszMessageViewMetatable));
 
-		CC_BREAK_IF(!this->_FillUInt64Value(p_pMessage, p_pField, p_pReflection, &(*pIter), true));
+	lua_pushnumber(p_pLuaState, static_cast<lua_Number>(pView->vecElements.size()));
 
-		bSuccess = true;
-	}
+	return 1;
+}
 
-	return bSuccess;
+int ProtocolGenerator::_LuaMessageViewPairs(lua_State * p_pLuaState)
+{
+	luaL_checkudata(p_pLuaState, 1, s_pszMessageViewMetatable);
+
+	lua_pushcfunction(p_pLuaState, &ProtocolGenerator::_LuaMessageViewNext);
+	lua_pushvalue(p_pLuaState, 1);
+	lua_pushnil(p_pLuaState);
+
+	return 3;
 }
 
-bool ProtocolGenerator::_FillRepeatedFloat32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData)
+int ProtocolGenerator::_LuaMessageViewNext(lua_State * p_pLuaState)
 {
-	if (nullptr == p_pProtocolData)
-	{
-		return true;
-	}
+	// 消息视图按字段定义的顺序遍历，repeated视图按下标遍历
 
-	if (p_pProtocolData->eDataType != ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_MULTI)
+	ProtocolGenerator::MessageView * pView = static_cast<ProtocolGenerator::MessageView *>(luaL_checkudata(p_pLuaState, 1, s_pszMessageViewMetatable));
+
+	lua_settop(p_pLuaState, 2);
+
+	if (nullptr != pView->pFieldPlan)
 	{
-		return false;
-	}
+		int64_t nPrevIndex = lua_isnil(p_pLuaState, 2) ? 0 : LuaNumberToInt64(lua_tonumber(p_pLuaState, 2));
+
+		if (nPrevIndex < 0 || nPrevIndex >= static_cast<int64_t>(pView->vecElements.size()))
+		{
+			lua_pushnil(p_pLuaState);
+
+			return 1;
+		}
 
-	bool bSuccess = false;
+		int32_t nIndex = static_cast<int32_t>(nPrevIndex) + 1;
 
-	uint32_t nIndex = 0;
+		// 和__index一样使用自己的字段名缓存范围，缓存table放在3，结束时移除之后栈顶为key和value
 
-	for (auto pIter = p_pProtocolData->vecValues.begin(), pIterEnd = p_pProtocolData->vecValues.end(); pIter != pIterEnd; ++pIter)
-	{
-		bSuccess = false;
+		int32_t nPrevCacheIndex = pView->pGenerator->_BeginLuaNameCache(p_pLuaState, 3);
 
-		CC_BREAK_IF(!this->_FillFloat32Value(p_pMessage, p_pField, p_pReflection, &(*pIter), true));
+		lua_pushnumber(p_pLuaState, nIndex);
 
-		bSuccess = true;
-	}
+		ProtocolGenerator::_IndexMessageView(p_pLuaState, 1, 4);
 
-	return bSuccess;
-}
+		pView->pGenerator->_EndLuaNameCache(p_pLuaState, nPrevCacheIndex);
 
-bool ProtocolGenerator::_FillRepeatedFloat64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData)
-{
-	if (nullptr == p_pProtocolData)
-	{
-		return true;
+		return 2;
 	}
 
-	if (p_pProtocolData->eDataType != ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_MULTI)
-	{
-		return false;
-	}
+	int32_t nFieldIndex = 0;
 
-	bool bSuccess = false;
+	if (!lua_isnil(p_pLuaState, 2))
+	{
+		size_t uLength = 0;
 
-	uint32_t nIndex = 0;
+		const char * pszName = lua_tolstring(p_pLuaState, 2, &uLength);
 
-	for (auto pIter = p_pProtocolData->vecValues.begin(), pIterEnd = p_pProtocolData->vecValues.end(); pIter != pIterEnd; ++pIter)
-	{
-		bSuccess = false;
+		nFieldIndex = nullptr == pszName ? -1 : pView->pMessagePlan->FindFieldIndex(std::string(pszName, uLength));
 
-		CC_BREAK_IF(!this->_FillFloat64Value(p_pMessage, p_pField, p_pReflection, &(*pIter), true));
+		if (nFieldIndex < 0)
+		{
+			return luaL_error(p_pLuaState, "invalid key to 'next'");
+		}
 
-		bSuccess = true;
+		++nFieldIndex;
 	}
 
-	return bSuccess;
-}
+	int32_t nPrevCacheIndex = pView->pGenerator->_BeginLuaNameCache(p_pLuaState, 3);
 
-bool ProtocolGenerator::_FillRepeatedBoolValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData)
-{
-	if (nullptr == p_pProtocolData)
+	for (int32_t nCount = static_cast<int32_t>(pView->pMessagePlan->vecFields.size()); nFieldIndex < nCount; ++nFieldIndex)
 	{
-		return true;
-	}
+		const std::string & strName = pView->pMessagePlan->vecFields[nFieldIndex].pField->name();
 
-	if (p_pProtocolData->eDataType != ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_MULTI)
-	{
-		return false;
+		lua_settop(p_pLuaState, 3);
+		lua_pushlstring(p_pLuaState, strName.data(), strName.size());
+
+		ProtocolGenerator::_IndexMessageView(p_pLuaState, 1, 4);
+
+		if (!lua_isnil(p_pLuaState, -1))
+		{
+			return pView->pGenerator->_EndLuaNameCache(p_pLuaState, nPrevCacheIndex), 2;
+		}
 	}
 
-	bool bSuccess = false;
+	lua_settop(p_pLuaState, 3);
 
-	uint32_t nIndex = 0;
+	pView->pGenerator->_EndLuaNameCache(p_pLuaState, nPrevCacheIndex);
 
-	for (auto pIter = p_pProtocolData->vecValues.begin(), pIterEnd = p_pProtocolData->vecValues.end(); pIter != pIterEnd; ++pIter)
-	{
-		bSuccess = false;
+	lua_pushnil(p_pLuaState);
 
-		CC_BREAK_IF(!this->_FillBoolValue(p_pMessage, p_pField, p_pReflection, &(*pIter), true));
+	return 1;
+}
 
-		bSuccess = true;
-	}
+int ProtocolGenerator::_LuaMessageViewGC(lua_State * p_pLuaState)
+{
+	ProtocolGenerator::MessageView * pView = static_cast<ProtocolGenerator::MessageView *>(luaL_checkudata(p_pLuaState, 1, s_pszMessageViewMetatable));
 
-	return bSuccess;
+	luaL_unref(p_pLuaState, LUA_REGISTRYINDEX, pView->nCacheRef);
+
+	pView->~MessageView();
+
+	return 0;
 }
 
-bool ProtocolGenerator::_FillRepeatedStringValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData)
+void ProtocolGenerator::_PushDefaultLuaValue(const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
 {
-	if (nullptr == p_pProtocolData)
-	{
-		return true;
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
+
+	switch (pField->cpp_type())
+	{
+	case google::protobuf::FieldDescriptor::CPPTYPE_INT32:
+		lua_pushnumber(p_pLuaState, pField->default_value_int32());
+		break;
+	case google::protobuf::FieldDescriptor::CPPTYPE_INT64:
+		PushLuaInt64Value(p_pLuaState, pField->default_value_int64());
+		break;
+	case google::protobuf::FieldDescriptor::CPPTYPE_UINT32:
+		lua_pushnumber(p_pLuaState, pField->default_value_uint32());
+		break;
+	case google::protobuf::FieldDescriptor::CPPTYPE_UINT64:
+		PushLuaUInt64Value(p_pLuaState, pField->default_value_uint64());
+		break;
+	case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT:
+		lua_pushnumber(p_pLuaState, pField->default_value_float());
+		break;
+	case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE:
+		lua_pushnumber(p_pLuaState, pField->default_value_double());
+		break;
+	case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
+		lua_pushboolean(p_pLuaState, pField->default_value_bool());
+		break;
+	case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
+		lua_pushnumber(p_pLuaState, pField->default_value_enum()->number());
+		break;
+	case google::protobuf::FieldDescriptor::CPPTYPE_STRING:
+		lua_pushlstring(p_pLuaState, pField->default_value_string().data(), pField->default_value_string().size());
+		break;
+	case google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE:
+		this->_NewLuaTable(p_pLuaState, 0, static_cast<int32_t>(p_pFieldPlan->pChildPlan->vecFields.size()));
+		this->_DecodeDefaultDatas(p_pFieldPlan->pChildPlan, p_pLuaState, false);
+		break;
+	default:
+		lua_pushnil(p_pLuaState);
+		break;
 	}
+}
 
-	if (p_pProtocolData->eDataType != ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_MULTI)
-	{
-		return false;
-	}
+int32_t ProtocolGenerator::_BeginLuaNameCache(lua_State * p_pLuaState, int32_t p_nIndex)
+{
+	// 把当前lua_State中的字段名缓存table放到栈上p_nIndex的位置，返回之前的缓存索引，调用结束时交给_EndLuaNameCache恢复
 
-	bool bSuccess = false;
+	ProtocolGenerator::Context * pContext = this->_GetContext();
 
-	uint32_t nIndex = 0;
+	int32_t nPrevCacheIndex = pContext->nLuaNameCacheIndex;
 
-	for (auto pIter = p_pProtocolData->vecValues.begin(), pIterEnd = p_pProtocolData->vecValues.end(); pIter != pIterEnd; ++pIter)
-	{
-		bSuccess = false;
+	lua_pushlightuserdata(p_pLuaState, this);
+	lua_rawget(p_pLuaState, LUA_REGISTRYINDEX);
 
-		CC_BREAK_IF(!this->_FillStringValue(p_pMessage, p_pField, p_pReflection, &(*pIter), true));
+	bool bValid = false;
 
-		bSuccess = true;
-	}
+	if (lua_istable(p_pLuaState, -1))
+	{
+		lua_rawgeti(p_pLuaState, -1, 0);
 
-	return bSuccess;
-}
+		bValid = lua_tonumber(p_pLuaState, -1) == this->m_uLuaNameCacheSerial;
 
-bool ProtocolGenerator::_FillRepeatedEnumValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData)
-{
-	if (nullptr == p_pProtocolData)
-	{
-		return true;
+		lua_pop(p_pLuaState, 1);
 	}
 
-	if (p_pProtocolData->eDataType != ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_MULTI)
+	if (!bValid)
 	{
-		return false;
-	}
+		// 第一次在这个lua_State中使用，或者registry中是同一地址上之前的实例留下的缓存
 
-	bool bSuccess = false;
+		lua_pop(p_pLuaState, 1);
 
-	uint32_t nIndex = 0;
+		lua_createtable(p_pLuaState, static_cast<int32_t>(this->m_mapLuaNameIndexes.size()), 1);
 
-	for (auto pIter = p_pProtocolData->vecValues.begin(), pIterEnd = p_pProtocolData->vecValues.end(); pIter != pIterEnd; ++pIter)
-	{
-		bSuccess = false;
+		lua_pushnumber(p_pLuaState, this->m_uLuaNameCacheSerial);
+		lua_rawseti(p_pLuaState, -2, 0);
 
-		CC_BREAK_IF(!this->_FillEnumValue(p_pMessage, p_pField, p_pReflection, &(*pIter), true));
+		lua_pushlightuserdata(p_pLuaState, this);
+		lua_pushvalue(p_pLuaState, -2);
 
-		bSuccess = true;
+		lua_rawset(p_pLuaState, LUA_REGISTRYINDEX);
 	}
 
-	return bSuccess;
+	if (p_nIndex < lua_gettop(p_pLuaState))
+	{
+		lua_insert(p_pLuaState, p_nIndex);
+	}
+
+	pContext->nLuaNameCacheIndex = p_nIndex;
+
+	return nPrevCacheIndex;
 }
 
-bool ProtocolGenerator::_FillRepeatedMessageValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData)
+void ProtocolGenerator::_EndLuaNameCache(lua_State * p_pLuaState, int32_t p_nPrevCacheIndex)
 {
-	if (nullptr == p_pProtocolData)
-	{
-		return true;
-	}
+	ProtocolGenerator::Context * pContext = this->_GetContext();
 
-	if (p_pProtocolData->eDataType != ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_MULTI)
-	{
-		return false;
-	}
+	lua_remove(p_pLuaState, pContext->nLuaNameCacheIndex);
 
-	bool bSuccess = false;
+	pContext->nLuaNameCacheIndex = p_nPrevCacheIndex;
+}
 
-	uint32_t nIndex = 0;
+void ProtocolGenerator::_PushLuaFieldName(lua_State * p_pLuaState, const ProtocolGenerator::FieldPlan * p_pFieldPlan)
+{
+	const ProtocolGenerator::Context * pContext = this->_GetContext();
 
-	for (auto pIter = p_pProtocolData->vecValues.begin(), pIterEnd = p_pProtocolData->vecValues.end(); pIter != pIterEnd; ++pIter)
+	if (0 != pContext->nLuaNameCacheIndex)
 	{
-		bSuccess = false;
+		lua_rawgeti(p_pLuaState, pContext->nLuaNameCacheIndex, p_pFieldPlan->nLuaNameIndex);
 
-		CC_BREAK_IF(!this->_FillMessageValue(p_pMessage, p_pField, p_pReflection, &(*pIter), true));
+		if (!lua_isnil(p_pLuaState, -1))
+		{
+			return;
+		}
 
-		bSuccess = true;
+		lua_pop(p_pLuaState, 1);
 	}
 
-	return bSuccess;
+	const std::string & strName = p_pFieldPlan->pField->name();
+
+	lua_pushlstring(p_pLuaState, strName.data(), strName.size());
+
+	if (0 != pContext->nLuaNameCacheIndex)
+	{
+		lua_pushvalue(p_pLuaState, -1);
+		lua_rawseti(p_pLuaState, pContext->nLuaNameCacheIndex, p_pFieldPlan->nLuaNameIndex);
+	}
 }
 
 bool ProtocolGenerator::_AnalysisTableData(std::vector<ProtocolGenerator::ProtocolData> & p_vecTableValues, lua_State * p_pLuaState, int32_t p_nIndex)
@@ -1218,9 +5860,11 @@ bool ProtocolGenerator::_AnalysisTableData(std::vector<ProtocolGenerator::Protoc
 		{
 			bSuccess = false;
 
-			const char * pszKey = lua_tostring(p_pLuaState, -1);
+			size_t uKeyLength = 0;
 
-			CC_BREAK_IF(!CC_IS_VALID_ANSI_STR(pszKey));
+			const char * pszKey = lua_tolstring(p_pLuaState, -1, &uKeyLength);
+
+			CC_BREAK_IF(nullptr == pszKey || 0 == uKeyLength);
 
 			if (lua_istable(p_pLuaState, -2))
 			{
@@ -1237,17 +5881,21 @@ bool ProtocolGenerator::_AnalysisTableData(std::vector<ProtocolGenerator::Protoc
 			}
 			else
 			{
-				const char * pszValue = lua_tostring(p_pLuaState, -2);
+				// 按长度读取，bytes字段中的'\0'不会截断
+
+				size_t uValueLength = 0;
+
+				const char * pszValue = lua_tolstring(p_pLuaState, -2, &uValueLength);
 
 				CC_BREAK_IF(nullptr == pszValue);
 
 				cProtocolData.eDataType = ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_VALUE;
-				cProtocolData.strValue  = pszValue;
+				cProtocolData.strValue.assign(pszValue, uValueLength);
 			}
 
-			cProtocolData.strField = pszKey;
+			cProtocolData.strField.assign(pszKey, uKeyLength);
 
-			p_vecTableValues.push_back(cProtocolData);
+			p_vecTableValues.push_back(std::move(cProtocolData));
 
 			bSuccess = true;
 		}
@@ -1270,114 +5918,79 @@ bool ProtocolGenerator::_AnalysisTableData(std::vector<ProtocolGenerator::Protoc
 	return bSuccess;
 }
 
-bool ProtocolGenerator::_ParseFieldData(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState)
+bool ProtocolGenerator::_ParseMessageDatas(google::protobuf::Message * p_pMessage, const ProtocolGenerator::MessagePlan * p_pMessagePlan, lua_State * p_pLuaState)
 {
-	if (nullptr == p_pMessage || nullptr == p_pField)
+	bool bSuccess = true;
+
+	if (this->_GetContext()->bSparseDecode || p_pMessagePlan->bSparse)
 	{
-		return false;
-	}
+		// 稀疏解码只读取ListFields返回的已设置字段，扩展字段不在MessagePlan中，直接跳过
 
-// 	if (p_pField->is_optional() && p_pMessage->GetReflection()->getu)
-// 	{
-// 		if (nullptr == p_pProtocolData)
-// 		{
-// 			return false;
-// 		}
-// 	}
+		std::vector<const google::protobuf::FieldDescriptor *> vecFields;
 
-	google::protobuf::FieldDescriptor::CppType eType = p_pField->cpp_type();
+		p_pMessage->GetReflection()->ListFields(*p_pMessage, &vecFields);
 
-	if (eType == google::protobuf::FieldDescriptor::CPPTYPE_INT32)
-	{
-		if (p_pField->is_repeated())
-		{
-			return this->_ParseRepeatedInt32Value(p_pMessage, p_pField, p_pLuaState);
-		}
-		return this->_ParseInt32Value(p_pMessage, p_pField, p_pLuaState);
-	}
-	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_INT64)
-	{
-		if (p_pField->is_repeated())
-		{
-			return this->_ParseRepeatedInt64Value(p_pMessage, p_pField, p_pLuaState);
-		}
-		return this->_ParseInt64Value(p_pMessage, p_pField, p_pLuaState);
-	}
-	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_UINT32)
-	{
-		if (p_pField->is_repeated())
-		{
-			return this->_ParseRepeatedUInt32Value(p_pMessage, p_pField, p_pLuaState);
-		}
-		return this->_ParseUInt32Value(p_pMessage, p_pField, p_pLuaState);
-	}
-	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_UINT64)
-	{
-		if (p_pField->is_repeated())
-		{
-			return this->_ParseRepeatedUInt64Value(p_pMessage, p_pField, p_pLuaState);
-		}
-		return this->_ParseUInt64Value(p_pMessage, p_pField, p_pLuaState);
-	}
-	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE)
-	{
-		if (p_pField->is_repeated())
-		{
-			return this->_ParseRepeatedFloat64Value(p_pMessage, p_pField, p_pLuaState);
-		}
-		return this->_ParseFloat64Value(p_pMessage, p_pField, p_pLuaState);
-	}
-	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_FLOAT)
-	{
-		if (p_pField->is_repeated())
+		for (auto pIter = vecFields.begin(), pIterEnd = vecFields.end(); pIter != pIterEnd; ++pIter)
 		{
-			return this->_ParseRepeatedFloat32Value(p_pMessage, p_pField, p_pLuaState);
+			if ((*pIter)->is_extension())
+			{
+				continue;
+			}
+
+			bSuccess = false;
+
+			CC_BREAK_IF(!this->_ParseFieldData(p_pMessage, &(p_pMessagePlan->vecFields[(*pIter)->index()]), p_pLuaState));
+
+			bSuccess = true;
 		}
-		return this->_ParseFloat32Value(p_pMessage, p_pField, p_pLuaState);
+
+		return bSuccess;
 	}
-	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_BOOL)
+
+	for (auto pIter = p_pMessagePlan->vecFields.begin(), pIterEnd = p_pMessagePlan->vecFields.end(); pIter != pIterEnd; ++pIter)
 	{
-		if (p_pField->is_repeated())
-		{
-			return this->_ParseRepeatedBoolValue(p_pMessage, p_pField, p_pLuaState);
-		}
-		return this->_ParseBoolValue(p_pMessage, p_pField, p_pLuaState);
+		bSuccess = false;
+
+		CC_BREAK_IF(!this->_ParseFieldData(p_pMessage, &(*pIter), p_pLuaState));
+
+		bSuccess = true;
 	}
-	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_ENUM)
+
+	return bSuccess;
+}
+
+bool ProtocolGenerator::_ParseFieldData(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
+{
+	if (nullptr == p_pMessage || nullptr == p_pFieldPlan)
 	{
-		if (p_pField->is_repeated())
-		{
-			return this->_ParseRepeatedEnumValue(p_pMessage, p_pField, p_pLuaState);
-		}
-		return this->_ParseEnumValue(p_pMessage, p_pField, p_pLuaState);
+		return false;
 	}
-	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_STRING)
+
+	if (nullptr != p_pFieldPlan->pChildPlan)
 	{
-		if (p_pField->is_repeated())
+		if (p_pFieldPlan->bRepeated)
 		{
-			return this->_ParseRepeatedStringValue(p_pMessage, p_pField, p_pLuaState);
+			return this->_ParseRepeatedMessageValue(p_pMessage, p_pFieldPlan, p_pLuaState);
 		}
-		return this->_ParseStringValue(p_pMessage, p_pField, p_pLuaState);
+		return this->_ParseMessageValue(p_pMessage, p_pFieldPlan, p_pLuaState);
 	}
-	else if (eType == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
+	else if (nullptr != p_pFieldPlan->pParseHandler)
 	{
-		if (p_pField->is_repeated())
-		{
-			return this->_ParseRepeatedMessageValue(p_pMessage, p_pField, p_pLuaState);
-		}
-		return this->_ParseMessageValue(p_pMessage, p_pField, p_pLuaState);
+		return (this->*p_pFieldPlan->pParseHandler)(p_pMessage, p_pFieldPlan, p_pLuaState);
 	}
 	else
 	{
-		return CCLOGERROR("Field \"%s\"'s Type(%d) Is Unsupported! Message Type : \"%s\".", p_pField->name().c_str(), static_cast<int32_t>(eType), p_pMessage->GetTypeName().c_str()), false;
+		return CCLOGERROR("Field \"%s\"'s Type(%d) Is Unsupported! Message Type : \"%s\".", p_pFieldPlan->pField->name().c_str(), static_cast<int32_t>(p_pFieldPlan->pField->cpp_type()), p_pMessage->GetTypeName().c_str()), false;
 	}
 }
 
-bool ProtocolGenerator::_ParseInt32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState)
+bool ProtocolGenerator::_ParseInt32Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
 {
-	int32_t nValue = p_pMessage->GetReflection()->GetInt32(*p_pMessage, p_pField);
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
 
-	lua_pushstring(p_pLuaState, p_pField->name().c_str());
+	int32_t nValue = p_pMessage->GetReflection()->GetInt32(*p_pMessage, pField);
+
+	this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
 	lua_pushnumber(p_pLuaState, nValue);
 
 	lua_rawset(p_pLuaState, -3);
@@ -1385,11 +5998,13 @@ bool ProtocolGenerator::_ParseInt32Value(google::protobuf::Message * p_pMessage,
 	return true;
 }
 
-bool ProtocolGenerator::_ParseInt64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState)
+bool ProtocolGenerator::_ParseInt64Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
 {
-	int64_t nValue = p_pMessage->GetReflection()->GetInt64(*p_pMessage, p_pField);
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
+
+	int64_t nValue = p_pMessage->GetReflection()->GetInt64(*p_pMessage, pField);
 
-	lua_pushstring(p_pLuaState, p_pField->name().c_str());
+	this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
 
 #if defined __LUA_SET_INT64_AS_STRING__
 	char szValue[30] = {0};
@@ -1406,11 +6021,13 @@ bool ProtocolGenerator::_ParseInt64Value(google::protobuf::Message * p_pMessage,
 	return true;
 }
 
-bool ProtocolGenerator::_ParseUInt32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState)
+bool ProtocolGenerator::_ParseUInt32Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
 {
-	uint32_t uValue = p_pMessage->GetReflection()->GetUInt32(*p_pMessage, p_pField);
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
 
-	lua_pushstring(p_pLuaState, p_pField->name().c_str());
+	uint32_t uValue = p_pMessage->GetReflection()->GetUInt32(*p_pMessage, pField);
+
+	this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
 	lua_pushnumber(p_pLuaState, uValue);
 
 	lua_rawset(p_pLuaState, -3);
@@ -1418,11 +6035,13 @@ bool ProtocolGenerator::_ParseUInt32Value(google::protobuf::Message * p_pMessage
 	return true;
 }
 
-bool ProtocolGenerator::_ParseUInt64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState)
+bool ProtocolGenerator::_ParseUInt64Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
 {
-	uint64_t uValue = p_pMessage->GetReflection()->GetUInt64(*p_pMessage, p_pField);
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
+
+	uint64_t uValue = p_pMessage->GetReflection()->GetUInt64(*p_pMessage, pField);
 
-	lua_pushstring(p_pLuaState, p_pField->name().c_str());
+	this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
 	
 #if defined __LUA_SET_INT64_AS_STRING__
 	char szValue[30] = {0};
@@ -1439,11 +6058,13 @@ bool ProtocolGenerator::_ParseUInt64Value(google::protobuf::Message * p_pMessage
 	return true;
 }
 
-bool ProtocolGenerator::_ParseFloat32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState)
+bool ProtocolGenerator::_ParseFloat32Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
 {
-	float32_t fValue = p_pMessage->GetReflection()->GetFloat(*p_pMessage, p_pField);
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
 
-	lua_pushstring(p_pLuaState, p_pField->name().c_str());
+	float32_t fValue = p_pMessage->GetReflection()->GetFloat(*p_pMessage, pField);
+
+	this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
 	lua_pushnumber(p_pLuaState, fValue);
 
 	lua_rawset(p_pLuaState, -3);
@@ -1451,11 +6072,13 @@ bool ProtocolGenerator::_ParseFloat32Value(google::protobuf::Message * p_pMessag
 	return true;
 }
 
-bool ProtocolGenerator::_ParseFloat64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState)
+bool ProtocolGenerator::_ParseFloat64Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
 {
-	float64_t fValue = p_pMessage->GetReflection()->GetDouble(*p_pMessage, p_pField);
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
+
+	float64_t fValue = p_pMessage->GetReflection()->GetDouble(*p_pMessage, pField);
 
-	lua_pushstring(p_pLuaState, p_pField->name().c_str());
+	this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
 	lua_pushnumber(p_pLuaState, fValue);
 
 	lua_rawset(p_pLuaState, -3);
@@ -1463,11 +6086,13 @@ bool ProtocolGenerator::_ParseFloat64Value(google::protobuf::Message * p_pMessag
 	return true;
 }
 
-bool ProtocolGenerator::_ParseBoolValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState)
+bool ProtocolGenerator::_ParseBoolValue(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
 {
-	bool bValue = p_pMessage->GetReflection()->GetBool(*p_pMessage, p_pField);
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
 
-	lua_pushstring(p_pLuaState, p_pField->name().c_str());
+	bool bValue = p_pMessage->GetReflection()->GetBool(*p_pMessage, pField);
+
+	this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
 	lua_pushboolean(p_pLuaState, bValue);
 
 	lua_rawset(p_pLuaState, -3);
@@ -1475,28 +6100,36 @@ bool ProtocolGenerator::_ParseBoolValue(google::protobuf::Message * p_pMessage,
 	return true;
 }
 
-bool ProtocolGenerator::_ParseStringValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState)
+bool ProtocolGenerator::_ParseStringValue(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
 {
-	std::string strValue = p_pMessage->GetReflection()->GetString(*p_pMessage, p_pField);
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
+
+	// GetStringReference通常直接返回消息中的字符串，只有无法引用时才会写到strScratch中
+
+	std::string strScratch;
+
+	const std::string & strValue = p_pMessage->GetReflection()->GetStringReference(*p_pMessage, pField, &strScratch);
 
-	lua_pushstring(p_pLuaState, p_pField->name().c_str());
-	lua_pushstring(p_pLuaState, strValue.c_str());
+	this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
+	lua_pushlstring(p_pLuaState, strValue.data(), strValue.size()); // bytes字段中可能有'\0'
 
 	lua_rawset(p_pLuaState, -3);
 
 	return true;
 }
 
-bool ProtocolGenerator::_ParseEnumValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState)
+bool ProtocolGenerator::_ParseEnumValue(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
 {
-	const google::protobuf::EnumValueDescriptor * pEnumValueDescriptor = p_pMessage->GetReflection()->GetEnum(*p_pMessage, p_pField);
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
+
+	const google::protobuf::EnumValueDescriptor * pEnumValueDescriptor = p_pMessage->GetReflection()->GetEnum(*p_pMessage, pField);
 
 	if (nullptr == pEnumValueDescriptor)
 	{
-		return CCLOGERROR("Field \"%s\"'s EnumValueDescriptor Is NULL! Message Type : \"%s\".", p_pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
+		return CCLOGERROR("Field \"%s\"'s EnumValueDescriptor Is NULL! Message Type : \"%s\".", pField->name().c_str(), p_pMessage->GetTypeName().c_str()), false;
 	}
 
-	lua_pushstring(p_pLuaState, p_pField->name().c_str());
+	this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
 	lua_pushnumber(p_pLuaState, pEnumValueDescriptor->number());
 
 	lua_rawset(p_pLuaState, -3);
@@ -1504,44 +6137,48 @@ bool ProtocolGenerator::_ParseEnumValue(google::protobuf::Message * p_pMessage,
 	return true;
 }
 
-bool ProtocolGenerator::_ParseMessageValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState)
+bool ProtocolGenerator::_ParseMessageValue(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
 {
-	const google::protobuf::Message & cSubMessage = p_pMessage->GetReflection()->GetMessage(*p_pMessage, p_pField);
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
+
+	const google::protobuf::Message & cSubMessage = p_pMessage->GetReflection()->GetMessage(*p_pMessage, pField);
 
 	google::protobuf::Message * pSubMessage = const_cast<google::protobuf::Message *>(&cSubMessage);
 
-	lua_pushstring(p_pLuaState, p_pField->name().c_str());
+	this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
 
-	lua_newtable(p_pLuaState);
+	lua_createtable(p_pLuaState, 0, static_cast<int32_t>(p_pFieldPlan->pChildPlan->vecFields.size()));
 
-	bool bSuccess = this->ParseMessage(pSubMessage, p_pLuaState);
+	bool bSuccess = this->_ParseMessageDatas(pSubMessage, p_pFieldPlan->pChildPlan, p_pLuaState);
 
 	lua_rawset(p_pLuaState, -3);
 
 	return bSuccess;
 }
 
-bool ProtocolGenerator::_ParseRepeatedInt32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState)
+bool ProtocolGenerator::_ParseRepeatedInt32Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
 {
-	int32_t nCount = p_pMessage->GetReflection()->FieldSize(*p_pMessage, p_pField);
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
+	const google::protobuf::Reflection * pReflection = p_pMessage->GetReflection();
+
+	int32_t nCount = pReflection->FieldSize(*p_pMessage, pField);
 
 	if (nCount <= 0)
 	{
 		return true;
 	}
 
-	lua_pushstring(p_pLuaState, p_pField->name().c_str());
+	this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
 
-	lua_newtable(p_pLuaState);
+	lua_createtable(p_pLuaState, nCount, 0);
 
 	for (int32_t i = 0; i < nCount; ++i)
 	{
-		int32_t nValue = p_pMessage->GetReflection()->GetRepeatedInt64(*p_pMessage, p_pField, i);
+		int32_t nValue = pReflection->GetRepeatedInt32(*p_pMessage, pField, i);
 
-		lua_pushnumber(p_pLuaState, i + 1);
 		lua_pushnumber(p_pLuaState, nValue);
 
-		lua_rawset(p_pLuaState, -3);
+		lua_rawseti(p_pLuaState, -2, i + 1);
 	}
 
 	lua_rawset(p_pLuaState, -3);
@@ -1549,36 +6186,29 @@ bool ProtocolGenerator::_ParseRepeatedInt32Value(google::protobuf::Message * p_p
 	return true;
 }
 
-bool ProtocolGenerator::_ParseRepeatedInt64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState)
+bool ProtocolGenerator::_ParseRepeatedInt64Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
 {
-	int32_t nCount = p_pMessage->GetReflection()->FieldSize(*p_pMessage, p_pField);
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
+	const google::protobuf::Reflection * pReflection = p_pMessage->GetReflection();
+
+	int32_t nCount = pReflection->FieldSize(*p_pMessage, pField);
 
 	if (nCount <= 0)
 	{
 		return true;
 	}
 
-	lua_pushstring(p_pLuaState, p_pField->name().c_str());
+	this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
 
-	lua_newtable(p_pLuaState);
+	lua_createtable(p_pLuaState, nCount, 0);
 
 	for (int32_t i = 0; i < nCount; ++i)
 	{
-		int64_t nValue = p_pMessage->GetReflection()->GetRepeatedInt64(*p_pMessage, p_pField, i);
-
-		lua_pushnumber(p_pLuaState, i + 1);
+		int64_t nValue = pReflection->GetRepeatedInt64(*p_pMessage, pField, i);
 
-#if defined __LUA_SET_INT64_AS_STRING__
-		char szValue[30] = {0};
-
-		sprintf(szValue, "%lld", nValue);
-
-		lua_pushstring(p_pLuaState, szValue);
-#else
-		lua_pushnumber(p_pLuaState, nValue);
-#endif
+		PushLuaInt64Value(p_pLuaState, nValue);
 
-		lua_rawset(p_pLuaState, -3);
+		lua_rawseti(p_pLuaState, -2, i + 1);
 	}
 
 	lua_rawset(p_pLuaState, -3);
@@ -1586,27 +6216,29 @@ bool ProtocolGenerator::_ParseRepeatedInt64Value(google::protobuf::Message * p_p
 	return true;
 }
 
-bool ProtocolGenerator::_ParseRepeatedUInt32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState)
+bool ProtocolGenerator::_ParseRepeatedUInt32Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
 {
-	int32_t nCount = p_pMessage->GetReflection()->FieldSize(*p_pMessage, p_pField);
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
+	const google::protobuf::Reflection * pReflection = p_pMessage->GetReflection();
+
+	int32_t nCount = pReflection->FieldSize(*p_pMessage, pField);
 
 	if (nCount <= 0)
 	{
 		return true;
 	}
 
-	lua_pushstring(p_pLuaState, p_pField->name().c_str());
+	this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
 
-	lua_newtable(p_pLuaState);
+	lua_createtable(p_pLuaState, nCount, 0);
 
 	for (int32_t i = 0; i < nCount; ++i)
 	{
-		uint32_t uValue = p_pMessage->GetReflection()->GetRepeatedUInt32(*p_pMessage, p_pField, i);
+		uint32_t uValue = pReflection->GetRepeatedUInt32(*p_pMessage, pField, i);
 
-		lua_pushnumber(p_pLuaState, i + 1);
 		lua_pushnumber(p_pLuaState, uValue);
 
-		lua_rawset(p_pLuaState, -3);
+		lua_rawseti(p_pLuaState, -2, i + 1);
 	}
 
 	lua_rawset(p_pLuaState, -3);
@@ -1614,36 +6246,29 @@ bool ProtocolGenerator::_ParseRepeatedUInt32Value(google::protobuf::Message * p_
 	return true;
 }
 
-bool ProtocolGenerator::_ParseRepeatedUInt64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState)
+bool ProtocolGenerator::_ParseRepeatedUInt64Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
 {
-	int32_t nCount = p_pMessage->GetReflection()->FieldSize(*p_pMessage, p_pField);
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
+	const google::protobuf::Reflection * pReflection = p_pMessage->GetReflection();
+
+	int32_t nCount = pReflection->FieldSize(*p_pMessage, pField);
 
 	if (nCount <= 0)
 	{
 		return true;
 	}
 
-	lua_pushstring(p_pLuaState, p_pField->name().c_str());
+	this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
 
-	lua_newtable(p_pLuaState);
+	lua_createtable(p_pLuaState, nCount, 0);
 
 	for (int32_t i = 0; i < nCount; ++i)
 	{
-		uint64_t uValue = p_pMessage->GetReflection()->GetRepeatedUInt64(*p_pMessage, p_pField, i);
-
-		lua_pushnumber(p_pLuaState, i + 1);
-
-#if defined __LUA_SET_INT64_AS_STRING__
-		char szValue[30] = {0};
-
-		sprintf(szValue, "%llu", uValue);
+		uint64_t uValue = pReflection->GetRepeatedUInt64(*p_pMessage, pField, i);
 
-		lua_pushstring(p_pLuaState, szValue);
-#else
-		lua_pushnumber(p_pLuaState, uValue);
-#endif
+		PushLuaUInt64Value(p_pLuaState, uValue);
 
-		lua_rawset(p_pLuaState, -3);
+		lua_rawseti(p_pLuaState, -2, i + 1);
 	}
 
 	lua_rawset(p_pLuaState, -3);
@@ -1651,27 +6276,29 @@ bool ProtocolGenerator::_ParseRepeatedUInt64Value(google::protobuf::Message * p_
 	return true;
 }
 
-bool ProtocolGenerator::_ParseRepeatedFloat32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState)
+bool ProtocolGenerator::_ParseRepeatedFloat32Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
 {
-	int32_t nCount = p_pMessage->GetReflection()->FieldSize(*p_pMessage, p_pField);
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
+	const google::protobuf::Reflection * pReflection = p_pMessage->GetReflection();
+
+	int32_t nCount = pReflection->FieldSize(*p_pMessage, pField);
 
 	if (nCount <= 0)
 	{
 		return true;
 	}
 
-	lua_pushstring(p_pLuaState, p_pField->name().c_str());
+	this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
 
-	lua_newtable(p_pLuaState);
+	lua_createtable(p_pLuaState, nCount, 0);
 
 	for (int32_t i = 0; i < nCount; ++i)
 	{
-		float32_t fValue = p_pMessage->GetReflection()->GetRepeatedFloat(*p_pMessage, p_pField, i);
+		float32_t fValue = pReflection->GetRepeatedFloat(*p_pMessage, pField, i);
 
-		lua_pushnumber(p_pLuaState, i + 1);
 		lua_pushnumber(p_pLuaState, fValue);
 
-		lua_rawset(p_pLuaState, -3);
+		lua_rawseti(p_pLuaState, -2, i + 1);
 	}
 
 	lua_rawset(p_pLuaState, -3);
@@ -1679,27 +6306,29 @@ bool ProtocolGenerator::_ParseRepeatedFloat32Value(google::protobuf::Message * p
 	return true;
 }
 
-bool ProtocolGenerator::_ParseRepeatedFloat64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState)
+bool ProtocolGenerator::_ParseRepeatedFloat64Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
 {
-	int32_t nCount = p_pMessage->GetReflection()->FieldSize(*p_pMessage, p_pField);
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
+	const google::protobuf::Reflection * pReflection = p_pMessage->GetReflection();
+
+	int32_t nCount = pReflection->FieldSize(*p_pMessage, pField);
 
 	if (nCount <= 0)
 	{
 		return true;
 	}
 
-	lua_pushstring(p_pLuaState, p_pField->name().c_str());
+	this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
 
-	lua_newtable(p_pLuaState);
+	lua_createtable(p_pLuaState, nCount, 0);
 
 	for (int32_t i = 0; i < nCount; ++i)
 	{
-		float64_t fValue = p_pMessage->GetReflection()->GetRepeatedDouble(*p_pMessage, p_pField, i);
+		float64_t fValue = pReflection->GetRepeatedDouble(*p_pMessage, pField, i);
 
-		lua_pushnumber(p_pLuaState, i + 1);
 		lua_pushnumber(p_pLuaState, fValue);
 
-		lua_rawset(p_pLuaState, -3);
+		lua_rawseti(p_pLuaState, -2, i + 1);
 	}
 
 	lua_rawset(p_pLuaState, -3);
@@ -1707,27 +6336,29 @@ bool ProtocolGenerator::_ParseRepeatedFloat64Value(google::protobuf::Message * p
 	return true;
 }
 
-bool ProtocolGenerator::_ParseRepeatedBoolValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState)
+bool ProtocolGenerator::_ParseRepeatedBoolValue(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
 {
-	int32_t nCount = p_pMessage->GetReflection()->FieldSize(*p_pMessage, p_pField);
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
+	const google::protobuf::Reflection * pReflection = p_pMessage->GetReflection();
+
+	int32_t nCount = pReflection->FieldSize(*p_pMessage, pField);
 
 	if (nCount <= 0)
 	{
 		return true;
 	}
 
-	lua_pushstring(p_pLuaState, p_pField->name().c_str());
+	this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
 
-	lua_newtable(p_pLuaState);
+	lua_createtable(p_pLuaState, nCount, 0);
 
 	for (int32_t i = 0; i < nCount; ++i)
 	{
-		bool bValue = p_pMessage->GetReflection()->GetRepeatedBool(*p_pMessage, p_pField, i);
+		bool bValue = pReflection->GetRepeatedBool(*p_pMessage, pField, i);
 
-		lua_pushnumber(p_pLuaState, i + 1);
 		lua_pushboolean(p_pLuaState, bValue);
 
-		lua_rawset(p_pLuaState, -3);
+		lua_rawseti(p_pLuaState, -2, i + 1);
 	}
 
 	lua_rawset(p_pLuaState, -3);
@@ -1735,27 +6366,31 @@ bool ProtocolGenerator::_ParseRepeatedBoolValue(google::protobuf::Message * p_pM
 	return true;
 }
 
-bool ProtocolGenerator::_ParseRepeatedStringValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState)
+bool ProtocolGenerator::_ParseRepeatedStringValue(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
 {
-	int32_t nCount = p_pMessage->GetReflection()->FieldSize(*p_pMessage, p_pField);
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
+	const google::protobuf::Reflection * pReflection = p_pMessage->GetReflection();
+
+	int32_t nCount = pReflection->FieldSize(*p_pMessage, pField);
 
 	if (nCount <= 0)
 	{
 		return true;
 	}
 
-	lua_pushstring(p_pLuaState, p_pField->name().c_str());
+	this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
+
+	lua_createtable(p_pLuaState, nCount, 0);
 
-	lua_newtable(p_pLuaState);
+	std::string strScratch;
 
 	for (int32_t i = 0; i < nCount; ++i)
 	{
-		std::string strValue = p_pMessage->GetReflection()->GetRepeatedString(*p_pMessage, p_pField, i);
+		const std::string & strValue = pReflection->GetRepeatedStringReference(*p_pMessage, pField, i, &strScratch);
 
-		lua_pushnumber(p_pLuaState, i + 1);
-		lua_pushstring(p_pLuaState, strValue.c_str());
+		lua_pushlstring(p_pLuaState, strValue.data(), strValue.size());
 
-		lua_rawset(p_pLuaState, -3);
+		lua_rawseti(p_pLuaState, -2, i + 1);
 	}
 
 	lua_rawset(p_pLuaState, -3);
@@ -1763,9 +6398,12 @@ bool ProtocolGenerator::_ParseRepeatedStringValue(google::protobuf::Message * p_
 	return true;
 }
 
-bool ProtocolGenerator::_ParseRepeatedEnumValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState)
+bool ProtocolGenerator::_ParseRepeatedEnumValue(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
 {
-	int32_t nCount = p_pMessage->GetReflection()->FieldSize(*p_pMessage, p_pField);
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
+	const google::protobuf::Reflection * pReflection = p_pMessage->GetReflection();
+
+	int32_t nCount = pReflection->FieldSize(*p_pMessage, pField);
 
 	if (nCount <= 0)
 	{
@@ -1774,22 +6412,21 @@ bool ProtocolGenerator::_ParseRepeatedEnumValue(google::protobuf::Message * p_pM
 
 	bool bSuccess = true;
 
-	lua_pushstring(p_pLuaState, p_pField->name().c_str());
+	this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
 
-	lua_newtable(p_pLuaState);
+	lua_createtable(p_pLuaState, nCount, 0);
 
 	for (int32_t i = 0; i < nCount; ++i)
 	{
 		bSuccess = false;
 
-		const google::protobuf::EnumValueDescriptor * pEnumValueDescriptor = p_pMessage->GetReflection()->GetRepeatedEnum(*p_pMessage, p_pField, i);
+		const google::protobuf::EnumValueDescriptor * pEnumValueDescriptor = pReflection->GetRepeatedEnum(*p_pMessage, pField, i);
 
 		CC_BREAK_IF(nullptr == pEnumValueDescriptor);
 
-		lua_pushnumber(p_pLuaState, i + 1);
 		lua_pushnumber(p_pLuaState, pEnumValueDescriptor->number());
 
-		lua_rawset(p_pLuaState, -3);
+		lua_rawseti(p_pLuaState, -2, i + 1);
 
 		bSuccess = true;
 	}
@@ -1799,9 +6436,11 @@ bool ProtocolGenerator::_ParseRepeatedEnumValue(google::protobuf::Message * p_pM
 	return bSuccess;
 }
 
-bool ProtocolGenerator::_ParseRepeatedMessageValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState)
+bool ProtocolGenerator::_ParseRepeatedMessageValue(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState)
 {
-	int32_t nCount = p_pMessage->GetReflection()->FieldSize(*p_pMessage, p_pField);
+	const google::protobuf::FieldDescriptor * pField = p_pFieldPlan->pField;
+
+	int32_t nCount = p_pMessage->GetReflection()->FieldSize(*p_pMessage, pField);
 
 	if (nCount <= 0)
 	{
@@ -1810,25 +6449,23 @@ bool ProtocolGenerator::_ParseRepeatedMessageValue(google::protobuf::Message * p
 
 	bool bSuccess = true;
 
-	lua_pushstring(p_pLuaState, p_pField->name().c_str());
+	this->_PushLuaFieldName(p_pLuaState, p_pFieldPlan);
 
-	lua_newtable(p_pLuaState);
+	lua_createtable(p_pLuaState, nCount, 0);
 
 	for (int32_t i = 0; i < nCount; ++i)
 	{
 		bSuccess = false;
 
-		const google::protobuf::Message & cSubMessage = p_pMessage->GetReflection()->GetRepeatedMessage(*p_pMessage, p_pField, i);
+		const google::protobuf::Message & cSubMessage = p_pMessage->GetReflection()->GetRepeatedMessage(*p_pMessage, pField, i);
 
 		google::protobuf::Message * pSubMessage = const_cast<google::protobuf::Message *>(&cSubMessage);
 
-		lua_pushnumber(p_pLuaState, i + 1);
-
-		lua_newtable(p_pLuaState);
+		lua_createtable(p_pLuaState, 0, static_cast<int32_t>(p_pFieldPlan->pChildPlan->vecFields.size()));
 
-		bSuccess = this->ParseMessage(pSubMessage, p_pLuaState);
+		bSuccess = this->_ParseMessageDatas(pSubMessage, p_pFieldPlan->pChildPlan, p_pLuaState);
 
-		lua_rawset(p_pLuaState, -3);
+		lua_rawseti(p_pLuaState, -2, i + 1);
 
 		CC_BREAK_IF(!bSuccess);
 	}
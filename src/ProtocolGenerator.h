@@ -17,13 +17,20 @@
 
 #include "CCLuaValue.h"
 
+#include <google/protobuf/arena.h>
 #include <google/protobuf/descriptor.h>
 #include <google/protobuf/descriptor.pb.h>
 #include <google/protobuf/dynamic_message.h>
 #include <google/protobuf/compiler/importer.h>
+#include <google/protobuf/io/coded_stream.h>
 
 #include <vector>
 #include <string>
+#include <memory>
+#include <map>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
 
 #include <stdint.h>
 
@@ -32,8 +39,16 @@ typedef double float64_t;
 
 NS_PROTOCOL_GENERATOR_BEGIN
 
+class ProtocolFrameDecoder;
+class ProtocolMessageQueue;
+class ProtocolDeltaCodec;
+
 class ProtocolGenerator
 {
+	friend class ProtocolFrameDecoder;
+	friend class ProtocolMessageQueue;
+	friend class ProtocolDeltaCodec;
+
 public:
 	enum class PROTOCOL_DATA_TYPE
 	{
@@ -41,6 +56,33 @@ public:
 		PROTOCOL_DATA_MULTI,
 	};
 
+public:
+	enum class FRAME_FIELD_TYPE
+	{
+		FRAME_FIELD_VARINT,
+		FRAME_FIELD_FIXED16,
+		FRAME_FIELD_FIXED32,
+	};
+
+public:
+	// 网络帧的格式：[长度][消息号][消息数据]，长度为其后消息号和消息数据的总字节数
+
+	typedef struct _FrameFormat
+	{
+	public:
+		_FrameFormat();
+
+	public:
+		ProtocolGenerator::FRAME_FIELD_TYPE eLengthType;
+		ProtocolGenerator::FRAME_FIELD_TYPE eIdType;
+
+	public:
+		bool bBigEndian; // fixed类型的字节序，默认为网络字节序
+
+	public:
+		uint32_t uMaxFrameSize; // 超过这个长度认为数据已经错乱
+	} FrameFormat;
+
 public:
 	typedef struct _ProtocolData
 	{
@@ -61,9 +103,335 @@ public:
 		std::vector<ProtocolGenerator::_ProtocolData> vecValues;
 	} ProtocolData;
 
+public:
+	typedef struct _ArenaStatistics
+	{
+	public:
+		_ArenaStatistics();
+
+	public:
+		void Clean();
+
+	public:
+		uint64_t uSpaceAllocated;     // arena当前申请的内存块总大小
+		uint64_t uSpaceUsed;          // 其中已经分配给消息使用的大小
+		uint64_t uPeakSpaceAllocated; // 历次Reset之前申请内存块的最大值
+
+	public:
+		uint32_t uMessageCount; // 上次Reset之后在arena上创建的消息数量
+		uint32_t uResetCount;   // Reset的次数
+	} ArenaStatistics;
+
+public:
+	typedef struct _MessagePoolStatistics
+	{
+	public:
+		_MessagePoolStatistics();
+
+	public:
+		void Clean();
+
+	public:
+		uint32_t uPooledCount;   // 池中当前空闲的消息数量
+		uint32_t uHitCount;      // 从池中取到消息的次数
+		uint32_t uMissCount;     // 池为空，重新创建消息的次数
+		uint32_t uOverflowCount; // 回收时超过上限，直接释放的次数
+	} MessagePoolStatistics;
+
+public:
+	// MessagePtr析构时把消息交还给创建它的ProtocolGenerator，必须在ProtocolGenerator销毁之前释放
+
+	typedef struct _MessageRecycler
+	{
+	public:
+		_MessageRecycler();
+		explicit _MessageRecycler(ProtocolGenerator * p_pGenerator);
+
+	public:
+		void operator()(google::protobuf::Message * p_pMessage) const;
+
+	public:
+		ProtocolGenerator * pGenerator;
+	} MessageRecycler;
+
+	typedef std::unique_ptr<google::protobuf::Message, ProtocolGenerator::MessageRecycler> MessagePtr;
+
+public:
+	// 调用过程中会修改的状态：arena、消息池、Lua字段名缓存的栈索引和稀疏解码标记，消息类型、消息号等其他数据初始化之后只读
+	// 在线程中构造一个绑定到ProtocolGenerator的Context之后，这个线程的调用都使用它自己的状态，多个线程可以共用一个ProtocolGenerator而不需要加锁
+	// 第一个Context绑定之后不再生成新的MessagePlan，外部传入的消息类型（生成代码的消息）需要在这之前在默认Context中用过一次
+	// 没有绑定Context的线程使用ProtocolGenerator自带的默认Context，只能有一个这样的线程；Context必须在同一个线程中构造和析构，并且早于ProtocolGenerator销毁
+
+	typedef struct _Context
+	{
+	public:
+		_Context();
+		explicit _Context(ProtocolGenerator * p_pGenerator);
+
+	public:
+		~_Context();
+
+	public:
+		void Clean(); // 释放池中的空闲消息和CreateArena创建的arena
+
+	public:
+		ProtocolGenerator * pGenerator;       // 绑定的ProtocolGenerator，默认Context为空
+		ProtocolGenerator::_Context * pNext; // 当前线程绑定的下一个Context
+
+	public:
+		google::protobuf::Arena * pArena;      // 当前使用的arena，为空时在堆上创建消息
+		google::protobuf::Arena * pOwnedArena; // CreateArena创建的arena，由Context负责释放
+
+	public:
+		ProtocolGenerator::ArenaStatistics cArenaStatistics;
+
+	public:
+		std::unordered_map<const google::protobuf::Descriptor *, std::vector<google::protobuf::Message *> > mapMessagePools; // 已经Clear的空闲消息
+
+	public:
+		uint32_t uMessagePoolLimit;
+		ProtocolGenerator::MessagePoolStatistics cMessagePoolStatistics;
+
+	public:
+		int32_t nLuaNameCacheIndex; // 当前调用中缓存table在栈上的绝对索引，0表示没有缓存
+
+	public:
+		int32_t nLuaTablePoolIndex; // ParseMessageInto中空闲table池在栈上的绝对索引，0表示没有
+		int32_t nLuaTablePoolSize;  // 池中空闲table的数量
+
+	public:
+		bool bSparseDecode; // 当前ParseMessage调用是否为稀疏解码
+		bool bMergeDecode;  // 当前调用是否为MergeMessage的合并解码
+
+	private:
+		_Context(const ProtocolGenerator::_Context &) = delete;
+		ProtocolGenerator::_Context & operator=(const ProtocolGenerator::_Context &) = delete;
+	} Context;
+
+public:
+	struct _FieldPlan;
+	struct _MessagePlan;
+
+public:
+	typedef bool (ProtocolGenerator::*FillValueHandler)(google::protobuf::Message *, const google::protobuf::FieldDescriptor *, const google::protobuf::Reflection *, const ProtocolGenerator::ProtocolData *, bool);
+	typedef bool (ProtocolGenerator::*FillRepeatedHandler)(google::protobuf::Message *, const google::protobuf::FieldDescriptor *, const google::protobuf::Reflection *, const ProtocolGenerator::ProtocolData *);
+	typedef bool (ProtocolGenerator::*FillLuaValueHandler)(google::protobuf::Message *, const google::protobuf::FieldDescriptor *, const google::protobuf::Reflection *, lua_State *, int32_t, bool);
+	typedef bool (ProtocolGenerator::*ParseHandler)(google::protobuf::Message *, const ProtocolGenerator::_FieldPlan *, lua_State *);
+
+public:
+	// 每个字段的转换方式在生成MessagePlan时确定，转换时不再逐个判断cpp_type()
+
+	typedef struct _FieldPlan
+	{
+	public:
+		_FieldPlan();
+
+	public:
+		const google::protobuf::FieldDescriptor * pField;
+		const google::protobuf::OneofDescriptor * pOneof; // 仅真正的oneof成员有效，proto3的optional不算
+
+	public:
+		const ProtocolGenerator::_MessagePlan * pContainingPlan;
+
+	public:
+		int32_t nLuaNameIndex; // 字段名在Lua字段名缓存中的下标，同名的字段共用一个下标
+
+	public:
+		google::protobuf::FieldDescriptor::Type eType;
+
+	public:
+		ProtocolGenerator::FillValueHandler pFillValueHandler;
+		ProtocolGenerator::FillRepeatedHandler pFillRepeatedHandler;
+		ProtocolGenerator::FillLuaValueHandler pFillLuaValueHandler;
+		ProtocolGenerator::ParseHandler pParseHandler;
+
+	public:
+		bool bRequired;
+		bool bRepeated;
+		bool bHasPresence;
+		bool bClosedEnum;  // proto2的enum字段，未定义的枚举值在解码时丢弃
+
+	public:
+		bool bMergeReplace; // MergeMessage时用新的数组替换原来的，而不是追加，由SetMergeReplace设置
+
+	public:
+		uint32_t uTag;       // 编码时使用的tag，packed字段为单个元素的tag
+		uint32_t uPackedTag; // packed字段整体的tag，非packed字段为0
+
+	public:
+		const ProtocolGenerator::_MessagePlan * pChildPlan; // 仅message类型的字段有效
+	} FieldPlan;
+
+	typedef struct _MessagePlan
+	{
+	public:
+		_MessagePlan();
+
+	public:
+		const ProtocolGenerator::_FieldPlan * FindFieldPlan(int32_t p_nNumber) const;
+		int32_t FindFieldIndex(const std::string & p_strName) const;
+
+	public:
+		const google::protobuf::Descriptor * pDescriptor;
+		const google::protobuf::Message * pPrototype;
+
+	public:
+		std::vector<ProtocolGenerator::FieldPlan> vecFields;
+		std::vector<const ProtocolGenerator::FieldPlan *> vecWireFields;   // 按字段编号排序，和SerializeToArray的输出顺序一致
+		std::vector<const ProtocolGenerator::FieldPlan *> vecNumberFields; // 按字段编号直接索引，字段编号稀疏时为空，改用vecWireFields二分查找
+
+	public:
+		std::unordered_map<std::string, int32_t> mapNameIndexes; // 字段名 => vecFields中的下标
+
+	public:
+		bool bSparse; // 该类型解码时只输出实际出现的字段，由SetSparseDecode设置
+
+	public:
+		bool bMessageId;     // 是否注册了消息号
+		uint32_t uMessageId; // 编码帧头时使用的消息号，每个类型只有一个消息号
+	} MessagePlan;
+
+public:
+	enum class DECODED_VALUE_TYPE
+	{
+		DECODED_VALUE_NIL,           // proto2中未定义的枚举值，只用来清掉oneof中的其他字段
+		DECODED_VALUE_NUMBER,
+		DECODED_VALUE_INT64,
+		DECODED_VALUE_UINT64,
+		DECODED_VALUE_BOOL,
+		DECODED_VALUE_STRING,
+		DECODED_VALUE_MESSAGE_BEGIN, // 之后直到对应的MESSAGE_END都是子消息的字段
+		DECODED_VALUE_MESSAGE_END,
+	};
+
+public:
+	typedef struct _DecodedValue
+	{
+	public:
+		_DecodedValue();
+
+	public:
+		const ProtocolGenerator::_FieldPlan * pFieldPlan;
+
+	public:
+		ProtocolGenerator::DECODED_VALUE_TYPE eValueType;
+
+	public:
+		union
+		{
+			double fNumber;
+			int64_t nInt64;
+			uint64_t uUInt64;
+			bool bBoolean;
+
+			struct
+			{
+				uint32_t uOffset; // 在DecodedMessage::strBuffer中的位置
+				uint32_t uSize;
+			} cString;
+		};
+	} DecodedValue;
+
+public:
+	// DecodeMessage在任意线程把数据解码成和Lua无关的中间结果，主线程只需要PushDecodedMessage生成table
+	// 字段按数据中出现的顺序平铺在vecValues中，子消息用MESSAGE_BEGIN/MESSAGE_END包围；字符串引用strBuffer中保存的数据拷贝
+
+	typedef struct _DecodedMessage
+	{
+	public:
+		_DecodedMessage();
+
+	public:
+		void Clean(); // 保留已经申请的内存，同一个对象可以反复用来解码
+
+	public:
+		const ProtocolGenerator::_MessagePlan * pMessagePlan;
+
+	public:
+		bool bSparse;
+
+	public:
+		std::string strBuffer;
+		std::vector<ProtocolGenerator::DecodedValue> vecValues;
+	} DecodedMessage;
+
+private:
+	typedef struct _WireValue
+	{
+	public:
+		_WireValue();
+
+	public:
+		uint64_t uValue; // varint、fixed32、fixed64类型编码之后的值
+
+	public:
+		const char * pszData; // string、bytes类型的数据
+		size_t uLength;
+	} WireValue;
+
+	typedef struct _WireEncodeContext
+	{
+	public:
+		_WireEncodeContext();
+
+	public:
+		void WriteVarint(uint64_t p_uValue);
+		void WriteFixed32(uint32_t p_uValue);
+		void WriteFixed64(uint64_t p_uValue);
+		void WriteBytes(const char * p_pszData, size_t p_uLength);
+		void WriteValue(uint32_t p_uWireType, const ProtocolGenerator::_WireValue & p_cValue);
+
+	public:
+		size_t BeginLength();
+		void EndLength(size_t p_uLengthIndex, size_t p_uStartSize);
+
+	public:
+		void Reset(); // 编码下一个消息前调用，保留vecLengths已经申请的内存
+
+	public:
+		bool bSizing; // 第一遍只计算长度，第二遍写入数据
+
+	public:
+		size_t uSize;
+		uint8_t * pCursor;
+
+	public:
+		std::vector<uint32_t> vecLengths; // 嵌套消息和packed字段的长度，按遍历顺序记录
+		size_t uLengthIndex;
+	} WireEncodeContext;
+
+	typedef struct _MessageView
+	{
+	public:
+		_MessageView();
+
+	public:
+		ProtocolGenerator * pGenerator;
+
+	public:
+		const ProtocolGenerator::_MessagePlan * pMessagePlan; // 消息视图的类型，repeated视图为元素的类型
+		const ProtocolGenerator::_FieldPlan * pFieldPlan;     // 仅repeated视图有效
+
+	public:
+		std::shared_ptr<const std::string> pBuffer; // 收到的数据，嵌套的视图共用同一份
+		const char * pData;                         // 消息视图对应的数据
+		int32_t nSize;
+
+	public:
+		std::vector<std::pair<const char *, int32_t> > vecElements; // repeated视图中每个元素的数据
+
+	public:
+		bool bCache;
+		int32_t nCacheRef; // 已解码字段的缓存table在registry中的引用
+	} MessageView;
+
 public:
 	static ProtocolGenerator * Create(const std::string & p_strProtocolFileName);
 
+public:
+	static ProtocolGenerator * CreateFromDescriptorSet(const std::string & p_strDescriptorSetFileName);
+	static ProtocolGenerator * CreateFromDescriptorSet(const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize);
+
 public:
 	ProtocolGenerator();
 
@@ -74,17 +442,144 @@ public:
 	bool Initialize(const std::string & p_strProtocolFileName);
 
 public:
-	bool ParseMessage(const char * p_pszMessageName, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState);
-	bool ParseMessage(google::protobuf::Message * p_pMessage, lua_State * p_pLuaState);
+	bool InitializeFromDescriptorSet(const std::string & p_strDescriptorSetFileName);
+	bool InitializeFromDescriptorSet(const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize);
+
+public:
+	const google::protobuf::DescriptorPool * GetDescriptorPool() const;
+
+public:
+	// p_bSparse为true时只输出实际出现的字段，没有出现的字段在Lua中为nil，不再填充默认值和空的子消息table
+
+	bool ParseMessage(const char * p_pszMessageName, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, bool p_bSparse = false);
+	bool ParseMessage(uint32_t p_uMessageId, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, bool p_bSparse = false);
+	bool ParseMessage(google::protobuf::Message * p_pMessage, lua_State * p_pLuaState, bool p_bSparse = false);
+
+public:
+	// 解码到p_nIndex处已有的table中，不压入新的table，结果和ParseMessage相同：出现的字段直接覆盖，其他的键全部清除
+	// 子消息、repeated字段和repeated消息元素原来的table清空之后重复使用，减少Lua的GC；这些table不能同时被其他地方引用，解码失败时table的内容不确定
+
+	bool ParseMessageInto(const char * p_pszMessageName, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bSparse = false);
+	bool ParseMessageInto(uint32_t p_uMessageId, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bSparse = false);
+
+public:
+	// 按protobuf的合并规则把数据直接解码到p_nIndex处已有的table中，不创建中间table：出现的标量覆盖，子消息递归合并，repeated字段追加到原来的数组
+	// 相当于对原来的数据和新数据拼接之后ParseMessage，只是不检查required字段；p_bSparse为false时table中为nil的字段同样填充默认值
+
+	bool MergeMessage(const char * p_pszMessageName, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bSparse = false);
+	bool MergeMessage(uint32_t p_uMessageId, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bSparse = false);
+
+public:
+	// 一次解码缓冲区中所有完整的帧，p_nHandlerIndex为0时压入{ {消息号, table}, ... }数组，否则对每一帧调用handler(消息号, table)
+	// 返回处理掉的字节数，末尾不完整的帧留给下次调用；数据错乱时返回-1，此时栈和调用前一样，不压入结果数组
+
+	int32_t ParseFrames(const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, int32_t p_nHandlerIndex = 0);
+
+public:
+	// 消息号 => 消息类型保存在按消息号直接索引的数组中，按消息号编码和解码时不再查找类型名
+	// 每个类型只有一个消息号：类型再次注册时旧的消息号失效，消息号改给其他类型时原来的类型不再有消息号
+
+	bool RegisterMessageId(uint32_t p_uMessageId, const char * p_pszMessageName);
+
+	// 从自定义的消息选项中读取消息号，例如 extend google.protobuf.MessageOptions { optional uint32 msg_id = 50001; }
+	// p_pszOptionName为选项的全名（如"test.msg_id"），返回注册的消息类型数量，选项不存在时返回-1
+	// 消息号已经被其他类型使用时跳过并输出错误，不计入数量；选项中的消息号重复时按类型全名排序，先注册的保留
+
+	int32_t RegisterMessageIds(const char * p_pszOptionName);
+
+public:
+	void SetFrameFormat(const ProtocolGenerator::FrameFormat & p_cFrameFormat);
+	const ProtocolGenerator::FrameFormat & GetFrameFormat() const;
+
+public:
+	bool SetSparseDecode(const char * p_pszMessageName, bool p_bSparse); // 按类型设置，对嵌套在其他消息中的同类型消息同样有效
+
+	// 设置之后MergeMessage遇到这个repeated字段时先清空原来的数组，数组只保留这次数据中的元素；没有出现时保持原样
+	// 和SetSparseDecode一样修改的是类型的MessagePlan，需要在开始解码之前设置
+
+	bool SetMergeReplace(const char * p_pszMessageName, const char * p_pszFieldName, bool p_bReplace);
 
 public:
 	google::protobuf::Message * GenerateMessage(const char * p_pszMessageName, lua_State * p_pLuaState, int32_t p_nIndex);
+	google::protobuf::Message * GenerateMessage(uint32_t p_uMessageId, lua_State * p_pLuaState, int32_t p_nIndex);
 	google::protobuf::Message * GenerateMessage(const char * p_pszMessageName, const std::vector<ProtocolGenerator::ProtocolData> & p_vecValues);
 	google::protobuf::Message * GenerateMessage(const char * p_pszMessageName, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize);
 
+public:
+	bool EncodeMessage(const char * p_pszMessageName, lua_State * p_pLuaState, int32_t p_nIndex, std::string & p_strBuffer);
+	bool EncodeMessage(uint32_t p_uMessageId, lua_State * p_pLuaState, int32_t p_nIndex, std::string & p_strBuffer);
+
+public:
+	// p_nIndex处为{ {消息名或消息号, table}, ... }数组，按帧格式依次追加到p_strBuffer的末尾，可以一次写入socket
+	// 返回编码成功的帧数，编码失败的消息会被跳过，参数错误时返回-1
+
+	int32_t EncodeFrames(lua_State * p_pLuaState, int32_t p_nIndex, std::string & p_strBuffer);
+
+public:
+	// 两阶段解码：DecodeMessage不访问lua_State和ProtocolGenerator的可变状态，可以在网络线程或工作线程中调用
+	// PushDecodedMessage在Lua所在的线程把中间结果转换成table压入栈顶，结果和ParseMessage相同
+	// RegisterMessageId、SetSparseDecode需要在其他线程开始调用DecodeMessage之前完成；第一次调用DecodeMessage之后不再生成新的MessagePlan
+
+	bool DecodeMessage(const char * p_pszMessageName, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, ProtocolGenerator::DecodedMessage & p_cDecodedMessage, bool p_bSparse = false) const;
+	bool DecodeMessage(uint32_t p_uMessageId, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, ProtocolGenerator::DecodedMessage & p_cDecodedMessage, bool p_bSparse = false) const;
+	bool PushDecodedMessage(const ProtocolGenerator::DecodedMessage & p_cDecodedMessage, lua_State * p_pLuaState);
+
+public:
+	// 压入一个userdata视图，只在访问字段时才从数据中解码，嵌套消息和repeated消息字段同样返回视图
+	// p_bCache为true时解码过的字段缓存在视图中；视图不检查required字段，使用期间ProtocolGenerator不能销毁
+	// 遍历使用view:pairs()，Lua 5.1模式的LuaJIT不会对userdata调用__pairs
+
+	bool ParseMessageView(const char * p_pszMessageName, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, bool p_bCache = true);
+
+public:
+	// 设置arena之后，GenerateMessage返回的消息都在arena上分配，不能再delete，统一通过DestroyMessage释放
+	// 这些消息在ResetArena之后全部失效，适合每帧或每批消息Reset一次；arena和下面的消息池都属于当前线程的Context
+
+	bool CreateArena(size_t p_uStartBlockSize = 0, size_t p_uMaxBlockSize = 0);
+	void SetArena(google::protobuf::Arena * p_pArena);
+	google::protobuf::Arena * GetArena() const;
+
+public:
+	uint64_t ResetArena();
+	ProtocolGenerator::ArenaStatistics GetArenaStatistics() const;
+
+public:
+	static void DestroyMessage(google::protobuf::Message * p_pMessage);
+
+public:
+	// 同一类型的消息回收之后Clear再复用，保留repeated字段和字符串已经申请的内存
+	// 每个类型最多保留p_uLimit个空闲消息，为0时不再回收
+
+	ProtocolGenerator::MessagePtr AcquireMessage(const char * p_pszMessageName);
+	ProtocolGenerator::MessagePtr GeneratePooledMessage(const char * p_pszMessageName, lua_State * p_pLuaState, int32_t p_nIndex);
+	void RecycleMessage(google::protobuf::Message * p_pMessage);
+
+public:
+	void SetMessagePoolLimit(uint32_t p_uLimit);
+	void PurgeMessagePool();
+	ProtocolGenerator::MessagePoolStatistics GetMessagePoolStatistics() const;
+
+private:
+	google::protobuf::Message * _NewMessage(const ProtocolGenerator::MessagePlan * p_pMessagePlan);
+
+private:
+	ProtocolGenerator::Context * _GetContext();
+	const ProtocolGenerator::Context * _GetContext() const;
+
+private:
+	bool _BuildDescriptorFile(const google::protobuf::FileDescriptorSet & p_cDescriptorSet, const std::map<std::string, int32_t> & p_mapFileIndexes, int32_t p_nFileIndex);
+
+private:
+	const ProtocolGenerator::MessagePlan * _GetMessagePlan(const google::protobuf::Descriptor * p_pDescriptor);
+	const ProtocolGenerator::MessagePlan * _BuildMessagePlan(const google::protobuf::Descriptor * p_pDescriptor);
+	void _BuildFieldPlan(ProtocolGenerator::FieldPlan & p_cFieldPlan, const google::protobuf::FieldDescriptor * p_pField);
+	void _BuildFileMessagePlans(const google::protobuf::FileDescriptor * p_pFileDescriptor);
+	void _BuildNestedMessagePlans(const google::protobuf::Descriptor * p_pDescriptor);
+	void _FreezeMessagePlans() const;
+
 private:
-	bool _FillMessageDatas(google::protobuf::Message * p_pMessage, const google::protobuf::Descriptor * p_pDescriptor, const std::vector<ProtocolGenerator::ProtocolData> & p_vecValues);
-	bool _FillMessageFileValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData);
+	bool _FillMessageDatas(google::protobuf::Message * p_pMessage, const ProtocolGenerator::MessagePlan * p_pMessagePlan, const std::vector<ProtocolGenerator::ProtocolData> & p_vecValues);
+	bool _FillMessageFileValue(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData);
 
 private:
 	bool _FillInt32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated);
@@ -96,7 +591,7 @@ private:
 	bool _FillBoolValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated);
 	bool _FillStringValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated);
 	bool _FillEnumValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated);
-	bool _FillMessageValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, bool p_bRepeated);
+	bool _FillMessageValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, const ProtocolGenerator::MessagePlan * p_pChildPlan);
 
 private:
 	bool _FillRepeatedInt32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData);
@@ -108,45 +603,178 @@ private:
 	bool _FillRepeatedBoolValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData);
 	bool _FillRepeatedStringValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData);
 	bool _FillRepeatedEnumValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData);
-	bool _FillRepeatedMessageValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData);
+	bool _FillRepeatedMessageValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, const ProtocolGenerator::ProtocolData * p_pProtocolData, const ProtocolGenerator::MessagePlan * p_pChildPlan);
+
+private:
+	bool _FillMessageLuaDatas(google::protobuf::Message * p_pMessage, const ProtocolGenerator::MessagePlan * p_pMessagePlan, lua_State * p_pLuaState, int32_t p_nIndex);
+	bool _FillMessageLuaFieldValue(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex);
+	bool _FillLuaFieldValue(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bRepeated);
+
+private:
+	bool _FillInt32LuaValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bRepeated);
+	bool _FillInt64LuaValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bRepeated);
+	bool _FillUInt32LuaValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bRepeated);
+	bool _FillUInt64LuaValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bRepeated);
+	bool _FillFloat32LuaValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bRepeated);
+	bool _FillFloat64LuaValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bRepeated);
+	bool _FillBoolLuaValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bRepeated);
+	bool _FillStringLuaValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bRepeated);
+	bool _FillEnumLuaValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bRepeated);
+	bool _FillMessageLuaValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, const google::protobuf::Reflection * p_pReflection, lua_State * p_pLuaState, int32_t p_nIndex, const ProtocolGenerator::MessagePlan * p_pChildPlan);
+
+private:
+	bool _EncodeMessageLuaDatas(ProtocolGenerator::WireEncodeContext & p_cContext, const ProtocolGenerator::MessagePlan * p_pMessagePlan, lua_State * p_pLuaState, int32_t p_nIndex);
+	bool _EncodeLuaFieldValue(ProtocolGenerator::WireEncodeContext & p_cContext, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState, int32_t p_nTableIndex, int32_t p_nIndex);
+	bool _EncodeLuaRepeatedValue(ProtocolGenerator::WireEncodeContext & p_cContext, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState, int32_t p_nIndex);
+	bool _EncodeLuaMessageValue(ProtocolGenerator::WireEncodeContext & p_cContext, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState, int32_t p_nIndex);
+
+private:
+	bool _GetLuaWireValue(const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState, int32_t p_nIndex, ProtocolGenerator::WireValue & p_cValue);
+	bool _GetDefaultWireValue(const ProtocolGenerator::FieldPlan * p_pFieldPlan, ProtocolGenerator::WireValue & p_cValue);
+	bool _IsLuaOneofOverridden(const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState, int32_t p_nTableIndex);
+
+private:
+	bool _RegisterMessageId(uint32_t p_uMessageId, const google::protobuf::Descriptor * p_pDescriptor);
+	const ProtocolGenerator::MessagePlan * _FindMessagePlan(uint32_t p_uMessageId) const;
+
+private:
+	bool _ParseMessage(const ProtocolGenerator::MessagePlan * p_pMessagePlan, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, bool p_bSparse);
+	bool _ParseMessageInto(const ProtocolGenerator::MessagePlan * p_pMessagePlan, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bSparse);
+	bool _MergeMessage(const ProtocolGenerator::MessagePlan * p_pMessagePlan, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState, int32_t p_nIndex, bool p_bSparse);
+	google::protobuf::Message * _GenerateMessage(const ProtocolGenerator::MessagePlan * p_pMessagePlan, lua_State * p_pLuaState, int32_t p_nIndex);
+	bool _EncodeMessage(const ProtocolGenerator::MessagePlan * p_pMessagePlan, lua_State * p_pLuaState, int32_t p_nIndex, std::string & p_strBuffer);
+
+private:
+	bool _DecodeMessage(const ProtocolGenerator::MessagePlan * p_pMessagePlan, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, lua_State * p_pLuaState);
+	bool _DecodeMessage(const ProtocolGenerator::MessagePlan * p_pMessagePlan, google::protobuf::io::CodedInputStream & p_cInput, const int32_t p_nDataSize, lua_State * p_pLuaState);
+	bool _DispatchFrame(uint32_t p_uMessageId, google::protobuf::io::CodedInputStream & p_cInput, const int32_t p_nBodySize, lua_State * p_pLuaState, int32_t p_nHandlerIndex, int32_t p_nResultIndex, int32_t & p_nCount);
+	void _DeliverFrame(uint32_t p_uMessageId, lua_State * p_pLuaState, int32_t p_nHandlerIndex, int32_t p_nResultIndex, int32_t & p_nCount);
+	int32_t _ReadFrameHeader(const unsigned char * p_pszDataBuffer, size_t p_uDataSize, uint32_t & p_uMessageId, uint32_t & p_uBodySize) const;
+
+private:
+	bool _EncodeMessage(ProtocolGenerator::WireEncodeContext & p_cContext, const ProtocolGenerator::MessagePlan * p_pMessagePlan, lua_State * p_pLuaState, int32_t p_nIndex, std::string & p_strBuffer, const uint32_t * p_pMessageId);
+
+private:
+	bool _DecodeMessageDatas(google::protobuf::io::CodedInputStream & p_cInput, const ProtocolGenerator::MessagePlan * p_pMessagePlan, lua_State * p_pLuaState, uint32_t p_uEndGroupTag);
+	bool _DecodeWireFieldValue(google::protobuf::io::CodedInputStream & p_cInput, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState, uint32_t p_uWireType);
+	bool _DecodeWireRepeatedValue(google::protobuf::io::CodedInputStream & p_cInput, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState, uint32_t p_uWireType);
+	bool _DecodeWireMessageValue(google::protobuf::io::CodedInputStream & p_cInput, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+	bool _DecodeWireValue(google::protobuf::io::CodedInputStream & p_cInput, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+
+private:
+	bool _DecodeMessage(const ProtocolGenerator::MessagePlan * p_pMessagePlan, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize, ProtocolGenerator::DecodedMessage & p_cDecodedMessage, bool p_bSparse) const;
+	bool _DecodeIntermediateDatas(google::protobuf::io::CodedInputStream & p_cInput, const ProtocolGenerator::MessagePlan * p_pMessagePlan, ProtocolGenerator::DecodedMessage & p_cDecodedMessage, uint32_t p_uEndGroupTag) const;
+	bool _DecodeIntermediateField(google::protobuf::io::CodedInputStream & p_cInput, const ProtocolGenerator::FieldPlan * p_pFieldPlan, ProtocolGenerator::DecodedMessage & p_cDecodedMessage, uint32_t p_uWireType) const;
+	bool _DecodeIntermediateValue(google::protobuf::io::CodedInputStream & p_cInput, const ProtocolGenerator::FieldPlan * p_pFieldPlan, ProtocolGenerator::DecodedMessage & p_cDecodedMessage) const;
+
+private:
+	bool _PushDecodedMessage(const ProtocolGenerator::DecodedMessage & p_cDecodedMessage, lua_State * p_pLuaState);
+	bool _PushDecodedDatas(const ProtocolGenerator::DecodedMessage & p_cDecodedMessage, size_t & p_uIndex, const ProtocolGenerator::MessagePlan * p_pMessagePlan, lua_State * p_pLuaState);
+	void _PushDecodedValue(const ProtocolGenerator::DecodedMessage & p_cDecodedMessage, const ProtocolGenerator::DecodedValue & p_cValue, lua_State * p_pLuaState);
+
+private:
+	void _ClearLuaOneofFields(const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+	void _ClearLuaFieldArray(const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+	void _PushLuaFieldTable(const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState, int32_t p_nArraySize, int32_t p_nHashSize);
+
+private:
+	void _NewLuaTable(lua_State * p_pLuaState, int32_t p_nArraySize, int32_t p_nHashSize);
+	void _RecycleLuaTable(const ProtocolGenerator::MessagePlan * p_pMessagePlan, lua_State * p_pLuaState, int32_t p_nIndex);
+
+private:
+	void _PushMessageView(lua_State * p_pLuaState, ProtocolGenerator::MessageView & p_cView);
+	bool _PushMessageViewField(const ProtocolGenerator::MessageView * p_pView, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+	void _PushMessageViewElement(const ProtocolGenerator::MessageView * p_pView, int32_t p_nElementIndex, lua_State * p_pLuaState);
+
+private:
+	static void _IndexMessageView(lua_State * p_pLuaState, int32_t p_nViewIndex, int32_t p_nKeyIndex);
+	static int _LuaMessageViewIndex(lua_State * p_pLuaState);
+	static int _LuaMessageViewLength(lua_State * p_pLuaState);
+	static int _LuaMessageViewPairs(lua_State * p_pLuaState);
+	static int _LuaMessageViewNext(lua_State * p_pLuaState);
+	static int _LuaMessageViewGC(lua_State * p_pLuaState);
+
+private:
+	bool _DecodeDefaultDatas(const ProtocolGenerator::MessagePlan * p_pMessagePlan, lua_State * p_pLuaState, bool p_bCheckRequired);
+	void _PushDefaultLuaValue(const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+
+private:
+	int32_t _BeginLuaNameCache(lua_State * p_pLuaState, int32_t p_nIndex);
+	void _EndLuaNameCache(lua_State * p_pLuaState, int32_t p_nPrevCacheIndex);
+	void _PushLuaFieldName(lua_State * p_pLuaState, const ProtocolGenerator::FieldPlan * p_pFieldPlan);
 
 private:
 	bool _AnalysisTableData(std::vector<ProtocolGenerator::ProtocolData> & p_vecTableValues, lua_State * p_pLuaState, int32_t p_nIndex);
 
 private:
-	bool _ParseFieldData(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState);
+	bool _ParseMessageDatas(google::protobuf::Message * p_pMessage, const ProtocolGenerator::MessagePlan * p_pMessagePlan, lua_State * p_pLuaState);
+	bool _ParseFieldData(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
 
 private:
-	bool _ParseInt32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState);
-	bool _ParseInt64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState);
-	bool _ParseUInt32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState);
-	bool _ParseUInt64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState);
-	bool _ParseFloat32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState);
-	bool _ParseFloat64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState);
-	bool _ParseBoolValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState);
-	bool _ParseStringValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState);
-	bool _ParseEnumValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState);
-	bool _ParseMessageValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState);
+	bool _ParseInt32Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+	bool _ParseInt64Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+	bool _ParseUInt32Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+	bool _ParseUInt64Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+	bool _ParseFloat32Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+	bool _ParseFloat64Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+	bool _ParseBoolValue(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+	bool _ParseStringValue(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+	bool _ParseEnumValue(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+	bool _ParseMessageValue(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
 
 private:
-	bool _ParseRepeatedInt32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState);
-	bool _ParseRepeatedInt64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState);
-	bool _ParseRepeatedUInt32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState);
-	bool _ParseRepeatedUInt64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState);
-	bool _ParseRepeatedFloat32Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState);
-	bool _ParseRepeatedFloat64Value(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState);
-	bool _ParseRepeatedBoolValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState);
-	bool _ParseRepeatedStringValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState);
-	bool _ParseRepeatedEnumValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState);
-	bool _ParseRepeatedMessageValue(google::protobuf::Message * p_pMessage, const google::protobuf::FieldDescriptor * p_pField, lua_State * p_pLuaState);
+	bool _ParseRepeatedInt32Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+	bool _ParseRepeatedInt64Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+	bool _ParseRepeatedUInt32Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+	bool _ParseRepeatedUInt64Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+	bool _ParseRepeatedFloat32Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+	bool _ParseRepeatedFloat64Value(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+	bool _ParseRepeatedBoolValue(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+	bool _ParseRepeatedStringValue(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+	bool _ParseRepeatedEnumValue(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
+	bool _ParseRepeatedMessageValue(google::protobuf::Message * p_pMessage, const ProtocolGenerator::FieldPlan * p_pFieldPlan, lua_State * p_pLuaState);
 
 private:
 	google::protobuf::compiler::Importer * m_pImporter;
 
+private:
+	google::protobuf::DescriptorPool * m_pDescriptorPool; // 使用FileDescriptorSet初始化时创建，与m_pImporter互斥
+
 private:
 	google::protobuf::DynamicMessageFactory m_cMessageFactory;
+
+private:
+	// arena和池中的消息引用了m_cMessageFactory中的类型信息，必须声明在它之后，先于它析构
+
+	ProtocolGenerator::Context m_cDefaultContext;
+
+private:
+	std::unordered_map<const google::protobuf::Descriptor *, ProtocolGenerator::MessagePlan *> m_mapMessagePlans;
+
+private:
+	// 绑定Context、创建ProtocolMessageQueue或者调用DecodeMessage之后冻结，不再生成新的MessagePlan
+	// 冻结之后m_mapMessagePlans和m_mapLuaNameIndexes只读，多个线程可以不加锁地查找；锁只用来等待冻结前正在进行的生成
+
+	mutable std::recursive_mutex m_cMessagePlanMutex;
+	mutable std::atomic<bool> m_bMessagePlansFrozen;
+
+private:
+	// Lua字段名缓存：每个lua_State的registry中保存一个数组table，按nLuaNameIndex存放已经创建好的字段名字符串
+
+	std::unordered_map<std::string, int32_t> m_mapLuaNameIndexes;
+
+private:
+	uint32_t m_uLuaNameCacheSerial; // 区分不同的ProtocolGenerator实例，避免地址被复用时取到旧的缓存
+
+private:
+	std::vector<const ProtocolGenerator::MessagePlan *> m_vecMessageIds; // 按消息号直接索引，没有注册的消息号为nullptr
+
+private:
+	ProtocolGenerator::FrameFormat m_cFrameFormat;
 };
 
+typedef std::shared_ptr<ProtocolGenerator> ProtocolGeneratorPtr;
+
 NS_PROTOCOL_GENERATOR_END
 
 #endif // !defined(__PROTOCOL_GENERATOR_H__)
@@ -0,0 +1,227 @@
+#include "ProtocolMessageQueue.h"
+
+#include "ccMacros.h"
+
+USING_NS_CC;
+
+NS_PROTOCOL_GENERATOR_BEGIN
+
+ProtocolMessageQueue::_Slot::_Slot()
+{
+	uMessageId = 0;
+}
+
+ProtocolMessageQueue::ProtocolMessageQueue(ProtocolGenerator * p_pGenerator, uint32_t p_uCapacity, bool p_bSparse)
+{
+	this->m_pGenerator = p_pGenerator;
+
+	// 网络线程中的DecodeMessage会查找MessagePlan，队列存在期间不能再生成新的MessagePlan
+
+	if (nullptr != p_pGenerator)
+	{
+		p_pGenerator->_FreezeMessagePlans();
+	}
+
+	// 容量取2的幂，槽位下标只需要和m_uMask按位与；索引一直递增，溢出回绕之后差值仍然正确
+
+	uint32_t uCapacity = 1;
+
+	while (uCapacity < p_uCapacity && uCapacity < 0x40000000)
+	{
+		uCapacity <<= 1;
+	}
+
+	this->m_vecSlots.resize(uCapacity);
+
+	this->m_uMask   = uCapacity - 1;
+	this->m_bSparse = p_bSparse;
+
+	this->m_uWriteIndex.store(0, std::memory_order_relaxed);
+	this->m_uCachedReadIndex = 0;
+
+	this->m_uReadIndex.store(0, std::memory_order_relaxed);
+	this->m_uCachedWriteIndex = 0;
+}
+
+ProtocolMessageQueue::~ProtocolMessageQueue()
+{
+	this->m_pGenerator = nullptr;
+}
+
+bool ProtocolMessageQueue::Push(uint32_t p_uMessageId, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize)
+{
+	if (nullptr == this->m_pGenerator)
+	{
+		return false;
+	}
+
+	ProtocolMessageQueue::Slot * pSlot = this->_AcquireSlot();
+
+	if (nullptr == pSlot)
+	{
+		return false;
+	}
+
+	if (!this->m_pGenerator->DecodeMessage(p_uMessageId, p_pszDataBuffer, p_nDataSize, pSlot->cDecodedMessage, this->m_bSparse))
+	{
+		return false;
+	}
+
+	pSlot->uMessageId = p_uMessageId;
+
+	this->_CommitSlot();
+
+	return true;
+}
+
+int32_t ProtocolMessageQueue::PushFrames(const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize)
+{
+	if (nullptr == this->m_pGenerator || p_nDataSize < 0 || (nullptr == p_pszDataBuffer && p_nDataSize > 0))
+	{
+		return -1;
+	}
+
+	int32_t nOffset = 0;
+
+	while (nOffset < p_nDataSize)
+	{
+		uint32_t uMessageId = 0;
+		uint32_t uBodySize  = 0;
+
+		int32_t nHeaderSize = this->m_pGenerator->_ReadFrameHeader(p_pszDataBuffer + nOffset, static_cast<size_t>(p_nDataSize - nOffset), uMessageId, uBodySize);
+
+		if (nHeaderSize < 0)
+		{
+			CCLOGERROR("Frame Header Is Invalid! Offset : %d.", nOffset);
+
+			nOffset = -1; break;
+		}
+
+		if (0 == nHeaderSize || static_cast<uint32_t>(p_nDataSize - nOffset - nHeaderSize) < uBodySize)
+		{
+			break; // 剩下的数据不是一个完整的帧
+		}
+
+		ProtocolMessageQueue::Slot * pSlot = this->_AcquireSlot();
+
+		if (nullptr == pSlot)
+		{
+			break; // 队列已满，这一帧留给下次调用
+		}
+
+		const unsigned char * pszBody = p_pszDataBuffer + nOffset + nHeaderSize;
+
+		nOffset += nHeaderSize + static_cast<int32_t>(uBodySize);
+
+		// 解码失败的帧已经输出了错误，直接跳过
+
+		if (this->m_pGenerator->DecodeMessage(uMessageId, pszBody, static_cast<int32_t>(uBodySize), pSlot->cDecodedMessage, this->m_bSparse))
+		{
+			pSlot->uMessageId = uMessageId;
+
+			this->_CommitSlot();
+		}
+	}
+
+	return nOffset;
+}
+
+int32_t ProtocolMessageQueue::Drain(lua_State * p_pLuaState, int32_t p_nHandlerIndex, uint32_t p_uMaxCount)
+{
+	if (nullptr == this->m_pGenerator || nullptr == p_pLuaState)
+	{
+		return -1;
+	}
+
+	if (0 != p_nHandlerIndex && !lua_isfunction(p_pLuaState, p_nHandlerIndex))
+	{
+		return CCLOGERROR("Message Handler Is Not A Function!"), -1;
+	}
+
+	int32_t nHandlerIndex = (p_nHandlerIndex < 0 && p_nHandlerIndex > LUA_REGISTRYINDEX) ? lua_gettop(p_pLuaState) + p_nHandlerIndex + 1 : p_nHandlerIndex;
+
+	if (0 == nHandlerIndex)
+	{
+		lua_newtable(p_pLuaState);
+	}
+
+	int32_t nResultIndex = lua_gettop(p_pLuaState);
+	int32_t nPrevCacheIndex = this->m_pGenerator->_BeginLuaNameCache(p_pLuaState, nResultIndex + 1);
+
+	int32_t nCount      = 0;
+	int32_t nArrayCount = 0;
+
+	for (uint32_t uDrainCount = 0; 0 == p_uMaxCount || uDrainCount < p_uMaxCount; ++uDrainCount)
+	{
+		// handler中可能再次调用Drain，每次都重新读取自己的索引
+
+		uint32_t uReadIndex = this->m_uReadIndex.load(std::memory_order_relaxed);
+
+		if (uReadIndex == this->m_uCachedWriteIndex)
+		{
+			this->m_uCachedWriteIndex = this->m_uWriteIndex.load(std::memory_order_acquire);
+
+			if (uReadIndex == this->m_uCachedWriteIndex)
+			{
+				break;
+			}
+		}
+
+		const ProtocolMessageQueue::Slot & cSlot = this->m_vecSlots[uReadIndex & this->m_uMask];
+
+		uint32_t uMessageId = cSlot.uMessageId;
+
+		bool bSuccess = this->m_pGenerator->_PushDecodedMessage(cSlot.cDecodedMessage, p_pLuaState);
+
+		// table已经生成，槽位可以立即交还给生产者，handler执行期间网络线程可以继续写入
+
+		this->m_uReadIndex.store(uReadIndex + 1, std::memory_order_release);
+
+		if (bSuccess)
+		{
+			this->m_pGenerator->_DeliverFrame(uMessageId, p_pLuaState, nHandlerIndex, nResultIndex, nArrayCount);
+
+			++nCount;
+		}
+	}
+
+	this->m_pGenerator->_EndLuaNameCache(p_pLuaState, nPrevCacheIndex);
+
+	return nCount;
+}
+
+uint32_t ProtocolMessageQueue::GetSize() const
+{
+	uint32_t uReadIndex = this->m_uReadIndex.load(std::memory_order_acquire);
+
+	return this->m_uWriteIndex.load(std::memory_order_acquire) - uReadIndex;
+}
+
+uint32_t ProtocolMessageQueue::GetCapacity() const
+{
+	return static_cast<uint32_t>(this->m_vecSlots.size());
+}
+
+ProtocolMessageQueue::Slot * ProtocolMessageQueue::_AcquireSlot()
+{
+	uint32_t uWriteIndex = this->m_uWriteIndex.load(std::memory_order_relaxed);
+
+	if (uWriteIndex - this->m_uCachedReadIndex > this->m_uMask)
+	{
+		this->m_uCachedReadIndex = this->m_uReadIndex.load(std::memory_order_acquire);
+
+		if (uWriteIndex - this->m_uCachedReadIndex > this->m_uMask)
+		{
+			return nullptr;
+		}
+	}
+
+	return &this->m_vecSlots[uWriteIndex & this->m_uMask];
+}
+
+void ProtocolMessageQueue::_CommitSlot()
+{
+	this->m_uWriteIndex.store(this->m_uWriteIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+NS_PROTOCOL_GENERATOR_END
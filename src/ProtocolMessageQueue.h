@@ -0,0 +1,86 @@
+#ifndef __PROTOCOL_MESSAGE_QUEUE_H__
+#define __PROTOCOL_MESSAGE_QUEUE_H__
+
+#include "ProtocolGenerator.h"
+
+#include <atomic>
+#include <vector>
+
+NS_PROTOCOL_GENERATOR_BEGIN
+
+// 网络线程到Lua线程的无锁队列，只允许一个线程Push（网络线程）和一个线程Drain（Lua所在的线程）
+// Push在网络线程中用DecodeMessage把数据解码成中间结果直接放进队列的槽位，Drain在Lua线程中把它们依次转换成table分发
+// 槽位在构造时一次分配好，中间结果的内存在槽位中反复使用，稳定之后Push和Drain都不再申请内存
+// ProtocolGenerator需要在队列使用期间保持有效，RegisterMessageId、SetFrameFormat需要在开始Push之前完成
+// 构造队列会冻结ProtocolGenerator的MessagePlan，之后不再生成新的执行计划，外部传入的消息类型需要在构造队列之前用过一次
+
+class ProtocolMessageQueue
+{
+public:
+	ProtocolMessageQueue(ProtocolGenerator * p_pGenerator, uint32_t p_uCapacity = 256, bool p_bSparse = false);
+
+public:
+	~ProtocolMessageQueue();
+
+public:
+	// 生产者：解码一条消息放入队列，队列已满或者解码失败时返回false，队列满时可以稍后重试
+
+	bool Push(uint32_t p_uMessageId, const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize);
+
+	// 生产者：按ProtocolGenerator的帧格式解码缓冲区中所有完整的帧，返回处理掉的字节数
+	// 队列满或者末尾的帧不完整时剩下的数据留给下次调用；数据错乱时返回-1
+
+	int32_t PushFrames(const unsigned char * p_pszDataBuffer, const int32_t p_nDataSize);
+
+public:
+	// 消费者：p_nHandlerIndex为0时压入{ {消息号, table}, ... }数组，否则对每一条消息调用handler(消息号, table)
+	// p_uMaxCount为0时取出队列中所有的消息，否则最多取出p_uMaxCount条，返回分发的消息数量
+	// 参数错误时返回-1，和ParseFrames、ProtocolFrameDecoder::Decode一样，返回-1时不压入任何值（数组模式也不压入空数组）
+
+	int32_t Drain(lua_State * p_pLuaState, int32_t p_nHandlerIndex = 0, uint32_t p_uMaxCount = 0);
+
+public:
+	uint32_t GetSize() const; // 任意线程调用都只是一个近似值
+	uint32_t GetCapacity() const;
+
+private:
+	typedef struct _Slot
+	{
+	public:
+		_Slot();
+
+	public:
+		uint32_t uMessageId;
+
+	public:
+		ProtocolGenerator::DecodedMessage cDecodedMessage;
+	} Slot;
+
+private:
+	ProtocolMessageQueue::Slot * _AcquireSlot();
+	void _CommitSlot();
+
+private:
+	ProtocolGenerator * m_pGenerator;
+
+private:
+	std::vector<ProtocolMessageQueue::Slot> m_vecSlots; // 容量向上取整为2的幂
+
+private:
+	uint32_t m_uMask;
+	bool m_bSparse;
+
+private:
+	// 生产者和消费者各自写的索引放在不同的缓存行中，避免互相使对方的缓存失效；各自缓存一份对方的索引，只有看起来满/空时才重新读取
+
+	alignas(64) std::atomic<uint32_t> m_uWriteIndex;
+	uint32_t m_uCachedReadIndex; // 生产者使用
+
+private:
+	alignas(64) std::atomic<uint32_t> m_uReadIndex;
+	uint32_t m_uCachedWriteIndex; // 消费者使用
+};
+
+NS_PROTOCOL_GENERATOR_END
+
+#endif // !defined(__PROTOCOL_MESSAGE_QUEUE_H__)
@@ -0,0 +1,116 @@
+#include "ProtocolRegistry.h"
+
+#include "ccMacros.h"
+
+USING_NS_CC;
+
+NS_PROTOCOL_GENERATOR_BEGIN
+
+ProtocolRegistry::_Statistics::_Statistics()
+{
+	Clean();
+}
+
+void ProtocolRegistry::_Statistics::Clean()
+{
+	uHitCount         = 0;
+	uCompileCount     = 0;
+	uCompileFailCount = 0;
+}
+
+ProtocolRegistry * ProtocolRegistry::GetInstance()
+{
+	// 局部静态变量的初始化是线程安全的，多个线程第一次同时调用时也只会构造一个实例
+
+	static ProtocolRegistry s_cProtocolRegistry;
+
+	return &s_cProtocolRegistry;
+}
+
+void ProtocolRegistry::DestroyInstance()
+{
+	// 实例本身在进程退出时析构，这里只释放注册表持有的ProtocolGenerator，之后GetInstance仍然可以继续使用
+
+	ProtocolRegistry::GetInstance()->Purge();
+}
+
+ProtocolRegistry::ProtocolRegistry()
+{
+	this->m_cStatistics.Clean();
+}
+
+ProtocolRegistry::~ProtocolRegistry()
+{
+	this->Purge();
+}
+
+ProtocolGeneratorPtr ProtocolRegistry::Acquire(const std::string & p_strProtocolFileName)
+{
+	return this->_Acquire(p_strProtocolFileName, false);
+}
+
+ProtocolGeneratorPtr ProtocolRegistry::AcquireDescriptorSet(const std::string & p_strDescriptorSetFileName)
+{
+	return this->_Acquire(p_strDescriptorSetFileName, true);
+}
+
+bool ProtocolRegistry::Release(const std::string & p_strProtocolFileName)
+{
+	std::lock_guard<std::mutex> cLock(this->m_cMutex);
+
+	// 只是从注册表中移除，仍被外部持有的ProtocolGenerator会在最后一个持有者释放时销毁
+
+	return this->m_mapGenerators.erase(p_strProtocolFileName) > 0;
+}
+
+void ProtocolRegistry::Purge()
+{
+	std::lock_guard<std::mutex> cLock(this->m_cMutex);
+
+	this->m_mapGenerators.clear();
+}
+
+ProtocolRegistry::Statistics ProtocolRegistry::GetStatistics() const
+{
+	std::lock_guard<std::mutex> cLock(this->m_cMutex);
+
+	return this->m_cStatistics;
+}
+
+ProtocolGeneratorPtr ProtocolRegistry::_Acquire(const std::string & p_strFileName, bool p_bDescriptorSet)
+{
+	if (p_strFileName.empty())
+	{
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> cLock(this->m_cMutex);
+
+	auto pIterFind = this->m_mapGenerators.find(p_strFileName);
+
+	if (pIterFind != this->m_mapGenerators.end())
+	{
+		++this->m_cStatistics.uHitCount;
+
+		return pIterFind->second;
+	}
+
+	++this->m_cStatistics.uCompileCount;
+
+	// 编译期间持有锁，保证同一个协议文件在并发Acquire时也只会编译一次
+
+	ProtocolGeneratorPtr pGenerator(p_bDescriptorSet ? ProtocolGenerator::CreateFromDescriptorSet(p_strFileName) : ProtocolGenerator::Create(p_strFileName));
+
+	if (nullptr == pGenerator)
+	{
+		++this->m_cStatistics.uCompileFailCount;
+
+		return CCLOGERROR("Protocol File \"%s\" Compile Fail!", p_strFileName.c_str()), nullptr;
+	}
+
+	this->m_mapGenerators[p_strFileName] = pGenerator;
+
+	return pGenerator;
+}
+
+NS_PROTOCOL_GENERATOR_END
@@ -0,0 +1,68 @@
+#ifndef __PROTOCOL_REGISTRY_H__
+#define __PROTOCOL_REGISTRY_H__
+
+#include "ProtocolGenerator.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+
+NS_PROTOCOL_GENERATOR_BEGIN
+
+// 进程内共享的协议注册表，每个协议文件只编译一次，之后的Acquire直接返回共享的ProtocolGenerator
+// 所有持有者共享同一个DescriptorPool和DynamicMessageFactory（prototype缓存）
+
+class ProtocolRegistry
+{
+public:
+	typedef struct _Statistics
+	{
+	public:
+		_Statistics();
+
+	public:
+		void Clean();
+
+	public:
+		uint32_t uHitCount;          // 命中缓存的次数
+		uint32_t uCompileCount;      // 编译协议文件的次数
+		uint32_t uCompileFailCount;  // 编译失败的次数
+	} Statistics;
+
+public:
+	static ProtocolRegistry * GetInstance(); // 任意线程都可以调用
+	static void DestroyInstance();           // 释放所有缓存的ProtocolGenerator，已经Acquire到的仍然有效
+
+public:
+	ProtocolRegistry();
+
+public:
+	~ProtocolRegistry();
+
+public:
+	ProtocolGeneratorPtr Acquire(const std::string & p_strProtocolFileName);
+	ProtocolGeneratorPtr AcquireDescriptorSet(const std::string & p_strDescriptorSetFileName);
+
+public:
+	bool Release(const std::string & p_strProtocolFileName);
+	void Purge();
+
+public:
+	ProtocolRegistry::Statistics GetStatistics() const;
+
+private:
+	ProtocolGeneratorPtr _Acquire(const std::string & p_strFileName, bool p_bDescriptorSet);
+
+private:
+	std::map<std::string, ProtocolGeneratorPtr> m_mapGenerators;
+
+private:
+	ProtocolRegistry::Statistics m_cStatistics;
+
+private:
+	mutable std::mutex m_cMutex;
+};
+
+NS_PROTOCOL_GENERATOR_END
+
+#endif // !defined(__PROTOCOL_REGISTRY_H__)
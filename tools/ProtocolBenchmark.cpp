@@ -0,0 +1,286 @@
+// Lua table和protobuf消息互相转换的计时程序，每个用例运行若干轮，输出最快一轮平均每次调用的耗时
+// 用法：ProtocolBenchmark [用例名前缀] [循环次数] [轮数]，不带参数时运行所有用例
+// 除了split用例需要两阶段解码的接口，其他用例只用到各个版本都有的接口，可以在不同的提交上编译对比
+
+#include "ProtocolToolCommon.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+// 用例完成准备工作之后计时运行p_nIterations次，返回耗时（秒），结果不正确时返回负数
+
+typedef struct _BenchmarkCase
+{
+	const char * pszName;
+	double (*pFunction)(ProtocolGenerator * p_pGenerator, lua_State * p_pLuaState, int32_t p_nIterations);
+} BenchmarkCase;
+
+// 嵌套消息：Player带8个Item，覆盖子消息的查找和创建
+// 早期版本从Lua填充repeated标量和单个子消息时会出错，这里不带packed数组和weapon，保证每个版本都能运行
+
+static const char * s_pszNestedScript = R"(
+	local items = {}
+	for i = 1, 8 do items[i] = { id = i, name = "item" .. i } end
+	return { uid = 123456789, nick = "player", level = 42, x = 1.5, y = -2.25, online = true, items = items }
+)";
+
+static double BenchmarkNestedGenerate(ProtocolGenerator * p_pGenerator, lua_State * p_pLuaState, int32_t p_nIterations)
+{
+	PushToolTable(p_pLuaState, s_pszNestedScript);
+
+	int32_t nTableIndex = lua_gettop(p_pLuaState);
+
+	google::protobuf::Message * pMessage = p_pGenerator->GenerateMessage("tool.Player", p_pLuaState, nTableIndex);
+
+	double fSeconds = -1.0;
+
+	if (nullptr != pMessage)
+	{
+		delete pMessage;
+
+		double fStart = GetToolSeconds();
+
+		for (int32_t i = 0; i < p_nIterations; ++i)
+		{
+			delete p_pGenerator->GenerateMessage("tool.Player", p_pLuaState, nTableIndex);
+		}
+
+		fSeconds = GetToolSeconds() - fStart;
+	}
+
+	lua_settop(p_pLuaState, nTableIndex - 1);
+
+	return fSeconds;
+}
+
+static double BenchmarkNestedParse(ProtocolGenerator * p_pGenerator, lua_State * p_pLuaState, int32_t p_nIterations)
+{
+	int32_t nTop = lua_gettop(p_pLuaState);
+
+	PushToolTable(p_pLuaState, s_pszNestedScript);
+
+	google::protobuf::Message * pMessage = p_pGenerator->GenerateMessage("tool.Player", p_pLuaState, lua_gettop(p_pLuaState));
+
+	std::string strBuffer = nullptr != pMessage ? pMessage->SerializeAsString() : std::string();
+
+	CC_SAFE_DELETE(pMessage);
+
+	lua_settop(p_pLuaState, nTop);
+
+	const unsigned char * pszBuffer = reinterpret_cast<const unsigned char *>(strBuffer.data());
+	int32_t nBufferSize = static_cast<int32_t>(strBuffer.size());
+
+	if (0 == nBufferSize || !p_pGenerator->ParseMessage("tool.Player", pszBuffer, nBufferSize, p_pLuaState))
+	{
+		return lua_settop(p_pLuaState, nTop), -1.0;
+	}
+
+	lua_settop(p_pLuaState, nTop);
+
+	double fStart = GetToolSeconds();
+
+	for (int32_t i = 0; i < p_nIterations; ++i)
+	{
+		p_pGenerator->ParseMessage("tool.Player", pszBuffer, nBufferSize, p_pLuaState);
+
+		lua_settop(p_pLuaState, nTop);
+	}
+
+	return GetToolSeconds() - fStart;
+}
+
+// 宽消息：用ProtocolData生成有96个字段的消息，每个字段都要在ProtocolData中按名字找到对应的值
+
+static double BenchmarkWideFill(ProtocolGenerator * p_pGenerator, lua_State *, int32_t p_nIterations)
+{
+	std::vector<ProtocolGenerator::ProtocolData> vecValues(s_nToolWideFieldCount);
+
+	for (int32_t i = 1; i <= s_nToolWideFieldCount; ++i)
+	{
+		ProtocolGenerator::ProtocolData & cProtocolData = vecValues[i - 1];
+
+		cProtocolData.eDataType = ProtocolGenerator::PROTOCOL_DATA_TYPE::PROTOCOL_DATA_VALUE;
+		cProtocolData.strField  = "field_" + std::to_string(i);
+		cProtocolData.strValue  = GetToolWideFieldType(i) == google::protobuf::FieldDescriptorProto::TYPE_STRING ? "value_" + std::to_string(i) : std::to_string(i);
+	}
+
+	google::protobuf::Message * pMessage = p_pGenerator->GenerateMessage("tool.Wide", vecValues);
+
+	if (nullptr == pMessage)
+	{
+		return -1.0;
+	}
+
+	delete pMessage;
+
+	double fStart = GetToolSeconds();
+
+	for (int32_t i = 0; i < p_nIterations; ++i)
+	{
+		delete p_pGenerator->GenerateMessage("tool.Wide", vecValues);
+	}
+
+	return GetToolSeconds() - fStart;
+}
+
+// 两阶段解码：完整的Player（带packed数组和weapon），对比单阶段ParseMessage和两阶段中各自的耗时
+// split.parse和split.push都是主线程的耗时，split.decode是可以放到工作线程的部分
+
+static bool EncodeToolPlayer(ProtocolGenerator * p_pGenerator, lua_State * p_pLuaState, std::string & p_strBuffer)
+{
+	int32_t nTop = lua_gettop(p_pLuaState);
+
+	bool bSuccess = PushToolTable(p_pLuaState, s_pszToolPlayerScript) && p_pGenerator->EncodeMessage("tool.Player", p_pLuaState, lua_gettop(p_pLuaState), p_strBuffer);
+
+	lua_settop(p_pLuaState, nTop);
+
+	return bSuccess;
+}
+
+static double BenchmarkSplitParse(ProtocolGenerator * p_pGenerator, lua_State * p_pLuaState, int32_t p_nIterations)
+{
+	std::string strBuffer;
+
+	if (!EncodeToolPlayer(p_pGenerator, p_pLuaState, strBuffer))
+	{
+		return -1.0;
+	}
+
+	int32_t nTop = lua_gettop(p_pLuaState);
+
+	double fStart = GetToolSeconds();
+
+	for (int32_t i = 0; i < p_nIterations; ++i)
+	{
+		if (!p_pGenerator->ParseMessage("tool.Player", reinterpret_cast<const unsigned char *>(strBuffer.data()), static_cast<int32_t>(strBuffer.size()), p_pLuaState))
+		{
+			return -1.0;
+		}
+
+		lua_settop(p_pLuaState, nTop);
+	}
+
+	return GetToolSeconds() - fStart;
+}
+
+static double BenchmarkSplitDecode(ProtocolGenerator * p_pGenerator, lua_State * p_pLuaState, int32_t p_nIterations)
+{
+	std::string strBuffer;
+
+	if (!EncodeToolPlayer(p_pGenerator, p_pLuaState, strBuffer))
+	{
+		return -1.0;
+	}
+
+	ProtocolGenerator::DecodedMessage cDecodedMessage;
+
+	double fStart = GetToolSeconds();
+
+	for (int32_t i = 0; i < p_nIterations; ++i)
+	{
+		if (!p_pGenerator->DecodeMessage("tool.Player", reinterpret_cast<const unsigned char *>(strBuffer.data()), static_cast<int32_t>(strBuffer.size()), cDecodedMessage))
+		{
+			return -1.0;
+		}
+	}
+
+	return GetToolSeconds() - fStart;
+}
+
+static double BenchmarkSplitPush(ProtocolGenerator * p_pGenerator, lua_State * p_pLuaState, int32_t p_nIterations)
+{
+	std::string strBuffer;
+	ProtocolGenerator::DecodedMessage cDecodedMessage;
+
+	if (!EncodeToolPlayer(p_pGenerator, p_pLuaState, strBuffer) || !p_pGenerator->DecodeMessage("tool.Player", reinterpret_cast<const unsigned char *>(strBuffer.data()), static_cast<int32_t>(strBuffer.size()), cDecodedMessage))
+	{
+		return -1.0;
+	}
+
+	int32_t nTop = lua_gettop(p_pLuaState);
+
+	double fStart = GetToolSeconds();
+
+	for (int32_t i = 0; i < p_nIterations; ++i)
+	{
+		if (!p_pGenerator->PushDecodedMessage(cDecodedMessage, p_pLuaState))
+		{
+			return -1.0;
+		}
+
+		lua_settop(p_pLuaState, nTop);
+	}
+
+	return GetToolSeconds() - fStart;
+}
+
+static const BenchmarkCase s_arrBenchmarkCases[] =
+{
+	{ "nested.generate", BenchmarkNestedGenerate },
+	{ "nested.parse", BenchmarkNestedParse },
+	{ "wide.fill", BenchmarkWideFill },
+	{ "split.parse", BenchmarkSplitParse },
+	{ "split.decode", BenchmarkSplitDecode },
+	{ "split.push", BenchmarkSplitPush },
+};
+
+int main(int argc, char * argv[])
+{
+	const char * pszFilter = argc > 1 ? argv[1] : "";
+	int32_t nIterations    = argc > 2 ? atoi(argv[2]) : 20000;
+	int32_t nRounds        = argc > 3 ? atoi(argv[3]) : 5;
+
+	ProtocolGenerator * pGenerator = CreateToolGenerator();
+
+	if (nullptr == pGenerator)
+	{
+		return printf("Create ProtocolGenerator Fail!\n"), 1;
+	}
+
+	lua_State * pLuaState = CreateToolLuaState();
+
+	int32_t nFailCount = 0;
+
+	for (auto & cCase : s_arrBenchmarkCases)
+	{
+		if (0 != strncmp(cCase.pszName, pszFilter, strlen(pszFilter)))
+		{
+			continue;
+		}
+
+		double fBestSeconds = -1.0;
+
+		for (int32_t i = 0; i < nRounds; ++i)
+		{
+			double fSeconds = cCase.pFunction(pGenerator, pLuaState, nIterations);
+
+			if (fSeconds < 0.0)
+			{
+				fBestSeconds = -1.0;
+				break;
+			}
+
+			if (fBestSeconds < 0.0 || fSeconds < fBestSeconds)
+			{
+				fBestSeconds = fSeconds;
+			}
+		}
+
+		if (fBestSeconds < 0.0)
+		{
+			printf("%-24s FAIL\n", cCase.pszName);
+
+			++nFailCount;
+		}
+		else
+		{
+			printf("%-24s %10d x %d rounds %12.1f ns/op\n", cCase.pszName, nIterations, nRounds, fBestSeconds * 1e9 / nIterations);
+		}
+	}
+
+	lua_close(pLuaState);
+
+	delete pGenerator;
+
+	return nFailCount == 0 ? 0 : 1;
+}
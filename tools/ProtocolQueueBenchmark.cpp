@@ -0,0 +1,244 @@
+// 网络线程到Lua线程传递消息的计时：ProtocolMessageQueue对比加锁的队列（网络线程只拷贝数据，主线程ParseMessage之后分发）
+// 用法：ProtocolQueueBenchmark [消息数量] [队列容量]，所有消息都分发到时返回0
+// 先让生产者和消费者同时运行，输出总的吞吐量；再在同一个线程中每次先放满一批，只对消费者计时，输出主线程平均每条消息的耗时（不受线程调度影响）
+
+#include "ProtocolToolCommon.h"
+#include "ProtocolMessageQueue.h"
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include <stdlib.h>
+
+typedef std::deque<std::pair<uint32_t, std::string>> MutexQueueMessages;
+
+typedef struct _QueueBenchmarkResult
+{
+	double fTotalSeconds;    // 生产者和消费者同时运行，从开始到分发完最后一条消息
+	double fConsumerSeconds; // 每批放满之后只对消费者计时，所有消息的总耗时
+} QueueBenchmarkResult;
+
+static int32_t s_nHandledCount = 0;
+
+static int OnToolMessage(lua_State *)
+{
+	++s_nHandledCount;
+
+	return 0;
+}
+
+static bool PrintQueueBenchmarkResult(const char * p_pszName, int32_t p_nMessageCount, const QueueBenchmarkResult & p_cResult)
+{
+	bool bSuccess = p_cResult.fTotalSeconds > 0.0 && p_cResult.fConsumerSeconds > 0.0;
+
+	printf("%-16s %8d messages %10.1f ms %12.0f msg/s %10.1f ns/msg on main thread%s\n", p_pszName, p_nMessageCount, p_cResult.fTotalSeconds * 1e3, p_nMessageCount / p_cResult.fTotalSeconds, p_cResult.fConsumerSeconds * 1e9 / p_nMessageCount, bSuccess ? "" : " FAIL");
+
+	return bSuccess;
+}
+
+static QueueBenchmarkResult BenchmarkMessageQueue(ProtocolGenerator * p_pGenerator, lua_State * p_pLuaState, const std::string & p_strBuffer, int32_t p_nMessageCount, uint32_t p_uCapacity)
+{
+	QueueBenchmarkResult cResult = { 0.0, 0.0 };
+
+	ProtocolMessageQueue cQueue(p_pGenerator, p_uCapacity);
+
+	const unsigned char * pszBuffer = reinterpret_cast<const unsigned char *>(p_strBuffer.data());
+	int32_t nBufferSize = static_cast<int32_t>(p_strBuffer.size());
+
+	lua_pushcfunction(p_pLuaState, OnToolMessage);
+
+	int32_t nHandlerIndex = lua_gettop(p_pLuaState);
+
+	s_nHandledCount = 0;
+
+	double fStart = GetToolSeconds();
+
+	std::thread cProducer([&cQueue, pszBuffer, nBufferSize, p_nMessageCount]()
+	{
+		for (int32_t i = 0; i < p_nMessageCount; ++i)
+		{
+			while (!cQueue.Push(1, pszBuffer, nBufferSize))
+			{
+				std::this_thread::yield();
+			}
+		}
+	});
+
+	while (s_nHandledCount < p_nMessageCount)
+	{
+		if (0 == cQueue.Drain(p_pLuaState, nHandlerIndex))
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	cResult.fTotalSeconds = GetToolSeconds() - fStart;
+
+	cProducer.join();
+
+	// 生产者已经结束，主线程自己放满一批再分发，只统计分发的时间
+
+	s_nHandledCount = 0;
+
+	for (int32_t nPushedCount = 0; nPushedCount < p_nMessageCount; )
+	{
+		while (nPushedCount < p_nMessageCount && cQueue.Push(1, pszBuffer, nBufferSize))
+		{
+			++nPushedCount;
+		}
+
+		double fDrainStart = GetToolSeconds();
+
+		cQueue.Drain(p_pLuaState, nHandlerIndex);
+
+		cResult.fConsumerSeconds += GetToolSeconds() - fDrainStart;
+	}
+
+	if (s_nHandledCount != p_nMessageCount)
+	{
+		cResult.fConsumerSeconds = -1.0;
+	}
+
+	lua_settop(p_pLuaState, nHandlerIndex - 1);
+
+	return cResult;
+}
+
+// 对比用的加锁队列：网络线程只拷贝数据，主线程整批取出之后逐条ParseMessage再调用handler
+
+static void DrainMutexQueue(ProtocolGenerator * p_pGenerator, lua_State * p_pLuaState, int32_t p_nHandlerIndex, MutexQueueMessages & p_queMessages)
+{
+	for (auto & cMessage : p_queMessages)
+	{
+		lua_pushvalue(p_pLuaState, p_nHandlerIndex);
+		lua_pushinteger(p_pLuaState, cMessage.first);
+
+		if (p_pGenerator->ParseMessage(cMessage.first, reinterpret_cast<const unsigned char *>(cMessage.second.data()), static_cast<int32_t>(cMessage.second.size()), p_pLuaState))
+		{
+			lua_pcall(p_pLuaState, 2, 0, 0);
+		}
+
+		lua_settop(p_pLuaState, p_nHandlerIndex);
+	}
+
+	p_queMessages.clear();
+}
+
+static QueueBenchmarkResult BenchmarkMutexQueue(ProtocolGenerator * p_pGenerator, lua_State * p_pLuaState, const std::string & p_strBuffer, int32_t p_nMessageCount, uint32_t p_uCapacity)
+{
+	QueueBenchmarkResult cResult = { 0.0, 0.0 };
+
+	std::mutex cMutex;
+	MutexQueueMessages queMessages;
+	MutexQueueMessages queProcessing;
+
+	lua_pushcfunction(p_pLuaState, OnToolMessage);
+
+	int32_t nHandlerIndex = lua_gettop(p_pLuaState);
+
+	s_nHandledCount = 0;
+
+	double fStart = GetToolSeconds();
+
+	std::thread cProducer([&cMutex, &queMessages, &p_strBuffer, p_nMessageCount]()
+	{
+		for (int32_t i = 0; i < p_nMessageCount; ++i)
+		{
+			std::lock_guard<std::mutex> cLock(cMutex);
+
+			queMessages.emplace_back(1, p_strBuffer);
+		}
+	});
+
+	while (s_nHandledCount < p_nMessageCount)
+	{
+		{
+			std::lock_guard<std::mutex> cLock(cMutex);
+
+			queProcessing.swap(queMessages);
+		}
+
+		if (queProcessing.empty())
+		{
+			std::this_thread::yield();
+		}
+		else
+		{
+			DrainMutexQueue(p_pGenerator, p_pLuaState, nHandlerIndex, queProcessing);
+		}
+	}
+
+	cResult.fTotalSeconds = GetToolSeconds() - fStart;
+
+	cProducer.join();
+
+	// 和ProtocolMessageQueue一样按批分发，每批的数量等于队列容量，取出数据的加锁也计入主线程的时间
+
+	s_nHandledCount = 0;
+
+	for (int32_t nPushedCount = 0; nPushedCount < p_nMessageCount; )
+	{
+		for (uint32_t i = 0; i < p_uCapacity && nPushedCount < p_nMessageCount; ++i, ++nPushedCount)
+		{
+			queMessages.emplace_back(1, p_strBuffer);
+		}
+
+		double fDrainStart = GetToolSeconds();
+
+		{
+			std::lock_guard<std::mutex> cLock(cMutex);
+
+			queProcessing.swap(queMessages);
+		}
+
+		DrainMutexQueue(p_pGenerator, p_pLuaState, nHandlerIndex, queProcessing);
+
+		cResult.fConsumerSeconds += GetToolSeconds() - fDrainStart;
+	}
+
+	if (s_nHandledCount != p_nMessageCount)
+	{
+		cResult.fConsumerSeconds = -1.0;
+	}
+
+	lua_settop(p_pLuaState, nHandlerIndex - 1);
+
+	return cResult;
+}
+
+int main(int argc, char * argv[])
+{
+	int32_t nMessageCount = argc > 1 ? atoi(argv[1]) : 200000;
+	uint32_t uCapacity    = argc > 2 ? static_cast<uint32_t>(atoi(argv[2])) : 256;
+
+	ProtocolGenerator * pGenerator = CreateToolGenerator();
+
+	if (nullptr == pGenerator || !pGenerator->RegisterMessageId(1, "tool.Player"))
+	{
+		return printf("Create ProtocolGenerator Fail!\n"), 1;
+	}
+
+	lua_State * pLuaState = CreateToolLuaState();
+
+	std::string strBuffer;
+
+	if (!PushToolTable(pLuaState, s_pszToolPlayerScript) || !pGenerator->EncodeMessage("tool.Player", pLuaState, lua_gettop(pLuaState), strBuffer))
+	{
+		return printf("Encode tool.Player Fail!\n"), 1;
+	}
+
+	lua_settop(pLuaState, 0);
+
+	int32_t nFailCount = 0;
+
+	nFailCount += PrintQueueBenchmarkResult("mutex queue", nMessageCount, BenchmarkMutexQueue(pGenerator, pLuaState, strBuffer, nMessageCount, uCapacity)) ? 0 : 1;
+	nFailCount += PrintQueueBenchmarkResult("message queue", nMessageCount, BenchmarkMessageQueue(pGenerator, pLuaState, strBuffer, nMessageCount, uCapacity)) ? 0 : 1;
+
+	lua_close(pLuaState);
+
+	delete pGenerator;
+
+	return nFailCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+// 多个线程共用一个ProtocolGenerator同时编码和解码同一个协议，检查结果和单线程一致，需要配合-fsanitize=thread运行
+// 用法：ProtocolStressTest [线程数] [每个线程的循环次数]，全部通过时返回0
+
+#include "ProtocolToolCommon.h"
+
+#include <google/protobuf/dynamic_message.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <stdlib.h>
+
+static std::atomic<int32_t> s_nFailCount(0);
+
+#define STRESS_CHECK(condition) do { if (!(condition)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #condition); ++s_nFailCount; } } while (false)
+
+// 外部传入的消息类型（相当于生成代码的消息），用来检查冻结之前可以生成执行计划，冻结之后会被拒绝
+
+static const char * s_pszExternalSchema = R"(
+	name: "external.proto"
+	package: "external"
+	message_type { name: "Prepared" field { name: "id" number: 1 label: LABEL_OPTIONAL type: TYPE_INT32 } }
+	message_type { name: "Late" field { name: "id" number: 1 label: LABEL_OPTIONAL type: TYPE_INT32 } }
+)";
+
+// 把栈顶的table重新编码，和参考数据比较之后弹出
+
+static void CheckReencode(ProtocolGenerator * p_pGenerator, lua_State * p_pLuaState, const std::string & p_strReference)
+{
+	std::string strBuffer;
+
+	STRESS_CHECK(p_pGenerator->EncodeMessage("tool.Player", p_pLuaState, lua_gettop(p_pLuaState), strBuffer));
+	STRESS_CHECK(strBuffer == p_strReference);
+
+	lua_pop(p_pLuaState, 1);
+}
+
+static void RunStressLoop(ProtocolGenerator * p_pGenerator, lua_State * p_pLuaState, int32_t p_nIterations, const std::string & p_strReference)
+{
+	STRESS_CHECK(PushToolTable(p_pLuaState, s_pszToolPlayerScript));
+
+	int32_t nTableIndex = lua_gettop(p_pLuaState);
+
+	for (int32_t i = 0; i < p_nIterations; ++i)
+	{
+		std::string strBuffer;
+
+		STRESS_CHECK(p_pGenerator->EncodeMessage("tool.Player", p_pLuaState, nTableIndex, strBuffer));
+		STRESS_CHECK(strBuffer == p_strReference);
+
+		const unsigned char * pszBuffer = reinterpret_cast<const unsigned char *>(strBuffer.data());
+		int32_t nBufferSize = static_cast<int32_t>(strBuffer.size());
+
+		switch (i % 3)
+		{
+		case 0:
+			STRESS_CHECK(p_pGenerator->ParseMessage("tool.Player", pszBuffer, nBufferSize, p_pLuaState));
+			break;
+
+		case 1:
+			STRESS_CHECK(p_pGenerator->ParseMessage("tool.Player", pszBuffer, nBufferSize, p_pLuaState, true));
+			break;
+
+		default:
+			{
+				ProtocolGenerator::DecodedMessage cDecodedMessage;
+
+				STRESS_CHECK(p_pGenerator->DecodeMessage("tool.Player", pszBuffer, nBufferSize, cDecodedMessage));
+				STRESS_CHECK(p_pGenerator->PushDecodedMessage(cDecodedMessage, p_pLuaState));
+			}
+			break;
+		}
+
+		CheckReencode(p_pGenerator, p_pLuaState, p_strReference);
+	}
+
+	STRESS_CHECK(lua_gettop(p_pLuaState) == nTableIndex);
+
+	lua_settop(p_pLuaState, nTableIndex - 1);
+}
+
+int main(int argc, char * argv[])
+{
+	int32_t nThreadCount = argc > 1 ? atoi(argv[1]) : 8;
+	int32_t nIterations  = argc > 2 ? atoi(argv[2]) : 2000;
+
+	ProtocolGenerator * pGenerator = CreateToolGenerator();
+
+	if (nullptr == pGenerator)
+	{
+		return printf("Create ProtocolGenerator Fail!\n"), 1;
+	}
+
+	lua_State * pLuaState = CreateToolLuaState();
+
+	// 单线程的编码结果作为参考
+
+	std::string strReference;
+
+	STRESS_CHECK(PushToolTable(pLuaState, s_pszToolPlayerScript));
+	STRESS_CHECK(pGenerator->EncodeMessage("tool.Player", pLuaState, lua_gettop(pLuaState), strReference));
+
+	lua_settop(pLuaState, 0);
+
+	// 冻结之前外部类型可以在默认Context中生成执行计划
+
+	google::protobuf::DescriptorPool cExternalPool;
+	google::protobuf::DynamicMessageFactory cExternalFactory(&cExternalPool);
+
+	std::string strExternalSet;
+	google::protobuf::FileDescriptorSet cExternalSet;
+
+	STRESS_CHECK(BuildToolDescriptorSet(s_pszExternalSchema, strExternalSet) && cExternalSet.ParseFromString(strExternalSet));
+	STRESS_CHECK(nullptr != cExternalPool.BuildFile(cExternalSet.file(0)));
+
+	std::unique_ptr<google::protobuf::Message> pPrepared(cExternalFactory.GetPrototype(cExternalPool.FindMessageTypeByName("external.Prepared"))->New());
+	std::unique_ptr<google::protobuf::Message> pLate(cExternalFactory.GetPrototype(cExternalPool.FindMessageTypeByName("external.Late"))->New());
+
+	STRESS_CHECK(pGenerator->ParseMessage(pPrepared.get(), pLuaState));
+
+	lua_settop(pLuaState, 0);
+
+	// 工作线程各自绑定Context，默认Context所在的主线程同时运行同样的循环
+
+	std::atomic<int32_t> nReadyCount(0);
+	std::vector<std::thread> vecThreads;
+
+	for (int32_t i = 0; i < nThreadCount; ++i)
+	{
+		vecThreads.emplace_back([pGenerator, nIterations, &strReference, &nReadyCount]()
+		{
+			ProtocolGenerator::Context cContext(pGenerator);
+
+			lua_State * pThreadLuaState = CreateToolLuaState();
+
+			++nReadyCount;
+
+			RunStressLoop(pGenerator, pThreadLuaState, nIterations, strReference);
+
+			lua_close(pThreadLuaState);
+		});
+	}
+
+	while (nThreadCount > 0 && nReadyCount.load() == 0)
+	{
+		std::this_thread::yield();
+	}
+
+	// 已经有Context绑定，新的类型不再生成执行计划，已经准备好的类型仍然可用
+
+	STRESS_CHECK(nThreadCount == 0 || !pGenerator->ParseMessage(pLate.get(), pLuaState));
+	STRESS_CHECK(pGenerator->ParseMessage(pPrepared.get(), pLuaState));
+
+	lua_settop(pLuaState, 0);
+
+	RunStressLoop(pGenerator, pLuaState, nIterations, strReference);
+
+	for (auto & cThread : vecThreads)
+	{
+		cThread.join();
+	}
+
+	lua_close(pLuaState);
+
+	delete pGenerator;
+
+	printf("%d threads x %d iterations, %d failures\n", nThreadCount + 1, nIterations, s_nFailCount.load());
+
+	return s_nFailCount.load() == 0 ? 0 : 1;
+}
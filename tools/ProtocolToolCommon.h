@@ -0,0 +1,153 @@
+#ifndef __PROTOCOL_TOOL_COMMON_H__
+#define __PROTOCOL_TOOL_COMMON_H__
+
+// tools目录下的测试和计时程序共用的协议与Lua辅助函数，每个程序是单独的一个cpp，和src一起编译，链接protobuf和cocos2d-x使用的Lua（LuaJIT）
+// 例如：g++ -std=c++11 -O2 -I<cocos2d-x头文件目录> -Isrc tools/ProtocolStressTest.cpp src/*.cpp <cocos2d-x库> -lprotobuf -lluajit -lpthread
+
+#include "ProtocolGenerator.h"
+
+#include "ccMacros.h"
+
+extern "C" {
+#include "lua.h"
+#include "lauxlib.h"
+#include "lualib.h"
+}
+
+#include <google/protobuf/text_format.h>
+
+#include <chrono>
+#include <string>
+
+#include <stdio.h>
+
+USING_NS_PROTOCOL_GENERATOR;
+
+// 测试协议直接写在代码里，不依赖proto文件和protoc；字段覆盖常见的标量、字符串、嵌套消息和packed数组
+
+static const char * s_pszToolSchema = R"(
+	name: "tool.proto"
+	package: "tool"
+	message_type {
+		name: "Item"
+		field { name: "id" number: 1 label: LABEL_OPTIONAL type: TYPE_UINT32 }
+		field { name: "name" number: 2 label: LABEL_OPTIONAL type: TYPE_STRING }
+		field { name: "attrs" number: 3 label: LABEL_REPEATED type: TYPE_INT32 options { packed: true } }
+	}
+	message_type {
+		name: "Player"
+		field { name: "uid" number: 1 label: LABEL_OPTIONAL type: TYPE_UINT64 }
+		field { name: "nick" number: 2 label: LABEL_OPTIONAL type: TYPE_STRING }
+		field { name: "level" number: 3 label: LABEL_OPTIONAL type: TYPE_INT32 }
+		field { name: "x" number: 4 label: LABEL_OPTIONAL type: TYPE_DOUBLE }
+		field { name: "y" number: 5 label: LABEL_OPTIONAL type: TYPE_DOUBLE }
+		field { name: "online" number: 6 label: LABEL_OPTIONAL type: TYPE_BOOL }
+		field { name: "items" number: 7 label: LABEL_REPEATED type: TYPE_MESSAGE type_name: ".tool.Item" }
+		field { name: "weapon" number: 8 label: LABEL_OPTIONAL type: TYPE_MESSAGE type_name: ".tool.Item" }
+		field { name: "friends" number: 9 label: LABEL_REPEATED type: TYPE_UINT32 options { packed: true } }
+	}
+)";
+
+// 和Player对应的Lua table，在Lua中执行之后留在栈顶
+
+static const char * s_pszToolPlayerScript = R"(
+	local items = {}
+	for i = 1, 8 do items[i] = { id = i, name = "item" .. i, attrs = { i, i * 10, i * 100, -i } } end
+	local friends = {}
+	for i = 1, 16 do friends[i] = 1000 + i end
+	return { uid = 123456789, nick = "player", level = 42, x = 1.5, y = -2.25, online = true, items = items, weapon = { id = 99, name = "sword", attrs = { 7, 8 } }, friends = friends }
+)";
+
+// 宽消息：字段很多的消息（例如角色快照），字段名为field_1到field_N，类型依次为int32、string、double、uint32
+
+static const int32_t s_nToolWideFieldCount = 96;
+
+inline google::protobuf::FieldDescriptorProto::Type GetToolWideFieldType(int32_t p_nNumber)
+{
+	static const google::protobuf::FieldDescriptorProto::Type s_arrTypes[] =
+	{
+		google::protobuf::FieldDescriptorProto::TYPE_INT32,
+		google::protobuf::FieldDescriptorProto::TYPE_STRING,
+		google::protobuf::FieldDescriptorProto::TYPE_DOUBLE,
+		google::protobuf::FieldDescriptorProto::TYPE_UINT32,
+	};
+
+	return s_arrTypes[(p_nNumber - 1) % 4];
+}
+
+inline void AddToolWideMessage(google::protobuf::FileDescriptorProto * p_pFileProto)
+{
+	google::protobuf::DescriptorProto * pMessageProto = p_pFileProto->add_message_type();
+
+	pMessageProto->set_name("Wide");
+
+	for (int32_t i = 1; i <= s_nToolWideFieldCount; ++i)
+	{
+		google::protobuf::FieldDescriptorProto * pFieldProto = pMessageProto->add_field();
+
+		pFieldProto->set_name("field_" + std::to_string(i));
+		pFieldProto->set_number(i);
+		pFieldProto->set_label(google::protobuf::FieldDescriptorProto::LABEL_OPTIONAL);
+		pFieldProto->set_type(GetToolWideFieldType(i));
+	}
+}
+
+inline bool BuildToolDescriptorSet(const char * p_pszSchema, std::string & p_strDescriptorSet, bool p_bWideMessage = false)
+{
+	google::protobuf::FileDescriptorSet cDescriptorSet;
+
+	if (!google::protobuf::TextFormat::ParseFromString(p_pszSchema, cDescriptorSet.add_file()))
+	{
+		return CCLOGERROR("Tool Schema Parse Fail!"), false;
+	}
+
+	if (p_bWideMessage)
+	{
+		AddToolWideMessage(cDescriptorSet.mutable_file(0));
+	}
+
+	return cDescriptorSet.SerializeToString(&p_strDescriptorSet);
+}
+
+inline ProtocolGenerator * CreateToolGenerator()
+{
+	std::string strDescriptorSet;
+
+	if (!BuildToolDescriptorSet(s_pszToolSchema, strDescriptorSet, true))
+	{
+		return nullptr;
+	}
+
+	return ProtocolGenerator::CreateFromDescriptorSet(reinterpret_cast<const unsigned char *>(strDescriptorSet.data()), static_cast<int32_t>(strDescriptorSet.size()));
+}
+
+inline lua_State * CreateToolLuaState()
+{
+	lua_State * pLuaState = luaL_newstate();
+
+	if (nullptr != pLuaState)
+	{
+		luaL_openlibs(pLuaState);
+	}
+
+	return pLuaState;
+}
+
+inline bool PushToolTable(lua_State * p_pLuaState, const char * p_pszScript)
+{
+	if (0 != luaL_loadstring(p_pLuaState, p_pszScript) || 0 != lua_pcall(p_pLuaState, 0, 1, 0))
+	{
+		CCLOGERROR("Tool Script Error: %s", lua_tostring(p_pLuaState, -1));
+
+		return lua_pop(p_pLuaState, 1), false;
+	}
+
+	return lua_istable(p_pLuaState, -1);
+}
+
+inline double GetToolSeconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif // !defined(__PROTOCOL_TOOL_COMMON_H__)